@@ -4,8 +4,8 @@
 # c-wildwater.sh - Script de traitement des donnees de distribution d'eau
 # Projet C-Wildwater - PreIng2 2025-2026
 # 
-# Ce script filtre les donnees avec grep/awk, appelle le programme C wildwater
-# et genere les graphiques avec gnuplot.
+# Ce script appelle le programme C wildwater (qui lit le cache binaire des
+# donnees, construit au premier appel) et genere les graphiques avec gnuplot.
 # =============================================================================
 
 # Enregistrement du temps de debut pour mesurer la duree d'execution
@@ -29,11 +29,17 @@ afficher_usage() {
     echo "Commandes disponibles :"
     echo "  histo {max|src|real|all}  - Generation d'histogrammes des usines"
     echo "  leaks \"<identifiant>\"     - Calcul des fuites pour une usine donnee"
+    echo "  leaks --all               - Calcul des fuites de toutes les usines en une passe"
     echo ""
     echo "Exemples d'utilisation :"
     echo "  $0 wildwater.dat histo max"
     echo "  $0 wildwater.dat histo src"
     echo "  $0 wildwater.dat leaks \"Facility complex #RH400057F\""
+    echo "  $0 wildwater.dat leaks --all"
+    echo ""
+    echo "Le fichier de donnees peut etre compresse (gzip, ou zstd si le"
+    echo "programme est compile avec make ZSTD=1) : il est lu sans etre"
+    echo "decompresse sur le disque."
 }
 
 # Affiche un message d'erreur et termine le script
@@ -102,6 +108,18 @@ fi
 # Revenir au repertoire principal
                                                                                                                         cd "$SCRIPT_DIR" || erreur "Impossible de revenir au repertoire principal"
 
+# =============================================================================
+# Cache binaire des donnees
+# =============================================================================
+
+# Le programme C analyse le fichier une seule fois et ecrit <fichier>.wwc;
+# les appels suivants lisent ce cache tant que le fichier n'a pas change
+FICHIER_CACHE="$FICHIER_DONNEES.wwc"
+if [ ! -f "$FICHIER_CACHE" ] || [ "$FICHIER_DONNEES" -nt "$FICHIER_CACHE" ]; then
+    echo "Construction du cache binaire des donnees..."
+    "$CODE_C_DIR/wildwater" index "$FICHIER_DONNEES" || erreur "La construction du cache a echoue"
+fi
+
 # =============================================================================
 # TRAITEMENT HISTOGRAMME
 # =============================================================================
@@ -121,81 +139,28 @@ if [ "$COMMANDE" = "histo" ]; then
     echo "=== Generation d'histogramme : mode $OPTION ==="
                                                                                                                                                                                                                     
                                                                                                                                                                                                                     # Definition des noms de fichiers
-                                                                                                                                                                                                                    DONNEES_FILTREES="$TEMP_DIR/donnees_filtrees.csv"
                                                                                                                                                                                                                     FICHIER_SORTIE="$TESTS_DIR/vol_$OPTION.dat"
     
-    # =========================================================================
-    # Filtrage des donnees avec grep et awk
-    # =========================================================================
-    
-    echo "Filtrage des donnees avec grep et awk..."
-    
-    # Extraction des lignes d'usines (description de capacite maximale)
-    # Format attendu : -;Usine;-;capacite;-
-    echo "  -> Extraction des capacites maximales des usines..."
-                                                                                                                                                                                                    grep -E "^-;(Plant #|Module #|Unit #|Facility complex #)" "$FICHIER_DONNEES" | \
-                                                                                                                                                                                                        grep -E ";-;[0-9]+;-$" > "$TEMP_DIR/usines.csv"
-    
-    # Extraction des lignes de captage (source vers usine)
-    # Format attendu : -;Source;Usine;volume;pourcentage
-    echo "  -> Extraction des volumes captes par les sources..."
-                                                                                                                                                                                                        grep -E "^-;(Source #|Well #|Spring #|Fountain #|Resurgence #)" "$FICHIER_DONNEES" | \
-                                                                                                                                                                                                            grep -E ";(Plant #|Module #|Unit #|Facility complex #)" > "$TEMP_DIR/captages.csv"
-    
-    # Compter le nombre de lignes extraites
-    NB_USINES=$(wc -l < "$TEMP_DIR/usines.csv")
-    NB_CAPTAGES=$(wc -l < "$TEMP_DIR/captages.csv")
-    echo "  -> $NB_USINES usines trouvees"
-    echo "  -> $NB_CAPTAGES relations de captage trouvees"
-    
-    # Combiner les deux fichiers pour le programme C
-    cat "$TEMP_DIR/usines.csv" "$TEMP_DIR/captages.csv" > "$DONNEES_FILTREES"
-    
-    # Verification que des donnees ont bien ete extraites
-    if [ ! -s "$DONNEES_FILTREES" ]; then
-        rm -f "$DONNEES_FILTREES" "$TEMP_DIR"/*.csv
-        erreur "Aucune donnee n'a pu etre extraite du fichier"
-    fi
-    
     # =========================================================================
     # Appel du programme C
     # =========================================================================
     
+    # Le programme C ecrit aussi les 50 plus petites et 10 plus grandes
+    # usines, deja triees, pour les graphiques
+    FICHIER_PETITES="$TEMP_DIR/petites_$OPTION.dat"
+    FICHIER_GRANDES="$TEMP_DIR/grandes_$OPTION.dat"
+    
     echo "Appel du programme C pour le traitement..."
-                                                                                                                            "$CODE_C_DIR/wildwater" histo "$OPTION" "$DONNEES_FILTREES" "$FICHIER_SORTIE"
+    "$CODE_C_DIR/wildwater" histo "$OPTION" "$FICHIER_DONNEES" "$FICHIER_SORTIE" \
+        --petites "$FICHIER_PETITES" --grandes "$FICHIER_GRANDES"
     
     # Verification du code retour du programme C
     if [ $? -ne 0 ]; then
-        rm -f "$DONNEES_FILTREES" "$TEMP_DIR"/*.csv
         erreur "Le programme C a retourne une erreur"
     fi
     
     echo "Traitement des donnees termine avec succes"
     
-    # =========================================================================
-    # Preparation des donnees pour gnuplot
-    # =========================================================================
-    
-    echo "Preparation des donnees pour les graphiques..."
-    
-    FICHIER_PETITES="$TEMP_DIR/petites_$OPTION.dat"
-    FICHIER_GRANDES="$TEMP_DIR/grandes_$OPTION.dat"
-    
-    if [ "$OPTION" = "all" ]; then
-        # Mode bonus : trier par le total des 3 colonnes
-        awk -F';' 'NR>1 {total=$2+$3+$4; print $0";"total}' "$FICHIER_SORTIE" | \
-            sort -t';' -k5 -n | head -50 | \
-            awk -F';' '{print $1";"$2";"$3";"$4}' > "$FICHIER_PETITES"
-        
-        awk -F';' 'NR>1 {total=$2+$3+$4; print $0";"total}' "$FICHIER_SORTIE" | \
-            sort -t';' -k5 -nr | head -10 | \
-            awk -F';' '{print $1";"$2";"$3";"$4}' > "$FICHIER_GRANDES"
-    else
-        # Mode simple : trier par la colonne 2 (valeur)
-        awk -F';' 'NR>1' "$FICHIER_SORTIE" | sort -t';' -k2 -n | head -50 > "$FICHIER_PETITES"
-        awk -F';' 'NR>1' "$FICHIER_SORTIE" | sort -t';' -k2 -nr | head -10 > "$FICHIER_GRANDES"
-    fi
-    
     # =========================================================================
     # Definition des parametres pour gnuplot selon le mode
     # =========================================================================
@@ -289,7 +254,7 @@ EOF
     fi
     
     # Nettoyage des fichiers temporaires
-    rm -f "$DONNEES_FILTREES" "$FICHIER_PETITES" "$FICHIER_GRANDES" "$TEMP_DIR"/*.csv
+    rm -f "$FICHIER_PETITES" "$FICHIER_GRANDES"
 
 # =============================================================================
 # TRAITEMENT CALCUL DES FUITES
@@ -309,7 +274,6 @@ elif [ "$COMMANDE" = "leaks" ]; then
     
     # Definition des noms de fichiers
     FICHIER_SORTIE="$TESTS_DIR/leaks.dat"
-    RESULTAT_TEMPORAIRE="$TEMP_DIR/resultat_temp.dat"
     
     # Creer le fichier avec l'en-tete s'il n'existe pas encore
     if [ ! -f "$FICHIER_SORTIE" ]; then
@@ -322,22 +286,22 @@ elif [ "$COMMANDE" = "leaks" ]; then
     # =========================================================================
     
     # Le programme C lit directement le fichier complet et extrait
-    # toutes les informations necessaires pour l'usine specifiee
+    # toutes les informations necessaires pour l'usine specifiee.
+    # Le resultat est ecrit sur la sortie standard ("-") et ajoute
+    # directement au fichier principal, sans fichier temporaire.
     echo "Appel du programme C pour le calcul des fuites..."
-    "$CODE_C_DIR/wildwater" leaks "$IDENTIFIANT_USINE" "$FICHIER_DONNEES" "$RESULTAT_TEMPORAIRE"
+    if [ "$IDENTIFIANT_USINE" = "--all" ]; then
+        # Mode lot : toutes les usines sont traitees en une seule lecture
+        "$CODE_C_DIR/wildwater" leaks --all "$FICHIER_DONNEES" - >> "$FICHIER_SORTIE"
+    else
+        "$CODE_C_DIR/wildwater" leaks "$IDENTIFIANT_USINE" "$FICHIER_DONNEES" - >> "$FICHIER_SORTIE"
+    fi
     
     # Verification du code retour du programme C
     if [ $? -ne 0 ]; then
-        rm -f "$RESULTAT_TEMPORAIRE"
         erreur "Le programme C a retourne une erreur"
     fi
     
-    # Ajouter le resultat au fichier principal (mode append)
-    if [ -f "$RESULTAT_TEMPORAIRE" ]; then
-        cat "$RESULTAT_TEMPORAIRE" >> "$FICHIER_SORTIE"
-        rm -f "$RESULTAT_TEMPORAIRE"
-    fi
-    
     echo "Calcul des fuites termine avec succes"
     echo "Resultat ajoute dans le fichier : $FICHIER_SORTIE"
     
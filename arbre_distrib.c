@@ -0,0 +1,501 @@
+/*
+ * arbre_distrib.c - Implementation de l'arbre de distribution
+ * Projet C-Wildwater
+ *
+ * Le volume entrant dans un noeud est reparti equitablement entre
+ * ses enfants. Chaque troncon perd un pourcentage du volume qu'il
+ * transporte: ce sont ces pertes cumulees qui forment les fuites.
+ *
+ * L'AVL d'index suit la meme convention d'equilibre que avl.c:
+ * eq = hauteur(droite) - hauteur(gauche)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "avl.h"
+#include "identifiants.h"
+#include "arbre_distrib.h"
+
+/* ========== Reseau ========== */
+
+/* Initialise un reseau vide */
+void initialiserReseau(Reseau *reseau) {
+    reseau->noeuds = NULL;
+    reseau->nbNoeuds = 0;
+    reseau->capaciteNoeuds = 0;
+    reseau->index = NULL;
+    reseau->nbIndex = 0;
+    reseau->capaciteIndex = 0;
+    reseau->liens = NULL;
+    reseau->nbLiens = 0;
+    reseau->capaciteLiens = 0;
+    reseau->debutEnfants = NULL;
+    reseau->enfants = NULL;
+    reseau->pourcentages = NULL;
+    reseau->passages = NULL;
+    reseau->pile = NULL;
+    reseau->capacitePile = 0;
+    reseau->passage = 0;
+    reseau->nbRevisites = 0;
+    reseau->profondeurMax = 0;
+    reseau->nbRotations = 0;
+}
+
+/* Libere en une fois l'arbre et l'index */
+void libererReseau(Reseau *reseau) {
+    free(reseau->noeuds);
+    free(reseau->index);
+    free(reseau->liens);
+    free(reseau->debutEnfants);
+    free(reseau->enfants);
+    free(reseau->pourcentages);
+    free(reseau->passages);
+    free(reseau->pile);
+    initialiserReseau(reseau);
+}
+
+/* ========== Arbre de distribution ========== */
+
+/* Cree un noeud de l'arbre de distribution */
+uint32_t creerArbre(Reseau *reseau, uint32_t identifiant, double pourcentage) {
+    uint32_t nouveau = reserverElement((void**)&reseau->noeuds, &reseau->nbNoeuds,
+                                       &reseau->capaciteNoeuds, sizeof(Arbre));
+    Arbre *n = NOEUD_ARBRE(reseau, nouveau);
+
+    n->identifiant = identifiant;
+    n->pourcentage = pourcentage;
+    n->volume = 0.0;
+    n->parent = INDICE_NUL;
+    return nouveau;
+}
+
+/*
+ * Enregistre le troncon parent -> enfant (premiere phase de construction)
+ * L'enfant ne doit pas deja etre rattache: un noeud n'a qu'un parent.
+ */
+void ajouterEnfant(Reseau *reseau, uint32_t parent, uint32_t enfant) {
+    uint32_t lien = reserverElement((void**)&reseau->liens, &reseau->nbLiens,
+                                    &reseau->capaciteLiens, sizeof(Lien));
+
+    reseau->liens[lien].parent = parent;
+    reseau->liens[lien].enfant = enfant;
+    NOEUD_ARBRE(reseau, enfant)->parent = parent;
+}
+
+/* Alloue un tableau de nb elements (au moins un) mis a zero */
+static void* allouerZeros(size_t nb, size_t taille) {
+    void *tableau = calloc((nb > 0) ? nb : 1, taille);
+
+    if (tableau == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+    return tableau;
+}
+
+/*
+ * Range les troncons enregistres au format CSR (seconde phase)
+ * Tri par denombrement sur le parent, en O(noeuds + troncons). Les
+ * troncons sont places du dernier lu au premier: chaque noeud garde
+ * l'ordre d'enfants de l'ancienne liste chainee, donc les memes sommes
+ * flottantes. A appeler une fois, apres le dernier ajouterEnfant et
+ * avant le premier calculerFuites.
+ */
+void compacterReseau(Reseau *reseau) {
+    uint32_t nbNoeuds = reseau->nbNoeuds;
+    uint32_t *debut;
+    uint32_t i, p, position;
+    Lien *lien;
+
+    free(reseau->debutEnfants);
+    free(reseau->enfants);
+    free(reseau->pourcentages);
+    free(reseau->passages);
+
+    debut = (uint32_t*)allouerZeros((size_t)nbNoeuds + 1, sizeof(uint32_t));
+    reseau->enfants = (uint32_t*)allouerZeros(reseau->nbLiens, sizeof(uint32_t));
+    reseau->pourcentages = (double*)allouerZeros(reseau->nbLiens, sizeof(double));
+    reseau->passages = (uint32_t*)allouerZeros(nbNoeuds, sizeof(uint32_t));
+
+    /* Nombre d'enfants de chaque noeud, puis position du premier */
+    for (i = 1; i < reseau->nbLiens; i++)
+        debut[reseau->liens[i].parent + 1]++;
+    for (p = 1; p <= nbNoeuds; p++)
+        debut[p] += debut[p - 1];
+
+    /* Placement: debut[p] avance jusqu'au debut du noeud p + 1 */
+    for (i = reseau->nbLiens; i > 1; i--) {
+        lien = &reseau->liens[i - 1];
+        position = debut[lien->parent]++;
+        reseau->enfants[position] = lien->enfant;
+        reseau->pourcentages[position] = NOEUD_ARBRE(reseau, lien->enfant)->pourcentage;
+    }
+    for (p = nbNoeuds; p > 0; p--)
+        debut[p] = debut[p - 1];
+    debut[0] = 0;
+    reseau->debutEnfants = debut;
+
+    free(reseau->liens);
+    reseau->liens = NULL;
+    reseau->nbLiens = 0;
+    reseau->capaciteLiens = 0;
+}
+
+/* Empile un noeud et le volume qui y entre */
+static void empiler(Reseau *reseau, uint32_t *nb, uint32_t noeud, uint32_t profondeur,
+                    double volume) {
+    if (*nb == reseau->capacitePile) {
+        uint32_t capacite = (reseau->capacitePile == 0) ? 1024 : reseau->capacitePile * 2;
+        EtapeFuite *agrandie = (EtapeFuite*)realloc(reseau->pile, (size_t)capacite * sizeof(EtapeFuite));
+        if (agrandie == NULL) {
+            fprintf(stderr, "Erreur: allocation memoire echouee\n");
+            exit(EXIT_FAILURE);
+        }
+        reseau->pile = agrandie;
+        reseau->capacitePile = capacite;
+    }
+    reseau->pile[*nb].noeud = noeud;
+    reseau->pile[*nb].profondeur = profondeur;
+    reseau->pile[*nb].volume = volume;
+    (*nb)++;
+}
+
+/* ========== Pires troncons (tas borne) ========== */
+
+/* Vrai si a doit etre plus pres de la racine que b: perte plus petite,
+ * puis identifiant aval plus grand a perte egale */
+static int moinsFuyard(const Reseau *reseau, const PerteTroncon *a, const PerteTroncon *b) {
+    if (a->perte != b->perte)
+        return a->perte < b->perte;
+    return comparerIdentifiants(reseau->noeuds[a->aval].identifiant,
+                                reseau->noeuds[b->aval].identifiant) > 0;
+}
+
+/* Fait descendre l'element i du tas des nb premiers troncons */
+static void descendreTroncon(const Reseau *reseau, PerteTroncon *tas, int nb, int i) {
+    PerteTroncon tmp;
+    int fils, cible;
+
+    for (;;) {
+        cible = i;
+        fils = 2 * i + 1;
+        if (fils < nb && moinsFuyard(reseau, &tas[fils], &tas[cible]))
+            cible = fils;
+        fils++;
+        if (fils < nb && moinsFuyard(reseau, &tas[fils], &tas[cible]))
+            cible = fils;
+        if (cible == i)
+            return;
+        tmp = tas[i];
+        tas[i] = tas[cible];
+        tas[cible] = tmp;
+        i = cible;
+    }
+}
+
+/* Propose un troncon: il est retenu s'il fait partie des plus fuyards */
+static void proposerTroncon(const Reseau *reseau, DetailFuites *detail, const PerteTroncon *troncon) {
+    PerteTroncon *tas = detail->pires;
+    PerteTroncon tmp;
+    int i, parent;
+
+    if (detail->nbPires < NB_PIRES_TRONCONS) {
+        i = detail->nbPires++;
+        tas[i] = *troncon;
+        while (i > 0) {
+            parent = (i - 1) / 2;
+            if (!moinsFuyard(reseau, &tas[i], &tas[parent]))
+                break;
+            tmp = tas[i];
+            tas[i] = tas[parent];
+            tas[parent] = tmp;
+            i = parent;
+        }
+    } else if (moinsFuyard(reseau, &tas[0], troncon)) {
+        tas[0] = *troncon;
+        descendreTroncon(reseau, tas, detail->nbPires, 0);
+    }
+}
+
+/*
+ * Range les troncons retenus du plus fuyard au moins fuyard
+ * (extractions successives de la racine; le tableau n'est plus un tas)
+ */
+void trierPiresTroncons(const Reseau *reseau, DetailFuites *detail) {
+    PerteTroncon tmp;
+    int i;
+
+    for (i = detail->nbPires - 1; i > 0; i--) {
+        tmp = detail->pires[0];
+        detail->pires[0] = detail->pires[i];
+        detail->pires[i] = tmp;
+        descendreTroncon(reseau, detail->pires, i, 0);
+    }
+}
+
+/* ========== Calcul des fuites ========== */
+
+/*
+ * Parcours commun a calculerFuites et calculerFuitesDetail
+ * detail: NULL, ou pertes a noter troncon par troncon
+ *
+ * Parcours en profondeur avec une pile explicite: chaque noeud est
+ * empile au plus une fois, la memoire est bornee par la taille du
+ * reseau. Le reseau doit avoir ete compacte (compacterReseau).
+ * Un troncon vers un noeud deja atteint par ce calcul compte sa propre
+ * perte, mais le sous-arbre n'est pas parcouru une seconde fois
+ * (reseau->nbRevisites est incremente).
+ */
+static double parcourirFuites(Reseau *reseau, uint32_t noeud, double volume, DetailFuites *detail) {
+    const uint32_t *debutEnfants = reseau->debutEnfants;
+    const uint32_t *enfants = reseau->enfants;
+    const double *pourcentages = reseau->pourcentages;
+    uint32_t *passages = reseau->passages;
+    uint32_t enfant, nb = 0;
+    uint32_t passage, k, debut, fin;
+    double part, perte;
+    double total = 0.0;
+    EtapeFuite etape;
+    PerteTroncon troncon;
+
+    reseau->nbRevisites = 0;
+    if (noeud == INDICE_NUL)
+        return 0.0;
+
+    /* Nouveau numero de parcours: les marques precedentes sont perimees */
+    passage = ++reseau->passage;
+    passages[noeud] = passage;
+    empiler(reseau, &nb, noeud, 0, volume);
+    if (detail != NULL) {
+        detail->cumuls[noeud] = 0.0;
+        detail->pireNoeud = noeud;
+    }
+
+    while (nb > 0) {
+        etape = reseau->pile[--nb];
+        if (etape.profondeur > reseau->profondeurMax)
+            reseau->profondeurMax = etape.profondeur;
+
+        debut = debutEnfants[etape.noeud];
+        fin = debutEnfants[etape.noeud + 1];
+        if (debut == fin)
+            continue;
+
+        /* Repartition equitable du volume entre les enfants */
+        part = etape.volume / (double)(fin - debut);
+
+        for (k = debut; k < fin; k++) {
+            enfant = enfants[k];
+            perte = part * pourcentages[k] / 100.0;
+            total += perte;
+
+            if (detail != NULL) {
+                troncon.amont = etape.noeud;
+                troncon.aval = enfant;
+                troncon.perte = perte;
+                proposerTroncon(reseau, detail, &troncon);
+            }
+
+            if (passages[enfant] == passage) {
+                reseau->nbRevisites++;
+                continue;
+            }
+            passages[enfant] = passage;
+            empiler(reseau, &nb, enfant, etape.profondeur + 1, part - perte);
+
+            if (detail != NULL) {
+                detail->cumuls[enfant] = detail->cumuls[etape.noeud] + perte;
+                if (detail->cumuls[enfant] > detail->cumuls[detail->pireNoeud])
+                    detail->pireNoeud = enfant;
+            }
+        }
+    }
+
+    return total;
+}
+
+/*
+ * Calcule les fuites en aval d'un noeud
+ * volume: volume entrant dans le noeud
+ * Retourne le volume total perdu dans le sous-arbre
+ */
+double calculerFuites(Reseau *reseau, uint32_t noeud, double volume) {
+    return parcourirFuites(reseau, noeud, volume, NULL);
+}
+
+/*
+ * Calcule les fuites comme calculerFuites, en un seul parcours qui
+ * remplit aussi detail: les NB_PIRES_TRONCONS troncons les plus fuyards
+ * (tas borne, sans tri de tous les troncons) et le bout du chemin de
+ * plus forte perte cumulee. detail est libere par libererDetailFuites.
+ */
+double calculerFuitesDetail(Reseau *reseau, uint32_t noeud, double volume, DetailFuites *detail) {
+    detail->nbPires = 0;
+    detail->pireNoeud = INDICE_NUL;
+    detail->cumuls = (double*)allouerZeros(reseau->nbNoeuds, sizeof(double));
+    return parcourirFuites(reseau, noeud, volume, detail);
+}
+
+/*
+ * Chemin du depart jusqu'au bout du chemin de plus forte perte cumulee,
+ * remonte par les parents
+ * Retourne un tableau alloue de *nb indices de noeuds, depart en premier
+ */
+uint32_t* cheminPireFuite(Reseau *reseau, uint32_t depart, const DetailFuites *detail, uint32_t *nb) {
+    uint32_t *chemin;
+    uint32_t noeud, i;
+
+    *nb = 0;
+    if (detail->pireNoeud == INDICE_NUL)
+        return (uint32_t*)allouerZeros(1, sizeof(uint32_t));
+
+    /* Longueur, puis remplissage depuis la fin */
+    for (noeud = detail->pireNoeud; ; noeud = NOEUD_ARBRE(reseau, noeud)->parent) {
+        (*nb)++;
+        if (noeud == depart)
+            break;
+    }
+    chemin = (uint32_t*)allouerZeros(*nb, sizeof(uint32_t));
+    noeud = detail->pireNoeud;
+    for (i = *nb; i > 0; i--) {
+        chemin[i - 1] = noeud;
+        noeud = NOEUD_ARBRE(reseau, noeud)->parent;
+    }
+    return chemin;
+}
+
+/* Libere les pertes cumulees d'un detail */
+void libererDetailFuites(DetailFuites *detail) {
+    free(detail->cumuls);
+    detail->cumuls = NULL;
+    detail->nbPires = 0;
+}
+
+/* ========== AVL d'index ========== */
+
+/* Cree un noeud d'index pointant vers un noeud de l'arbre */
+static uint32_t creerNoeudIndex(Reseau *reseau, uint32_t noeud) {
+    uint32_t nouveau = reserverElement((void**)&reseau->index, &reseau->nbIndex,
+                                       &reseau->capaciteIndex, sizeof(AVL_Index));
+    AVL_Index *n = NOEUD_INDEX(reseau, nouveau);
+
+    n->identifiant = NOEUD_ARBRE(reseau, noeud)->identifiant;
+    n->noeud = noeud;
+    n->eq = 0;
+    n->fg = INDICE_NUL;
+    n->fd = INDICE_NUL;
+    return nouveau;
+}
+
+/* Rotation gauche (memes formules que rotationGauche dans avl.c) */
+static uint32_t rotationGaucheIndex(Reseau *reseau, uint32_t a) {
+    AVL_Index *na = NOEUD_INDEX(reseau, a);
+    uint32_t pivot = na->fd;
+    AVL_Index *np = NOEUD_INDEX(reseau, pivot);
+    int eq_a = na->eq;
+    int eq_p = np->eq;
+
+    na->fd = np->fg;
+    np->fg = a;
+    reseau->nbRotations++;
+
+    na->eq = eq_a - max(eq_p, 0) - 1;
+    np->eq = min3(eq_a - 2, eq_a + eq_p - 2, eq_p - 1);
+
+    return pivot;
+}
+
+/* Rotation droite (memes formules que rotationDroite dans avl.c) */
+static uint32_t rotationDroiteIndex(Reseau *reseau, uint32_t a) {
+    AVL_Index *na = NOEUD_INDEX(reseau, a);
+    uint32_t pivot = na->fg;
+    AVL_Index *np = NOEUD_INDEX(reseau, pivot);
+    int eq_a = na->eq;
+    int eq_p = np->eq;
+
+    na->fg = np->fd;
+    np->fd = a;
+    reseau->nbRotations++;
+
+    na->eq = eq_a - min(eq_p, 0) + 1;
+    np->eq = max3(eq_a + 2, eq_a + eq_p + 2, eq_p + 1);
+
+    return pivot;
+}
+
+/* Equilibre l'AVL d'index si necessaire */
+static uint32_t equilibrerAVLIndex(Reseau *reseau, uint32_t a) {
+    AVL_Index *na = NOEUD_INDEX(reseau, a);
+
+    if (na->eq >= 2) {
+        if (NOEUD_INDEX(reseau, na->fd)->eq < 0)
+            na->fd = rotationDroiteIndex(reseau, na->fd);
+        return rotationGaucheIndex(reseau, a);
+    } else if (na->eq <= -2) {
+        if (NOEUD_INDEX(reseau, na->fg)->eq > 0)
+            na->fg = rotationGaucheIndex(reseau, na->fg);
+        return rotationDroiteIndex(reseau, a);
+    }
+    return a;
+}
+
+/*
+ * Insere un identifiant dans l'AVL d'index
+ * Si l'identifiant existe deja, l'index n'est pas modifie
+ * Retourne l'indice de la nouvelle racine du sous-arbre
+ */
+uint32_t insererAVLIndex(Reseau *reseau, uint32_t a, uint32_t identifiant, uint32_t noeud, int *h) {
+    uint32_t fils, id;
+
+    if (a == INDICE_NUL) {
+        *h = 1;
+        return creerNoeudIndex(reseau, noeud);
+    }
+
+    id = NOEUD_INDEX(reseau, a)->identifiant;
+
+    /* L'insertion peut deplacer le pool: le fils est rattache par indice */
+    if (identifiant < id) {
+        fils = insererAVLIndex(reseau, NOEUD_INDEX(reseau, a)->fg, identifiant, noeud, h);
+        NOEUD_INDEX(reseau, a)->fg = fils;
+        *h = -*h;
+    } else if (identifiant > id) {
+        fils = insererAVLIndex(reseau, NOEUD_INDEX(reseau, a)->fd, identifiant, noeud, h);
+        NOEUD_INDEX(reseau, a)->fd = fils;
+    } else {
+        *h = 0;
+        return a;
+    }
+
+    if (*h != 0) {
+        NOEUD_INDEX(reseau, a)->eq += *h;
+        a = equilibrerAVLIndex(reseau, a);
+        *h = (NOEUD_INDEX(reseau, a)->eq == 0) ? 0 : 1;
+    }
+
+    return a;
+}
+
+/* Recherche un noeud de l'arbre par son identifiant (INDICE_NUL si absent) */
+uint32_t rechercherAVLIndex(Reseau *reseau, uint32_t racine, uint32_t identifiant) {
+    uint32_t id;
+
+    while (racine != INDICE_NUL) {
+        id = NOEUD_INDEX(reseau, racine)->identifiant;
+        if (identifiant == id)
+            return NOEUD_INDEX(reseau, racine)->noeud;
+        racine = (identifiant < id) ? NOEUD_INDEX(reseau, racine)->fg : NOEUD_INDEX(reseau, racine)->fd;
+    }
+    return INDICE_NUL;
+}
+
+/* Parcours infixe (ordre des numeros d'identifiant) de l'index */
+void parcoursAVLIndex(Reseau *reseau, uint32_t racine,
+                      void (*visiter)(Reseau *, uint32_t, void *), void *contexte) {
+    if (racine == INDICE_NUL)
+        return;
+    parcoursAVLIndex(reseau, NOEUD_INDEX(reseau, racine)->fg, visiter, contexte);
+    visiter(reseau, NOEUD_INDEX(reseau, racine)->noeud, contexte);
+    parcoursAVLIndex(reseau, NOEUD_INDEX(reseau, racine)->fd, visiter, contexte);
+}
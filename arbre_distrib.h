@@ -0,0 +1,139 @@
+/*
+ * arbre_distrib.h - En-tete pour l'arbre de distribution
+ * Projet C-Wildwater - Calcul des fuites d'une usine
+ *
+ * Le reseau aval d'une usine est represente par un arbre n-aire:
+ * usine -> stockages -> jonctions -> raccordements -> usagers.
+ *
+ * La construction se fait en deux temps. Pendant la lecture, chaque
+ * troncon parent -> enfant est simplement ajoute a un tableau. Ensuite
+ * compacterReseau range les troncons au format CSR (compressed sparse
+ * row): les enfants du noeud i occupent les cases debutEnfants[i] a
+ * debutEnfants[i + 1] - 1 des tableaux enfants et pourcentages. Le
+ * calcul des fuites lit ainsi des tableaux contigus au lieu de suivre
+ * une liste chainee. Les enfants d'un noeud y sont ranges du dernier
+ * troncon lu au premier, comme l'ancienne liste chainee.
+ *
+ * Un AVL d'index (AVL_Index) associe l'identifiant de chaque noeud
+ * a son adresse dans l'arbre, pour le retrouver en O(log n).
+ *
+ * Les noeuds de l'arbre et de l'index sont ranges dans les pools d'un
+ * Reseau et designes par leur indice (INDICE_NUL = aucun noeud).
+ * Tout le reseau est libere d'un coup par libererReseau.
+ *
+ * Le calcul des fuites parcourt l'arbre avec une pile explicite: la
+ * profondeur du reseau ne depend pas de la pile d'appels. Un noeud n'a
+ * qu'un parent, mais un fichier mal forme peut boucler sur une racine:
+ * un noeud atteint deux fois au cours d'un meme calcul n'est parcouru
+ * qu'une fois, et ces troncons sont comptes dans nbRevisites.
+ *
+ * calculerFuitesDetail fait le meme parcours en notant la perte de
+ * chaque troncon: un tas borne garde les NB_PIRES_TRONCONS troncons les
+ * plus fuyards, et la perte cumulee depuis le depart designe le noeud au
+ * bout du chemin le plus couteux, remonte ensuite par les parents.
+ *
+ * Les identifiants sont des numeros de la table des identifiants:
+ * l'index est range par numero, pas par ordre alphabetique.
+ */
+
+#ifndef ARBRE_DISTRIB_H
+#define ARBRE_DISTRIB_H
+
+#include "memoire.h"
+
+/* Noeud de l'arbre de distribution */
+typedef struct Arbre {
+    double pourcentage;        /* Pourcentage de fuite du troncon parent -> noeud */
+    double volume;             /* Volume entrant (renseigne pour les usines) */
+    uint32_t identifiant;      /* Numero de l'identifiant du noeud */
+    uint32_t parent;           /* Indice du parent (INDICE_NUL pour une racine) */
+} Arbre;
+
+/* Troncon en attente de compactage */
+typedef struct Lien {
+    uint32_t parent;
+    uint32_t enfant;
+} Lien;
+
+/* Noeud en attente dans la pile du parcours des fuites */
+typedef struct EtapeFuite {
+    uint32_t noeud;
+    uint32_t profondeur;       /* Nombre de troncons depuis le noeud de depart */
+    double volume;             /* Volume entrant dans le noeud */
+} EtapeFuite;
+
+/* Nombre de troncons retenus par calculerFuitesDetail (leaks --detail) */
+#define NB_PIRES_TRONCONS 10
+
+/* Perte d'un troncon amont -> aval (indices de noeuds) */
+typedef struct PerteTroncon {
+    uint32_t amont;
+    uint32_t aval;
+    double perte;
+} PerteTroncon;
+
+/* Detail d'un calcul de fuites */
+typedef struct DetailFuites {
+    PerteTroncon pires[NB_PIRES_TRONCONS];  /* Tas borne: la plus petite perte a la racine */
+    int nbPires;
+    double *cumuls;            /* Perte cumulee depuis le depart, par noeud */
+    uint32_t pireNoeud;        /* Bout du chemin de plus forte perte cumulee */
+} DetailFuites;
+
+/* Noeud de l'AVL d'index */
+typedef struct AVL_Index {
+    uint32_t identifiant;      /* Cle de recherche (numero d'identifiant) */
+    uint32_t noeud;            /* Indice du noeud correspondant dans l'arbre */
+    int eq;                    /* Facteur d'equilibre: droite - gauche */
+    uint32_t fg;               /* Indice du fils gauche */
+    uint32_t fd;               /* Indice du fils droit */
+} AVL_Index;
+
+/* Pools des noeuds de l'arbre et de l'index */
+typedef struct Reseau {
+    Arbre *noeuds;             /* noeuds[0] est reserve (INDICE_NUL) */
+    uint32_t nbNoeuds;
+    uint32_t capaciteNoeuds;
+    AVL_Index *index;          /* index[0] est reserve (INDICE_NUL) */
+    uint32_t nbIndex;
+    uint32_t capaciteIndex;
+    Lien *liens;               /* Troncons lus (liens[0] reserve), liberes au compactage */
+    uint32_t nbLiens;
+    uint32_t capaciteLiens;
+    uint32_t *debutEnfants;    /* CSR: nbNoeuds + 1 positions, NULL avant compactage */
+    uint32_t *enfants;         /* CSR: indice de chaque enfant */
+    double *pourcentages;      /* CSR: pourcentage de fuite de chaque troncon */
+    uint32_t *passages;        /* Dernier parcours qui a atteint chaque noeud */
+    EtapeFuite *pile;          /* Pile du parcours, reutilisee d'un calcul a l'autre */
+    uint32_t capacitePile;
+    uint32_t passage;          /* Numero du dernier parcours */
+    uint32_t nbRevisites;      /* Troncons vers un noeud deja atteint (dernier calcul) */
+    uint32_t profondeurMax;    /* Plus grande profondeur atteinte par les calculs (--stats) */
+    uint64_t nbRotations;      /* Rotations de l'AVL d'index (--stats) */
+} Reseau;
+
+/* Acces aux noeuds par indice */
+#define NOEUD_ARBRE(reseau, i) (&(reseau)->noeuds[(i)])
+#define NOEUD_INDEX(reseau, i) (&(reseau)->index[(i)])
+
+/* Reseau */
+void initialiserReseau(Reseau *reseau);
+void libererReseau(Reseau *reseau);
+
+/* Arbre de distribution */
+uint32_t creerArbre(Reseau *reseau, uint32_t identifiant, double pourcentage);
+void ajouterEnfant(Reseau *reseau, uint32_t parent, uint32_t enfant);
+void compacterReseau(Reseau *reseau);
+double calculerFuites(Reseau *reseau, uint32_t noeud, double volume);
+double calculerFuitesDetail(Reseau *reseau, uint32_t noeud, double volume, DetailFuites *detail);
+void trierPiresTroncons(const Reseau *reseau, DetailFuites *detail);
+uint32_t* cheminPireFuite(Reseau *reseau, uint32_t depart, const DetailFuites *detail, uint32_t *nb);
+void libererDetailFuites(DetailFuites *detail);
+
+/* AVL d'index */
+uint32_t insererAVLIndex(Reseau *reseau, uint32_t a, uint32_t identifiant, uint32_t noeud, int *h);
+uint32_t rechercherAVLIndex(Reseau *reseau, uint32_t racine, uint32_t identifiant);
+void parcoursAVLIndex(Reseau *reseau, uint32_t racine,
+                      void (*visiter)(Reseau *, uint32_t, void *), void *contexte);
+
+#endif
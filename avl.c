@@ -13,6 +13,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "avl.h"
+#include "identifiants.h"
 
 /* ========== Fonctions utilitaires ========== */
 
@@ -36,19 +37,28 @@ int min3(int a, int b, int c) {
     return min(min(a, b), c);
 }
 
+/* ========== Pool ========== */
+
+/* Initialise un pool vide (l'arbre correspondant est INDICE_NUL) */
+void initialiserPoolAVL(PoolAVL *pool) {
+    pool->noeuds = NULL;
+    pool->nb = 0;
+    pool->capacite = 0;
+    pool->nbRotations = 0;
+}
+
 /* ========== Creation de noeud ========== */
 
 /* Cree un nouveau noeud avec les donnees de l'usine */
-NoeudAVL* creerNoeud(Usine usine) {
-    NoeudAVL *nouveau = (NoeudAVL*)malloc(sizeof(NoeudAVL));
-    if (nouveau == NULL) {
-        fprintf(stderr, "Erreur: allocation memoire echouee\n");
-        exit(EXIT_FAILURE);
-    }
-    nouveau->usine = usine;
-    nouveau->fg = NULL;
-    nouveau->fd = NULL;
-    nouveau->eq = 0;  /* Facteur d'equilibre initialise a 0 */
+uint32_t creerNoeud(PoolAVL *pool, Usine usine) {
+    uint32_t nouveau = reserverElement((void**)&pool->noeuds, &pool->nb,
+                                       &pool->capacite, sizeof(NoeudAVL));
+    NoeudAVL *n = NOEUD_AVL(pool, nouveau);
+
+    n->usine = usine;
+    n->fg = INDICE_NUL;
+    n->fd = INDICE_NUL;
+    n->eq = 0;  /* Facteur d'equilibre initialise a 0 */
     return nouveau;
 }
 
@@ -64,18 +74,21 @@ NoeudAVL* creerNoeud(Usine usine) {
  *      /  \             \
  *     T2   fd           T2
  */
-NoeudAVL* rotationGauche(NoeudAVL *a) {
-    NoeudAVL *pivot = a->fd;
-    int eq_a = a->eq;
-    int eq_p = pivot->eq;
+uint32_t rotationGauche(PoolAVL *pool, uint32_t a) {
+    NoeudAVL *na = NOEUD_AVL(pool, a);
+    uint32_t pivot = na->fd;
+    NoeudAVL *np = NOEUD_AVL(pool, pivot);
+    int eq_a = na->eq;
+    int eq_p = np->eq;
 
     /* Effectuer la rotation */
-    a->fd = pivot->fg;
-    pivot->fg = a;
+    na->fd = np->fg;
+    np->fg = a;
+    pool->nbRotations++;
 
     /* Mise a jour des facteurs d'equilibre selon le cours */
-    a->eq = eq_a - max(eq_p, 0) - 1;
-    pivot->eq = min3(eq_a - 2, eq_a + eq_p - 2, eq_p - 1);
+    na->eq = eq_a - max(eq_p, 0) - 1;
+    np->eq = min3(eq_a - 2, eq_a + eq_p - 2, eq_p - 1);
 
     return pivot;
 }
@@ -90,18 +103,21 @@ NoeudAVL* rotationGauche(NoeudAVL *a) {
  *    /  \                   /
  *   fg   T2                T2
  */
-NoeudAVL* rotationDroite(NoeudAVL *a) {
-    NoeudAVL *pivot = a->fg;
-    int eq_a = a->eq;
-    int eq_p = pivot->eq;
+uint32_t rotationDroite(PoolAVL *pool, uint32_t a) {
+    NoeudAVL *na = NOEUD_AVL(pool, a);
+    uint32_t pivot = na->fg;
+    NoeudAVL *np = NOEUD_AVL(pool, pivot);
+    int eq_a = na->eq;
+    int eq_p = np->eq;
 
     /* Effectuer la rotation */
-    a->fg = pivot->fd;
-    pivot->fd = a;
+    na->fg = np->fd;
+    np->fd = a;
+    pool->nbRotations++;
 
     /* Mise a jour des facteurs d'equilibre selon le cours */
-    a->eq = eq_a - min(eq_p, 0) + 1;
-    pivot->eq = max3(eq_a + 2, eq_a + eq_p + 2, eq_p + 1);
+    na->eq = eq_a - min(eq_p, 0) + 1;
+    np->eq = max3(eq_a + 2, eq_a + eq_p + 2, eq_p + 1);
 
     return pivot;
 }
@@ -110,18 +126,20 @@ NoeudAVL* rotationDroite(NoeudAVL *a) {
  * Double rotation gauche (rotation droite-gauche)
  * Utilisee quand eq >= 2 et pivot->eq < 0
  */
-NoeudAVL* doubleRotationGauche(NoeudAVL *a) {
-    a->fd = rotationDroite(a->fd);
-    return rotationGauche(a);
+uint32_t doubleRotationGauche(PoolAVL *pool, uint32_t a) {
+    NoeudAVL *na = NOEUD_AVL(pool, a);
+    na->fd = rotationDroite(pool, na->fd);
+    return rotationGauche(pool, a);
 }
 
 /*
  * Double rotation droite (rotation gauche-droite)
  * Utilisee quand eq <= -2 et pivot->eq > 0
  */
-NoeudAVL* doubleRotationDroite(NoeudAVL *a) {
-    a->fg = rotationGauche(a->fg);
-    return rotationDroite(a);
+uint32_t doubleRotationDroite(PoolAVL *pool, uint32_t a) {
+    NoeudAVL *na = NOEUD_AVL(pool, a);
+    na->fg = rotationGauche(pool, na->fg);
+    return rotationDroite(pool, a);
 }
 
 /* ========== Equilibrage ========== */
@@ -130,20 +148,22 @@ NoeudAVL* doubleRotationDroite(NoeudAVL *a) {
  * Equilibre l'arbre AVL si necessaire
  * Applique les rotations appropriees selon le facteur d'equilibre
  */
-NoeudAVL* equilibrerAVL(NoeudAVL *a) {
-    if (a->eq >= 2) {
+uint32_t equilibrerAVL(PoolAVL *pool, uint32_t a) {
+    NoeudAVL *na = NOEUD_AVL(pool, a);
+
+    if (na->eq >= 2) {
         /* Desequilibre a droite */
-        if (a->fd->eq >= 0) {
-            return rotationGauche(a);
+        if (NOEUD_AVL(pool, na->fd)->eq >= 0) {
+            return rotationGauche(pool, a);
         } else {
-            return doubleRotationGauche(a);
+            return doubleRotationGauche(pool, a);
         }
-    } else if (a->eq <= -2) {
+    } else if (na->eq <= -2) {
         /* Desequilibre a gauche */
-        if (a->fg->eq <= 0) {
-            return rotationDroite(a);
+        if (NOEUD_AVL(pool, na->fg)->eq <= 0) {
+            return rotationDroite(pool, a);
         } else {
-            return doubleRotationDroite(a);
+            return doubleRotationDroite(pool, a);
         }
     }
     return a;  /* Pas de reequilibrage necessaire */
@@ -151,49 +171,63 @@ NoeudAVL* equilibrerAVL(NoeudAVL *a) {
 
 /* ========== Insertion ========== */
 
+/*
+ * Cumule les valeurs d'une usine deja presente
+ * Ne met a jour capacite_max que si la nouvelle valeur est non nulle.
+ */
+static void cumulerValeurs(Usine *cible, const Usine *ajout) {
+    if (ajout->capacite_max > 0) {
+        cible->capacite_max = ajout->capacite_max;
+    }
+    cible->volume_capte += ajout->volume_capte;
+    cible->volume_traite += ajout->volume_traite;
+}
+
 /*
  * Insere une usine dans l'AVL et reequilibre si necessaire
  * h: pointeur pour indiquer si la hauteur a change
  *    h = 1  -> hauteur augmentee
  *    h = 0  -> hauteur inchangee
  *    h = -1 -> hauteur diminuee
+ * Retourne l'indice de la nouvelle racine du sous-arbre
  */
-NoeudAVL* insererAVL(NoeudAVL *a, Usine usine, int *h) {
-    int cmp;
+uint32_t insererAVL(PoolAVL *pool, uint32_t a, Usine usine, int *h) {
+    NoeudAVL *na;
+    uint32_t fils;
+    uint32_t id;
 
     /* Cas de base: arbre vide */
-    if (a == NULL) {
+    if (a == INDICE_NUL) {
         *h = 1;  /* La hauteur a augmente */
-        return creerNoeud(usine);
+        return creerNoeud(pool, usine);
     }
 
-    /* Comparer les identifiants pour trouver la position */
-    cmp = strcmp(usine.identifiant, a->usine.identifiant);
+    /* Comparer les numeros d'identifiant pour trouver la position */
+    id = NOEUD_AVL(pool, a)->usine.identifiant;
 
-    if (cmp < 0) {
+    /* L'insertion peut deplacer le pool: le fils est rattache par indice */
+    if (usine.identifiant < id) {
         /* Inserer a gauche */
-        a->fg = insererAVL(a->fg, usine, h);
+        fils = insererAVL(pool, NOEUD_AVL(pool, a)->fg, usine, h);
+        NOEUD_AVL(pool, a)->fg = fils;
         *h = -*h;  /* Inverser car insertion a gauche (eq = droite - gauche) */
-    } else if (cmp > 0) {
+    } else if (usine.identifiant > id) {
         /* Inserer a droite */
-        a->fd = insererAVL(a->fd, usine, h);
+        fils = insererAVL(pool, NOEUD_AVL(pool, a)->fd, usine, h);
+        NOEUD_AVL(pool, a)->fd = fils;
     } else {
         /* Usine deja presente: mettre a jour les valeurs */
-        /* Ne mettre a jour capacite_max que si la nouvelle valeur est non nulle */
-        if (usine.capacite_max > 0) {
-            a->usine.capacite_max = usine.capacite_max;
-        }
-        a->usine.volume_capte += usine.volume_capte;
-        a->usine.volume_traite += usine.volume_traite;
+        na = NOEUD_AVL(pool, a);
+        cumulerValeurs(&na->usine, &usine);
         *h = 0;
         return a;
     }
 
     /* Mise a jour du facteur d'equilibre et reequilibrage */
     if (*h != 0) {
-        a->eq += *h;
-        a = equilibrerAVL(a);
-        *h = (a->eq == 0) ? 0 : 1;
+        NOEUD_AVL(pool, a)->eq += *h;
+        a = equilibrerAVL(pool, a);
+        *h = (NOEUD_AVL(pool, a)->eq == 0) ? 0 : 1;
     }
 
     return a;
@@ -201,74 +235,566 @@ NoeudAVL* insererAVL(NoeudAVL *a, Usine usine, int *h) {
 
 /* ========== Recherche ========== */
 
-/* Recherche une usine par son identifiant */
-NoeudAVL* rechercherAVL(NoeudAVL *racine, char *identifiant) {
-    int cmp;
+/* Recherche une usine par son identifiant (INDICE_NUL si absente) */
+uint32_t rechercherAVL(PoolAVL *pool, uint32_t racine, char *identifiant) {
+    uint32_t id = chercherIdentifiant(champDepuisChaine(identifiant));
+
+    /* Identifiant jamais rencontre: aucune usine ne le porte */
+    if (id == IDENTIFIANT_NUL)
+        return INDICE_NUL;
 
-    if (racine == NULL)
-        return NULL;
+    while (racine != INDICE_NUL && NOEUD_AVL(pool, racine)->usine.identifiant != id) {
+        if (id < NOEUD_AVL(pool, racine)->usine.identifiant)
+            racine = NOEUD_AVL(pool, racine)->fg;
+        else
+            racine = NOEUD_AVL(pool, racine)->fd;
+    }
+    return racine;
+}
 
-    cmp = strcmp(identifiant, racine->usine.identifiant);
+/* ========== Construction en bloc ========== */
 
-    if (cmp == 0)
+/*
+ * Relie en AVL parfaitement equilibre les nb noeuds consecutifs du pool
+ * a partir de premier, deja ranges par numero d'identifiant croissant.
+ * Le noeud du milieu devient la racine: le sous-arbre gauche a autant ou
+ * un noeud de plus que le droit, donc eq vaut 0 ou -1 partout.
+ * hauteur: recoit la hauteur du sous-arbre construit
+ */
+static uint32_t lierAVL(PoolAVL *pool, uint32_t premier, uint32_t nb, int *hauteur) {
+    uint32_t milieu, fg, fd;
+    int hg, hd;
+    NoeudAVL *n;
+
+    if (nb == 0) {
+        *hauteur = 0;
+        return INDICE_NUL;
+    }
+
+    milieu = nb / 2;
+    fg = lierAVL(pool, premier, milieu, &hg);
+    fd = lierAVL(pool, premier + milieu + 1, nb - milieu - 1, &hd);
+
+    n = NOEUD_AVL(pool, premier + milieu);
+    n->fg = fg;
+    n->fd = fd;
+    n->eq = hd - hg;
+    *hauteur = 1 + max(hg, hd);
+    return premier + milieu;
+}
+
+/*
+ * Construit un AVL equilibre en O(n) a partir d'usines rangees par
+ * numero d'identifiant strictement croissant
+ * Retourne l'indice de la racine
+ */
+uint32_t construireAVL(PoolAVL *pool, const Usine *usines, uint32_t nb) {
+    uint32_t premier = INDICE_NUL;
+    uint32_t i;
+    int hauteur;
+
+    if (nb == 0)
+        return INDICE_NUL;
+    for (i = 0; i < nb; i++) {
+        uint32_t nouveau = creerNoeud(pool, usines[i]);
+        if (i == 0)
+            premier = nouveau;
+    }
+    return lierAVL(pool, premier, nb, &hauteur);
+}
+
+/* Cle de tri: numero d'identifiant puis rang d'arrivee */
+typedef struct CleTri {
+    uint32_t identifiant;
+    uint32_t position;
+} CleTri;
+
+/* Comparateur pour qsort: ordre des numeros, puis ordre d'arrivee */
+static int comparerCles(const void *a, const void *b) {
+    const CleTri *ca = (const CleTri*)a;
+    const CleTri *cb = (const CleTri*)b;
+
+    if (ca->identifiant != cb->identifiant)
+        return (ca->identifiant < cb->identifiant) ? -1 : 1;
+    return (ca->position < cb->position) ? -1 : (ca->position > cb->position);
+}
+
+/*
+ * Construit un AVL equilibre a partir d'usines dans un ordre quelconque
+ * Si les usines ne sont pas deja triees, un tableau de cles est trie;
+ * les doublons sont ensuite cumules dans leur ordre d'arrivee, avec les
+ * memes regles que insererAVL (memes sommes flottantes).
+ * Le tableau usines est reecrit (usines distinctes et triees).
+ * Retourne l'indice de la racine
+ */
+uint32_t reconstruireAVL(PoolAVL *pool, Usine *usines, uint32_t nb) {
+    CleTri *cles;
+    Usine *triees;
+    uint32_t i, nbDistinctes = 0;
+
+    /* Deja trie sans doublon: construction directe */
+    for (i = 1; i < nb; i++) {
+        if (usines[i].identifiant <= usines[i - 1].identifiant)
+            break;
+    }
+    if (i >= nb)
+        return construireAVL(pool, usines, nb);
+
+    cles = (CleTri*)malloc((size_t)nb * sizeof(CleTri));
+    triees = (Usine*)malloc((size_t)nb * sizeof(Usine));
+    if (cles == NULL || triees == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < nb; i++) {
+        cles[i].identifiant = usines[i].identifiant;
+        cles[i].position = i;
+    }
+    qsort(cles, (size_t)nb, sizeof(CleTri), comparerCles);
+
+    for (i = 0; i < nb; i++) {
+        const Usine *u = &usines[cles[i].position];
+        if (nbDistinctes > 0 && triees[nbDistinctes - 1].identifiant == u->identifiant)
+            cumulerValeurs(&triees[nbDistinctes - 1], u);
+        else
+            triees[nbDistinctes++] = *u;
+    }
+    memcpy(usines, triees, (size_t)nbDistinctes * sizeof(Usine));
+    free(triees);
+    free(cles);
+
+    return construireAVL(pool, usines, nbDistinctes);
+}
+
+/*
+ * Range les usines du sous-arbre a la suite du tableau, par numero croissant
+ * nb: nombre d'usines deja dans le tableau, augmente des usines ajoutees
+ */
+void listerUsinesAVL(PoolAVL *pool, uint32_t racine, Usine *tableau, uint32_t *nb) {
+    if (racine == INDICE_NUL)
+        return;
+    listerUsinesAVL(pool, NOEUD_AVL(pool, racine)->fg, tableau, nb);
+    tableau[(*nb)++] = NOEUD_AVL(pool, racine)->usine;
+    listerUsinesAVL(pool, NOEUD_AVL(pool, racine)->fd, tableau, nb);
+}
+
+/* ========== Chargement d'usines triees ========== */
+
+/* Nombre de noeuds de la serie triee en cours */
+static uint32_t tailleSerie(const PoolAVL *pool, const ChargementAVL *chargement) {
+    return (pool->nb > chargement->premier) ? pool->nb - chargement->premier : 0;
+}
+
+/*
+ * Prepare le chargement d'usines dans un arbre vide
+ * Tant que les usines arrivent par numero croissant (fichier groupe par
+ * usine), elles sont ajoutees a la suite dans le pool sans rotation; les
+ * doublons consecutifs sont cumules sur place. Le pool ne doit pas
+ * recevoir d'autres noeuds pendant le chargement.
+ */
+void commencerChargementAVL(PoolAVL *pool, ChargementAVL *chargement) {
+    chargement->racine = INDICE_NUL;
+    chargement->premier = (pool->nb == 0) ? 1 : pool->nb;
+}
+
+/*
+ * Ajoute une usine a l'arbre en cours de chargement
+ * A la premiere usine hors d'ordre, la serie deja lue est reliee en AVL
+ * equilibre et le chargement continue par insererAVL.
+ */
+void chargerUsineAVL(PoolAVL *pool, ChargementAVL *chargement, Usine usine) {
+    NoeudAVL *dernier;
+    int h = 0;
+
+    if (chargement->premier != INDICE_NUL) {
+        if (tailleSerie(pool, chargement) == 0) {
+            creerNoeud(pool, usine);
+            return;
+        }
+        dernier = NOEUD_AVL(pool, pool->nb - 1);
+        if (usine.identifiant > dernier->usine.identifiant) {
+            creerNoeud(pool, usine);
+            return;
+        }
+        if (usine.identifiant == dernier->usine.identifiant) {
+            cumulerValeurs(&dernier->usine, &usine);
+            return;
+        }
+
+        /* Serie rompue: la relier puis inserer normalement */
+        chargement->racine = terminerChargementAVL(pool, chargement);
+    }
+    chargement->racine = insererAVL(pool, chargement->racine, usine, &h);
+}
+
+/* Relie la serie en cours s'il y en a une; retourne la racine de l'arbre */
+uint32_t terminerChargementAVL(PoolAVL *pool, ChargementAVL *chargement) {
+    int hauteur;
+
+    if (chargement->premier != INDICE_NUL) {
+        chargement->racine = lierAVL(pool, chargement->premier,
+                                     tailleSerie(pool, chargement), &hauteur);
+        chargement->premier = INDICE_NUL;
+    }
+    return chargement->racine;
+}
+
+/* ========== Fusion ========== */
+
+/*
+ * Reunit les usines de l'arbre source et de l'arbre destination
+ * Les doublons sont cumules selon les memes regles que insererAVL, les
+ * valeurs de la destination en premier. L'arbre resultant est reconstruit
+ * en bloc dans le pool destination; les anciens noeuds de la destination
+ * y restent inutilises jusqu'a libererAVL.
+ * Le pool source n'est pas modifie; il reste a liberer par l'appelant.
+ */
+uint32_t fusionnerAVL(PoolAVL *destination, uint32_t racine, PoolAVL *source, uint32_t racineSource) {
+    Usine *usines;
+    uint32_t nb, nbSource;
+
+    if (racineSource == INDICE_NUL)
         return racine;
-    else if (cmp < 0)
-        return rechercherAVL(racine->fg, identifiant);
-    else
-        return rechercherAVL(racine->fd, identifiant);
+
+    nb = (uint32_t)compterNoeuds(destination, racine);
+    nbSource = (uint32_t)compterNoeuds(source, racineSource);
+    usines = (Usine*)malloc(((size_t)nb + nbSource) * sizeof(Usine));
+    if (usines == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+    nb = 0;
+    listerUsinesAVL(destination, racine, usines, &nb);
+    listerUsinesAVL(source, racineSource, usines, &nb);
+
+    racine = reconstruireAVL(destination, usines, nb);
+    free(usines);
+    return racine;
 }
 
 /* ========== Parcours ========== */
 
-/* 
- * Parcours en ordre inverse (droite, racine, gauche) pour tri alphabetique inverse
+/* Range les adresses des noeuds du sous-arbre dans le tableau */
+static void collecterNoeuds(PoolAVL *pool, uint32_t racine, NoeudAVL **tableau, int *nb) {
+    if (racine == INDICE_NUL)
+        return;
+    collecterNoeuds(pool, NOEUD_AVL(pool, racine)->fg, tableau, nb);
+    tableau[(*nb)++] = NOEUD_AVL(pool, racine);
+    collecterNoeuds(pool, NOEUD_AVL(pool, racine)->fd, tableau, nb);
+}
+
+/* Comparateur pour qsort sur des Usine: ordre alphabetique des identifiants */
+int comparerUsinesAlphabetique(const void *a, const void *b) {
+    return comparerIdentifiants(((const Usine*)a)->identifiant, ((const Usine*)b)->identifiant);
+}
+
+/* Comparateur pour qsort: ordre alphabetique des identifiants */
+static int comparerNoeudsParTexte(const void *a, const void *b) {
+    const NoeudAVL *na = *(NoeudAVL* const*)a;
+    const NoeudAVL *nb = *(NoeudAVL* const*)b;
+    return comparerIdentifiants(na->usine.identifiant, nb->usine.identifiant);
+}
+
+/*
+ * Ecrit la ligne d'une usine selon le mode
  * Mode: 1=max, 2=src, 3=real, 4=all
  */
-void parcoursInverseAVL(NoeudAVL *racine, FILE *fichier, int mode) {
-    double valMax, valSrc, valReal;
-    
-    if (racine == NULL)
-        return;
+void ecrireUsine(Sortie *sortie, const Usine *usine, int mode) {
+    const char *nom = texteIdentifiant(usine->identifiant);
 
-    /* Parcours droite d'abord pour ordre inverse */
-    parcoursInverseAVL(racine->fd, fichier, mode);
+    ecrireUsineNommee(sortie, nom, strlen(nom), usine, mode);
+}
+
+/* Meme ligne, l'identifiant etant donne par son texte (agregation externe) */
+void ecrireUsineNommee(Sortie *sortie, const char *nom, size_t longueur, const Usine *usine,
+                       int mode) {
+    double valMax, valSrc, valReal;
 
     /* Conversion en millions de m3 (diviser par 1000) */
-    valMax = racine->usine.capacite_max / 1000.0;
-    valSrc = racine->usine.volume_capte / 1000.0;
-    valReal = racine->usine.volume_traite / 1000.0;
+    valMax = usine->capacite_max / 1000.0;
+    valSrc = usine->volume_capte / 1000.0;
+    valReal = usine->volume_traite / 1000.0;
 
-    /* Ecrire selon le mode */
+    /* Ecrire selon le mode (meme texte que "%s;%.6f") */
+    ecrireTexte(sortie, nom, longueur);
+    ecrireCaractere(sortie, ';');
     if (mode == 1) {
-        fprintf(fichier, "%s;%.6f\n", racine->usine.identifiant, valMax);
+        ecrireDecimal6(sortie, valMax);
     } else if (mode == 2) {
-        fprintf(fichier, "%s;%.6f\n", racine->usine.identifiant, valSrc);
+        ecrireDecimal6(sortie, valSrc);
     } else if (mode == 3) {
-        fprintf(fichier, "%s;%.6f\n", racine->usine.identifiant, valReal);
+        ecrireDecimal6(sortie, valReal);
     } else if (mode == 4) {
         /* Mode bonus: toutes les valeurs */
-        fprintf(fichier, "%s;%.6f;%.6f;%.6f\n", 
-                racine->usine.identifiant, valReal, valSrc - valReal, valMax - valSrc);
+        ecrireDecimal6(sortie, valReal);
+        ecrireCaractere(sortie, ';');
+        ecrireDecimal6(sortie, valSrc - valReal);
+        ecrireCaractere(sortie, ';');
+        ecrireDecimal6(sortie, valMax - valSrc);
     }
+    ecrireCaractere(sortie, '\n');
+}
 
-    /* Puis parcours gauche */
-    parcoursInverseAVL(racine->fg, fichier, mode);
+/* 
+ * Parcours en ordre alphabetique inverse des usines
+ * L'AVL est range par numero d'identifiant: les noeuds sont tries une
+ * seule fois selon le texte de leur identifiant, puis ecrits du dernier
+ * au premier.
+ * Mode: 1=max, 2=src, 3=real, 4=all
+ */
+void parcoursInverseAVL(PoolAVL *pool, uint32_t racine, Sortie *sortie, int mode) {
+    parcoursInverseAVLModes(pool, racine, sortie, &mode, 1);
 }
 
-/* ========== Liberation memoire ========== */
+/*
+ * Meme parcours, chaque usine etant ecrite dans nbSorties sorties,
+ * sortie i avec le mode modes[i]: un seul tri pour tous les histogrammes
+ */
+void parcoursInverseAVLModes(PoolAVL *pool, uint32_t racine, Sortie *sorties,
+                             const int *modes, int nbSorties) {
+    NoeudAVL **tableau;
+    int nb = 0;
+    int i, j;
 
-/* Libere la memoire de l'arbre */
-void libererAVL(NoeudAVL *racine) {
-    if (racine == NULL)
+    if (racine == INDICE_NUL)
         return;
-    libererAVL(racine->fg);
-    libererAVL(racine->fd);
-    free(racine);
+
+    tableau = (NoeudAVL**)malloc((size_t)compterNoeuds(pool, racine) * sizeof(NoeudAVL*));
+    if (tableau == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+
+    collecterNoeuds(pool, racine, tableau, &nb);
+    qsort(tableau, (size_t)nb, sizeof(NoeudAVL*), comparerNoeudsParTexte);
+
+    for (i = nb - 1; i >= 0; i--) {
+        for (j = 0; j < nbSorties; j++)
+            ecrireUsine(&sorties[j], &tableau[i]->usine, modes[j]);
+    }
+
+    free(tableau);
+}
+
+/* Parcours infixe (ordre des numeros d'identifiant) de toutes les usines */
+void parcoursAVL(PoolAVL *pool, uint32_t racine,
+                 void (*visiter)(const Usine *, void *), void *contexte) {
+    if (racine == INDICE_NUL)
+        return;
+    parcoursAVL(pool, NOEUD_AVL(pool, racine)->fg, visiter, contexte);
+    visiter(&NOEUD_AVL(pool, racine)->usine, contexte);
+    parcoursAVL(pool, NOEUD_AVL(pool, racine)->fd, visiter, contexte);
+}
+
+/* ========== Arbres de requetes par rang ========== */
+
+/* Taille d'un sous-arbre (0 pour INDICE_NUL) */
+static uint32_t tailleSousArbre(const ArbreRang *arbre, uint32_t a) {
+    return (a == INDICE_NUL) ? 0 : arbre->noeuds[a].taille;
+}
+
+/*
+ * Relie les noeuds premier a premier + nb - 1 (deja dans l'ordre) en
+ * arbre equilibre, et calcule les agregats de bas en haut
+ */
+static uint32_t lierArbreRang(ArbreRang *arbre, uint32_t premier, uint32_t nb) {
+    uint32_t milieu, a;
+    NoeudRang *n;
+    const NoeudRang *f;
+
+    if (nb == 0)
+        return INDICE_NUL;
+    milieu = nb / 2;
+    a = premier + milieu;
+    n = &arbre->noeuds[a];
+    n->fg = lierArbreRang(arbre, premier, milieu);
+    n->fd = lierArbreRang(arbre, a + 1, nb - milieu - 1);
+
+    n->taille = 1;
+    n->sommeCapacite = n->usine.capacite_max;
+    n->sommeCapte = n->usine.volume_capte;
+    n->sommeTraite = n->usine.volume_traite;
+    if (n->fg != INDICE_NUL) {
+        f = &arbre->noeuds[n->fg];
+        n->taille += f->taille;
+        n->sommeCapacite += f->sommeCapacite;
+        n->sommeCapte += f->sommeCapte;
+        n->sommeTraite += f->sommeTraite;
+    }
+    if (n->fd != INDICE_NUL) {
+        f = &arbre->noeuds[n->fd];
+        n->taille += f->taille;
+        n->sommeCapacite += f->sommeCapacite;
+        n->sommeCapte += f->sommeCapte;
+        n->sommeTraite += f->sommeTraite;
+    }
+    return a;
+}
+
+/*
+ * Construit le tableau de requetes par rang des usines dans l'ordre de
+ * comparer (comparateur de qsort sur des Usine)
+ * Le tableau usines est trie sur place; les usines doivent etre distinctes.
+ */
+void construireArbreRang(ArbreRang *arbre, Usine *usines, uint32_t nb,
+                         int (*comparer)(const void *, const void *)) {
+    uint32_t i;
+
+    qsort(usines, (size_t)nb, sizeof(Usine), comparer);
+    arbre->noeuds = (NoeudRang*)malloc(((size_t)nb + 1) * sizeof(NoeudRang));
+    if (arbre->noeuds == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < nb; i++)
+        arbre->noeuds[i + 1].usine = usines[i];
+    arbre->nb = nb;
+    arbre->racine = lierArbreRang(arbre, 1, nb);
+}
+
+/* Usine de rang donne (0 = premiere), NULL au-dela: acces direct */
+const Usine* selectionnerRang(const ArbreRang *arbre, uint32_t rang) {
+    return (rang < arbre->nb) ? &arbre->noeuds[rang + 1].usine : NULL;
+}
+
+/*
+ * Nombre d'usines dont l'identifiant precede texte (inclus: ou lui est
+ * egal), dans un arbre range par ordre alphabetique: recherche
+ * dichotomique dans le tableau trie
+ * Le texte n'a pas besoin d'etre un identifiant connu.
+ */
+uint32_t compterAvantRang(const ArbreRang *arbre, const char *texte, int inclus) {
+    uint32_t debut = 0;
+    uint32_t fin = arbre->nb;
+    uint32_t milieu;
+    int c;
+
+    while (debut < fin) {
+        milieu = debut + (fin - debut) / 2;
+        c = strcmp(texteIdentifiant(arbre->noeuds[milieu + 1].usine.identifiant), texte);
+        if (c < 0 || (c == 0 && inclus))
+            debut = milieu + 1;
+        else
+            fin = milieu;
+    }
+    return debut;
+}
+
+/* Ajoute les agregats du sous-arbre a la somme */
+static void ajouterSousArbre(const ArbreRang *arbre, uint32_t a, Usine *somme) {
+    if (a == INDICE_NUL)
+        return;
+    somme->capacite_max += arbre->noeuds[a].sommeCapacite;
+    somme->volume_capte += arbre->noeuds[a].sommeCapte;
+    somme->volume_traite += arbre->noeuds[a].sommeTraite;
+}
+
+/* Ajoute les valeurs d'une seule usine a la somme */
+static void ajouterUsineSeule(const Usine *usine, Usine *somme) {
+    somme->capacite_max += usine->capacite_max;
+    somme->volume_capte += usine->volume_capte;
+    somme->volume_traite += usine->volume_traite;
+}
+
+/* Somme des rangs [0, fin) du sous-arbre */
+static void sommePrefixe(const ArbreRang *arbre, uint32_t a, uint32_t fin, Usine *somme) {
+    uint32_t gauche;
+
+    while (a != INDICE_NUL && fin > 0) {
+        gauche = tailleSousArbre(arbre, arbre->noeuds[a].fg);
+        if (fin <= gauche) {
+            a = arbre->noeuds[a].fg;
+        } else {
+            ajouterSousArbre(arbre, arbre->noeuds[a].fg, somme);
+            ajouterUsineSeule(&arbre->noeuds[a].usine, somme);
+            fin -= gauche + 1;
+            a = arbre->noeuds[a].fd;
+        }
+    }
+}
+
+/* Somme des rangs [debut, taille) du sous-arbre */
+static void sommeSuffixe(const ArbreRang *arbre, uint32_t a, uint32_t debut, Usine *somme) {
+    uint32_t gauche;
+
+    while (a != INDICE_NUL) {
+        gauche = tailleSousArbre(arbre, arbre->noeuds[a].fg);
+        if (debut > gauche) {
+            debut -= gauche + 1;
+            a = arbre->noeuds[a].fd;
+        } else {
+            ajouterSousArbre(arbre, arbre->noeuds[a].fd, somme);
+            ajouterUsineSeule(&arbre->noeuds[a].usine, somme);
+            a = arbre->noeuds[a].fg;
+        }
+    }
+}
+
+/*
+ * Sommes des valeurs des usines de rang debut a fin - 1
+ * Les sous-arbres entierement compris sont pris par leurs agregats: on
+ * descend jusqu'au noeud ou les deux bornes se separent, puis un chemin
+ * de chaque cote. Retourne le nombre d'usines de l'intervalle.
+ */
+uint32_t sommeRangs(const ArbreRang *arbre, uint32_t debut, uint32_t fin, Usine *somme) {
+    uint32_t a = arbre->racine;
+    uint32_t gauche;
+
+    somme->identifiant = IDENTIFIANT_NUL;
+    somme->capacite_max = 0.0;
+    somme->volume_capte = 0.0;
+    somme->volume_traite = 0.0;
+    if (fin > arbre->nb)
+        fin = arbre->nb;
+    if (debut >= fin)
+        return 0;
+
+    /* Noeud de separation */
+    while (a != INDICE_NUL) {
+        gauche = tailleSousArbre(arbre, arbre->noeuds[a].fg);
+        if (fin <= gauche) {
+            a = arbre->noeuds[a].fg;
+        } else if (debut > gauche) {
+            debut -= gauche + 1;
+            fin -= gauche + 1;
+            a = arbre->noeuds[a].fd;
+        } else {
+            sommeSuffixe(arbre, arbre->noeuds[a].fg, debut, somme);
+            ajouterUsineSeule(&arbre->noeuds[a].usine, somme);
+            sommePrefixe(arbre, arbre->noeuds[a].fd, fin - gauche - 1, somme);
+            break;
+        }
+    }
+    return fin - debut;
+}
+
+void libererArbreRang(ArbreRang *arbre) {
+    free(arbre->noeuds);
+    arbre->noeuds = NULL;
+    arbre->nb = 0;
+    arbre->racine = INDICE_NUL;
+}
+
+/* ========== Liberation memoire ========== */
+
+/* Libere tout le pool en une fois */
+void libererAVL(PoolAVL *pool) {
+    free(pool->noeuds);
+    initialiserPoolAVL(pool);
 }
 
 /* Compte le nombre de noeuds dans l'arbre */
-int compterNoeuds(NoeudAVL *racine) {
-    if (racine == NULL)
+int compterNoeuds(PoolAVL *pool, uint32_t racine) {
+    if (racine == INDICE_NUL)
+        return 0;
+    return 1 + compterNoeuds(pool, NOEUD_AVL(pool, racine)->fg)
+             + compterNoeuds(pool, NOEUD_AVL(pool, racine)->fd);
+}
+
+/* Hauteur de l'arbre (0 pour un arbre vide) */
+int hauteurAVL(PoolAVL *pool, uint32_t racine) {
+    if (racine == INDICE_NUL)
         return 0;
-    return 1 + compterNoeuds(racine->fg) + compterNoeuds(racine->fd);
+    return 1 + max(hauteurAVL(pool, NOEUD_AVL(pool, racine)->fg),
+                   hauteurAVL(pool, NOEUD_AVL(pool, racine)->fd));
 }
@@ -9,16 +9,42 @@
  *   eq > 0 : sous-arbre droit plus haut
  *   eq < 0 : sous-arbre gauche plus haut
  *   eq = 0 : arbre equilibre
+ *
+ * Les usines sont rangees selon le numero de leur identifiant (voir
+ * identifiants.h): les comparaisons sont des comparaisons d'entiers.
+ * L'ordre alphabetique est retabli au moment de l'ecriture.
+ *
+ * Les noeuds sont ranges dans un PoolAVL et designes par leur indice
+ * (INDICE_NUL = arbre vide). Le pool peut etre deplace lors d'une
+ * insertion: on ne garde donc jamais un pointeur vers un noeud a
+ * travers un appel qui cree des noeuds.
+ *
+ * Quand les usines arrivent deja triees (fichier groupe par usine, ou
+ * arbres a fusionner), l'arbre est construit en bloc en O(n): les noeuds
+ * sont ranges a la suite dans le pool puis relies en arbre equilibre,
+ * sans aucune rotation.
+ *
+ * Les requetes par rang du serveur (rang, k-ieme usine, sommes sur un
+ * intervalle) passent par des ArbreRang: un tableau trie, construit une
+ * fois et jamais modifie, ou l'usine de rang i est a l'indice i + 1. La
+ * k-ieme usine s'y lit directement et le rang d'un identifiant se trouve
+ * par dichotomie. Pour les sommes, les cases sont en plus reliees en
+ * arbre equilibre implicite (le milieu de chaque intervalle en est la
+ * racine) dont chaque noeud porte la taille et les sommes des trois
+ * valeurs de son sous-arbre: un intervalle se somme en O(log n). Ces
+ * agregats ne sont pas tenus dans NoeudAVL: l'arbre de l'histogramme
+ * n'en a pas l'usage.
  */
 
 #ifndef AVL_H
 #define AVL_H
 
-#include <stdio.h>
+#include "memoire.h"
+#include "sortie.h"
 
 /* Structure pour une usine de traitement */
 typedef struct Usine {
-    char identifiant[50];      /* Identifiant unique de l'usine */
+    uint32_t identifiant;      /* Numero de l'identifiant (table des identifiants) */
     double capacite_max;       /* Capacite maximale de traitement (k.m3) */
     double volume_capte;       /* Volume total capte par les sources (k.m3) */
     double volume_traite;      /* Volume reellement traite (k.m3) */
@@ -28,35 +54,99 @@ typedef struct Usine {
 typedef struct NoeudAVL {
     Usine usine;
     int eq;                    /* Facteur d'equilibre: droite - gauche */
-    struct NoeudAVL *fg;       /* Fils gauche */
-    struct NoeudAVL *fd;       /* Fils droit */
+    uint32_t fg;               /* Indice du fils gauche */
+    uint32_t fd;               /* Indice du fils droit */
 } NoeudAVL;
 
+/* Chargement en bloc d'usines arrivant par numero croissant */
+typedef struct ChargementAVL {
+    uint32_t racine;           /* Arbre deja forme */
+    uint32_t premier;          /* Premier noeud de la serie triee (INDICE_NUL: serie rompue) */
+} ChargementAVL;
+
+/* Case d'un tableau de requetes par rang, noeud de son arbre de sommes */
+typedef struct NoeudRang {
+    Usine usine;
+    uint32_t fg;               /* Indice du fils gauche */
+    uint32_t fd;               /* Indice du fils droit */
+    uint32_t taille;           /* Nombre de noeuds du sous-arbre */
+    double sommeCapacite;      /* Sommes des valeurs des usines du sous-arbre */
+    double sommeCapte;
+    double sommeTraite;
+} NoeudRang;
+
+/* Tableau trie de requetes par rang: noeuds[i + 1] est l'usine de rang i */
+typedef struct ArbreRang {
+    NoeudRang *noeuds;         /* noeuds[0] est reserve (INDICE_NUL) */
+    uint32_t nb;               /* Nombre d'usines */
+    uint32_t racine;           /* Racine de l'arbre de sommes */
+} ArbreRang;
+
+/* Pool des noeuds d'un AVL */
+typedef struct PoolAVL {
+    NoeudAVL *noeuds;          /* noeuds[0] est reserve (INDICE_NUL) */
+    uint32_t nb;               /* Nombre d'elements utilises */
+    uint32_t capacite;         /* Nombre d'elements alloues */
+    uint64_t nbRotations;      /* Rotations effectuees (--stats) */
+} PoolAVL;
+
+/* Acces a un noeud par son indice */
+#define NOEUD_AVL(pool, i) (&(pool)->noeuds[(i)])
+
 /* Fonctions utilitaires */
 int max(int a, int b);
 int min(int a, int b);
 int max3(int a, int b, int c);
 int min3(int a, int b, int c);
 
+/* Pool */
+void initialiserPoolAVL(PoolAVL *pool);
+
 /* Creation d'un noeud */
-NoeudAVL* creerNoeud(Usine usine);
+uint32_t creerNoeud(PoolAVL *pool, Usine usine);
 
 /* Rotations pour equilibrer l'AVL */
-NoeudAVL* rotationGauche(NoeudAVL *a);
-NoeudAVL* rotationDroite(NoeudAVL *a);
-NoeudAVL* doubleRotationGauche(NoeudAVL *a);
-NoeudAVL* doubleRotationDroite(NoeudAVL *a);
+uint32_t rotationGauche(PoolAVL *pool, uint32_t a);
+uint32_t rotationDroite(PoolAVL *pool, uint32_t a);
+uint32_t doubleRotationGauche(PoolAVL *pool, uint32_t a);
+uint32_t doubleRotationDroite(PoolAVL *pool, uint32_t a);
 
 /* Equilibrage */
-NoeudAVL* equilibrerAVL(NoeudAVL *a);
+uint32_t equilibrerAVL(PoolAVL *pool, uint32_t a);
 
 /* Operations principales */
-NoeudAVL* insererAVL(NoeudAVL *a, Usine usine, int *h);
-NoeudAVL* rechercherAVL(NoeudAVL *racine, char *identifiant);
+uint32_t insererAVL(PoolAVL *pool, uint32_t a, Usine usine, int *h);
+uint32_t rechercherAVL(PoolAVL *pool, uint32_t racine, char *identifiant);
+uint32_t fusionnerAVL(PoolAVL *destination, uint32_t racine, PoolAVL *source, uint32_t racineSource);
+
+/* Construction en bloc */
+uint32_t construireAVL(PoolAVL *pool, const Usine *usines, uint32_t nb);
+uint32_t reconstruireAVL(PoolAVL *pool, Usine *usines, uint32_t nb);
+void listerUsinesAVL(PoolAVL *pool, uint32_t racine, Usine *tableau, uint32_t *nb);
+int comparerUsinesAlphabetique(const void *a, const void *b);
+void commencerChargementAVL(PoolAVL *pool, ChargementAVL *chargement);
+void chargerUsineAVL(PoolAVL *pool, ChargementAVL *chargement, Usine usine);
+uint32_t terminerChargementAVL(PoolAVL *pool, ChargementAVL *chargement);
+
+/* Arbres de requetes par rang */
+void construireArbreRang(ArbreRang *arbre, Usine *usines, uint32_t nb,
+                         int (*comparer)(const void *, const void *));
+const Usine* selectionnerRang(const ArbreRang *arbre, uint32_t rang);
+uint32_t compterAvantRang(const ArbreRang *arbre, const char *texte, int inclus);
+uint32_t sommeRangs(const ArbreRang *arbre, uint32_t debut, uint32_t fin, Usine *somme);
+void libererArbreRang(ArbreRang *arbre);
 
 /* Parcours et liberation */
-void parcoursInverseAVL(NoeudAVL *racine, FILE *fichier, int mode);
-void libererAVL(NoeudAVL *racine);
-int compterNoeuds(NoeudAVL *racine);
+void ecrireUsine(Sortie *sortie, const Usine *usine, int mode);
+void ecrireUsineNommee(Sortie *sortie, const char *nom, size_t longueur, const Usine *usine,
+                       int mode);
+void parcoursInverseAVL(PoolAVL *pool, uint32_t racine, Sortie *sortie, int mode);
+void parcoursInverseAVLModes(PoolAVL *pool, uint32_t racine, Sortie *sorties,
+                             const int *modes, int nbSorties);
+void parcoursAVL(PoolAVL *pool, uint32_t racine,
+                 void (*visiter)(const Usine *, void *), void *contexte);
+void libererAVL(PoolAVL *pool);
+int compterNoeuds(PoolAVL *pool, uint32_t racine);
+int hauteurAVL(PoolAVL *pool, uint32_t racine);
 
 #endif
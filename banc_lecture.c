@@ -0,0 +1,225 @@
+/*
+ * banc_lecture.c - Mesure du decoupage des lignes et de la conversion des nombres
+ * Projet C-Wildwater
+ *
+ * Lit un fichier de donnees reel plusieurs fois avec chaque methode et
+ * affiche le meilleur temps de chacune:
+ *   sscanf     ligne copiee puis decoupee par sscanf, atof sur col4/col5
+ *              (ancienne lecture par fgets/sscanf)
+ *   scalaire   lireLigne avec memchr, atof sur col4/col5
+ *   sse2/avx2  lireLigne par blocs, champVersDouble sur col4/col5
+ *
+ * Les methodes doivent trouver les memes colonnes et les memes valeurs:
+ * une somme de controle est comparee, et chaque nombre converti par
+ * champVersDouble est compare bit a bit a celui de atof.
+ *
+ * Usage:
+ *   ./banc_lecture <fichier_donnees> [repetitions]   (make banc_lecture)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "lecture.h"
+
+/* Taille maximale d'une ligne copiee pour sscanf */
+#define TAILLE_LIGNE 1024
+
+/* Taille maximale d'une colonne lue par sscanf */
+#define TAILLE_COLONNE 256
+
+/* Nombre de lectures par defaut */
+#define REPETITIONS 5
+
+/* Resultat d'une lecture complete */
+typedef struct Mesure {
+    double secondes;
+    uint64_t lignes;
+    uint64_t octetsColonnes;   /* Somme des longueurs des colonnes */
+    double somme;              /* Somme des valeurs numeriques de col4/col5 */
+} Mesure;
+
+/* Instant courant en secondes */
+static double maintenant(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+/* ========== Methodes mesurees ========== */
+
+/* atof sur une copie terminee par '\0' d'un champ */
+static double atofChamp(Champ champ) {
+    char nombre[TAILLE_COLONNE];
+    size_t taille = champ.longueur < TAILLE_COLONNE ? champ.longueur : TAILLE_COLONNE - 1;
+
+    memcpy(nombre, champ.debut, taille);
+    nombre[taille] = '\0';
+    return atof(nombre);
+}
+
+/* Lecture par copie de chaque ligne puis sscanf avec ensembles de caracteres */
+static void lireParSscanf(const Lecteur *lecteur, Mesure *mesure) {
+    char ligne[TAILLE_LIGNE];
+    char col[NB_COLONNES][TAILLE_COLONNE];
+    const char *p = lecteur->donnees;
+    const char *fin = lecteur->donnees + lecteur->taille;
+    const char *finLigne;
+    size_t taille;
+    int nb, i;
+
+    while (p < fin) {
+        finLigne = (const char*)memchr(p, '\n', (size_t)(fin - p));
+        if (finLigne == NULL)
+            finLigne = fin;
+        taille = (size_t)(finLigne - p);
+        if (taille >= TAILLE_LIGNE)
+            taille = TAILLE_LIGNE - 1;
+        memcpy(ligne, p, taille);
+        ligne[taille] = '\0';
+        p = finLigne + 1;
+
+        nb = sscanf(ligne, "%255[^;];%255[^;];%255[^;];%255[^;];%255[^\r\n]",
+                    col[0], col[1], col[2], col[3], col[4]);
+        mesure->lignes++;
+        for (i = 0; i < nb; i++)
+            mesure->octetsColonnes += strlen(col[i]);
+        if (nb >= 4 && strcmp(col[3], "-") != 0)
+            mesure->somme += atof(col[3]);
+        if (nb >= 5 && strcmp(col[4], "-") != 0)
+            mesure->somme += atof(col[4]);
+    }
+}
+
+/* Lecture par lireLigne; rapide: champVersDouble au lieu de atof */
+static void lireParLecteur(Lecteur *lecteur, int rapide, Mesure *mesure) {
+    Champ col[NB_COLONNES];
+    int nb, i;
+
+    lecteur->position = 0;
+    while ((nb = lireLigne(lecteur, col)) >= 0) {
+        mesure->lignes++;
+        for (i = 0; i < nb; i++)
+            mesure->octetsColonnes += col[i].longueur;
+        for (i = 3; i < NB_COLONNES; i++) {
+            if (champEstValeur(col[i]))
+                mesure->somme += rapide ? champVersDouble(col[i]) : atofChamp(col[i]);
+        }
+    }
+}
+
+/* Meilleur temps sur plusieurs lectures; methode: -1 pour sscanf, sinon niveau de decoupage */
+static Mesure mesurer(Lecteur *lecteur, int methode, int repetitions) {
+    Mesure mesure, meilleure;
+    double debut;
+    int r;
+
+    memset(&meilleure, 0, sizeof(Mesure));
+    for (r = 0; r < repetitions; r++) {
+        memset(&mesure, 0, sizeof(Mesure));
+        debut = maintenant();
+        if (methode < 0) {
+            lireParSscanf(lecteur, &mesure);
+        } else {
+            choisirDecoupage(methode);
+            lireParLecteur(lecteur, methode != DECOUPAGE_SCALAIRE, &mesure);
+        }
+        mesure.secondes = maintenant() - debut;
+        if (r == 0 || mesure.secondes < meilleure.secondes)
+            meilleure = mesure;
+    }
+    return meilleure;
+}
+
+/* ========== Verification de champVersDouble ========== */
+
+/* Nombre de valeurs de col4/col5 dont champVersDouble differe de atof */
+static uint64_t compterEcarts(Lecteur *lecteur, uint64_t *nbValeurs) {
+    Champ col[NB_COLONNES];
+    double a, b;
+    uint64_t ecarts = 0;
+    int i;
+
+    *nbValeurs = 0;
+    lecteur->position = 0;
+    while (lireLigne(lecteur, col) >= 0) {
+        for (i = 3; i < NB_COLONNES; i++) {
+            if (!champEstValeur(col[i]))
+                continue;
+            a = atofChamp(col[i]);
+            b = champVersDouble(col[i]);
+            (*nbValeurs)++;
+            if (memcmp(&a, &b, sizeof(double)) != 0) {
+                if (ecarts == 0)
+                    fprintf(stderr, "Ecart: '%.*s' atof=%.17g champVersDouble=%.17g\n",
+                            (int)col[i].longueur, col[i].debut, a, b);
+                ecarts++;
+            }
+        }
+    }
+    return ecarts;
+}
+
+/* ========== Programme principal ========== */
+
+/* Affiche une mesure et la compare a la reference */
+static int afficherMesure(const char *nom, const Mesure *mesure, const Mesure *reference,
+                          size_t taille) {
+    int identique = (mesure->octetsColonnes == reference->octetsColonnes &&
+                     mesure->somme == reference->somme);
+
+    printf("%-10s %9.3f s %9.1f Mo/s  x%5.2f  %s\n", nom, mesure->secondes,
+           (double)taille / mesure->secondes / 1e6,
+           reference->secondes / mesure->secondes,
+           identique ? "ok" : "DIFFERENT");
+    return identique;
+}
+
+int main(int argc, char *argv[]) {
+    static const char *noms[] = { "scalaire", "sse2", "avx2" };
+    Lecteur lecteur;
+    Mesure reference, mesure;
+    uint64_t ecarts, nbValeurs;
+    int repetitions = REPETITIONS;
+    int meilleur, niveau;
+    int code = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <fichier_donnees> [repetitions]\n", argv[0]);
+        return 1;
+    }
+    if (argc >= 3 && (repetitions = atoi(argv[2])) < 1) {
+        fprintf(stderr, "Erreur: nombre de repetitions invalide '%s'\n", argv[2]);
+        return 1;
+    }
+    if (ouvrirLecteur(&lecteur, argv[1]) != 0 || lecteur.flux) {
+        fprintf(stderr, "Erreur: impossible d'ouvrir %s\n", argv[1]);
+        return 1;
+    }
+    meilleur = meilleurDecoupage();
+
+    printf("%s: %zu octets, meilleur de %d lectures\n", argv[1], lecteur.taille, repetitions);
+    reference = mesurer(&lecteur, -1, repetitions);
+    printf("%-10s %9.3f s %9.1f Mo/s  (%llu lignes)\n", "sscanf", reference.secondes,
+           (double)lecteur.taille / reference.secondes / 1e6,
+           (unsigned long long)reference.lignes);
+
+    for (niveau = DECOUPAGE_SCALAIRE; niveau <= meilleur; niveau++) {
+        mesure = mesurer(&lecteur, niveau, repetitions);
+        if (!afficherMesure(noms[niveau], &mesure, &reference, lecteur.taille))
+            code = 1;
+    }
+
+    ecarts = compterEcarts(&lecteur, &nbValeurs);
+    printf("champVersDouble: %llu valeurs, %llu ecarts avec atof\n",
+           (unsigned long long)nbValeurs, (unsigned long long)ecarts);
+    if (ecarts != 0)
+        code = 1;
+
+    fermerLecteur(&lecteur);
+    return code;
+}
@@ -0,0 +1,95 @@
+#!/bin/bash
+
+# =============================================================================
+# bench.sh - Mesure des temps de traitement du programme wildwater
+# Projet C-Wildwater
+#
+# Pour chaque taille demandee, un fichier de donnees synthetique est genere
+# (graine fixe, donc identique d'un commit a l'autre) puis chaque commande
+# est chronometree, d'abord sur le texte puis sur le cache binaire.
+#
+# Usage : ./bench.sh [nb_lignes ...]   (appele par "make bench")
+#
+# Les resultats sont ajoutes a bench/resultats.csv, une ligne par mesure :
+#   commit;date;lignes;donnees;commande;reel_s;utilisateur_s;systeme_s;code
+# donnees vaut "texte" (fichier .dat) ou "cache" (fichier .wwc).
+# =============================================================================
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+BENCH_DIR="$SCRIPT_DIR/bench"
+WILDWATER="$SCRIPT_DIR/wildwater"
+GENERATEUR="$SCRIPT_DIR/generateur"
+RESULTATS="$BENCH_DIR/resultats.csv"
+SORTIE="$BENCH_DIR/sortie.tmp"
+
+# Graine du generateur : la changer rend les mesures incomparables
+GRAINE=1
+
+TAILLES="$*"
+if [ -z "$TAILLES" ]; then
+    TAILLES="1000000 10000000 100000000"
+fi
+
+if [ ! -x "$WILDWATER" ] || [ ! -x "$GENERATEUR" ]; then
+    echo "Erreur : compiler d'abord avec \"make bench\"" >&2
+    exit 1
+fi
+
+mkdir -p "$BENCH_DIR"
+if [ ! -f "$RESULTATS" ]; then
+    echo "commit;date;lignes;donnees;commande;reel_s;utilisateur_s;systeme_s;code" > "$RESULTATS"
+fi
+
+COMMIT=$(git -C "$SCRIPT_DIR" describe --always --dirty 2>/dev/null || echo inconnu)
+DATE=$(date +%Y-%m-%dT%H:%M:%S)
+
+# =============================================================================
+# Chronometrage d'une commande
+# mesurer <lignes> <donnees> <libelle> <arguments de wildwater...>
+# =============================================================================
+mesurer() {
+    local lignes="$1" donnees="$2" libelle="$3"
+    local temps code
+    shift 3
+
+    rm -f "$SORTIE"
+    TIMEFORMAT="%R;%U;%S"
+    temps=$( { time "$WILDWATER" "$@" > /dev/null 2>&1 ; } 2>&1 )
+    code=$?
+    # "time" renvoie le code de la commande chronometree
+    echo "$COMMIT;$DATE;$lignes;$donnees;$libelle;$temps;$code" >> "$RESULTATS"
+    printf "  %-8s %-12s %s s\n" "$donnees" "$libelle" "${temps%%;*}"
+}
+
+# =============================================================================
+# Mesures
+# =============================================================================
+for LIGNES in $TAILLES; do
+    DONNEES="$BENCH_DIR/donnees_$LIGNES.dat"
+
+    # Generation une seule fois par taille
+    if [ ! -f "$DONNEES" ]; then
+        echo "Generation de $DONNEES..."
+        "$GENERATEUR" "$LIGNES" -s "$GRAINE" -o "$DONNEES" || exit 1
+    fi
+
+    # Premiere usine du fichier, pour le calcul de fuites d'une seule usine
+    USINE=$(head -n 1 "$DONNEES" | cut -d';' -f2)
+
+    echo "$LIGNES lignes :"
+    rm -f "$DONNEES.wwc"
+    for DONNEES_TYPE in texte cache; do
+        if [ "$DONNEES_TYPE" = "cache" ]; then
+            mesurer "$LIGNES" texte "index" index "$DONNEES"
+        fi
+        for MODE in max src real all; do
+            mesurer "$LIGNES" "$DONNEES_TYPE" "histo_$MODE" histo "$MODE" "$DONNEES" "$SORTIE"
+        done
+        mesurer "$LIGNES" "$DONNEES_TYPE" "leaks" leaks "$USINE" "$DONNEES" "$SORTIE"
+        mesurer "$LIGNES" "$DONNEES_TYPE" "leaks_all" leaks --all "$DONNEES" "$SORTIE"
+    done
+    rm -f "$DONNEES.wwc"
+done
+
+rm -f "$SORTIE"
+echo "Resultats ajoutes a $RESULTATS"
@@ -0,0 +1,477 @@
+/*
+ * cache.c - Cache binaire des fichiers de donnees
+ * Projet C-Wildwater
+ *
+ * Disposition du fichier .wwc (ordre des octets de la machine):
+ *   EnteteCache
+ *   debuts[nbIdentifiants + 2]   uint32: debut du texte de chaque numero
+ *   textes[tailleTextes]         textes termines par '\0'
+ *   hachages[nbIdentifiants + 1] uint32: hachage de chaque texte
+ *   genres[nbIdentifiants + 1]   uint8
+ *   usines, captages, troncons   une section par colonne
+ * Chaque section commence sur un multiple de 8 octets.
+ *
+ * Le cache est ecrit dans un fichier temporaire puis renomme: un cache
+ * a moitie ecrit n'est jamais vu par les autres commandes.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "lecture.h"
+#include "identifiants.h"
+#include "statistiques.h"
+#include "classement.h"
+#include "cache.h"
+
+#define MAGIE_CACHE "WWCACHE1"
+#define ALIGNEMENT 8
+
+/* En-tete du fichier cache */
+typedef struct EnteteCache {
+    char magie[8];
+    uint64_t tailleSource;             /* Taille du fichier de donnees */
+    int64_t secondesSource;            /* Date de modification du fichier de donnees */
+    int64_t nanosecondesSource;
+    uint32_t nbIdentifiants;
+    uint32_t nbUsines;
+    uint32_t nbCaptages;
+    uint32_t nbTroncons;
+    uint64_t tailleTextes;
+} EnteteCache;
+
+/* Tables en cours de construction */
+typedef struct Tables {
+    uint32_t nbUsines, capaciteUsines;
+    uint32_t *usineIdentifiant;
+    double *usineCapacite;
+
+    uint32_t nbCaptages, capaciteCaptages;
+    uint32_t *captageSource;
+    uint32_t *captageUsine;
+    double *captageVolume;
+    double *captagePourcentage;
+
+    uint32_t nbTroncons, capaciteTroncons;
+    uint32_t *tronconUsine;
+    uint32_t *tronconAmont;
+    uint32_t *tronconAval;
+    double *tronconPourcentage;
+} Tables;
+
+/* ========== Utilitaires ========== */
+
+/* Nom du fichier cache associe a un fichier de donnees (a liberer) */
+static char* nomCache(const char *fichierDonnees) {
+    size_t longueur = strlen(fichierDonnees);
+    char *nom = (char*)malloc(longueur + sizeof(EXTENSION_CACHE) + 4);
+
+    if (nom == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(nom, fichierDonnees, longueur);
+    memcpy(nom + longueur, EXTENSION_CACHE, sizeof(EXTENSION_CACHE));
+    return nom;
+}
+
+/* Agrandit une colonne a nb elements de taille donnee */
+static void* redimensionner(void *colonne, size_t nb, size_t taille) {
+    void *agrandie = realloc(colonne, nb * taille);
+
+    if (agrandie == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+    return agrandie;
+}
+
+/* Nouvelle capacite d'une table pleine */
+static uint32_t capaciteSuivante(uint32_t capacite) {
+    return (capacite == 0) ? 1024 : capacite * 2;
+}
+
+/* ========== Construction ========== */
+
+/* Ajoute une ligne d'usine */
+static void ajouterLigneUsine(Tables *t, uint32_t usine, double capacite) {
+    if (t->nbUsines == t->capaciteUsines) {
+        t->capaciteUsines = capaciteSuivante(t->capaciteUsines);
+        t->usineIdentifiant = redimensionner(t->usineIdentifiant, t->capaciteUsines, sizeof(uint32_t));
+        t->usineCapacite = redimensionner(t->usineCapacite, t->capaciteUsines, sizeof(double));
+    }
+    t->usineIdentifiant[t->nbUsines] = usine;
+    t->usineCapacite[t->nbUsines] = capacite;
+    t->nbUsines++;
+}
+
+/* Ajoute une ligne de captage */
+static void ajouterLigneCaptage(Tables *t, uint32_t source, uint32_t usine,
+                                double volume, double pourcentage) {
+    if (t->nbCaptages == t->capaciteCaptages) {
+        t->capaciteCaptages = capaciteSuivante(t->capaciteCaptages);
+        t->captageSource = redimensionner(t->captageSource, t->capaciteCaptages, sizeof(uint32_t));
+        t->captageUsine = redimensionner(t->captageUsine, t->capaciteCaptages, sizeof(uint32_t));
+        t->captageVolume = redimensionner(t->captageVolume, t->capaciteCaptages, sizeof(double));
+        t->captagePourcentage = redimensionner(t->captagePourcentage, t->capaciteCaptages, sizeof(double));
+    }
+    t->captageSource[t->nbCaptages] = source;
+    t->captageUsine[t->nbCaptages] = usine;
+    t->captageVolume[t->nbCaptages] = volume;
+    t->captagePourcentage[t->nbCaptages] = pourcentage;
+    t->nbCaptages++;
+}
+
+/* Ajoute une ligne de troncon */
+static void ajouterLigneTroncon(Tables *t, uint32_t usine, uint32_t amont, uint32_t aval,
+                                double pourcentage) {
+    if (t->nbTroncons == t->capaciteTroncons) {
+        t->capaciteTroncons = capaciteSuivante(t->capaciteTroncons);
+        t->tronconUsine = redimensionner(t->tronconUsine, t->capaciteTroncons, sizeof(uint32_t));
+        t->tronconAmont = redimensionner(t->tronconAmont, t->capaciteTroncons, sizeof(uint32_t));
+        t->tronconAval = redimensionner(t->tronconAval, t->capaciteTroncons, sizeof(uint32_t));
+        t->tronconPourcentage = redimensionner(t->tronconPourcentage, t->capaciteTroncons, sizeof(double));
+    }
+    t->tronconUsine[t->nbTroncons] = usine;
+    t->tronconAmont[t->nbTroncons] = amont;
+    t->tronconAval[t->nbTroncons] = aval;
+    t->tronconPourcentage[t->nbTroncons] = pourcentage;
+    t->nbTroncons++;
+}
+
+/* Libere les tables en cours de construction */
+static void libererTables(Tables *t) {
+    free(t->usineIdentifiant);
+    free(t->usineCapacite);
+    free(t->captageSource);
+    free(t->captageUsine);
+    free(t->captageVolume);
+    free(t->captagePourcentage);
+    free(t->tronconUsine);
+    free(t->tronconAmont);
+    free(t->tronconAval);
+    free(t->tronconPourcentage);
+}
+
+/*
+ * Range une ligne dans l'une des trois tables, selon classerLigne
+ * Les regles sont celles de la lecture du texte (voir main.c).
+ */
+static void rangerLigne(Tables *t, Champ col[NB_COLONNES], int nbChamps) {
+    double capacite;
+    int genre = classerLigne(col, nbChamps);
+
+    /* Ligne d'usine: -;Usine;-;capacite;- */
+    if (genre == LIGNE_USINE) {
+        /* Forme complete exigee par l'histogramme */
+        if (champEgal(col[4], "-") && col[3].longueur > 0)
+            capacite = champVersDouble(col[3]);
+        else
+            capacite = NAN;
+        ajouterLigneUsine(t, internerChamp(col[1]), capacite);
+    }
+    /* Ligne source -> usine: -;Source;Usine;volume;pourcentage */
+    else if (genre == LIGNE_CAPTAGE) {
+        ajouterLigneCaptage(t, internerChamp(col[1]), internerChamp(col[2]),
+                            champVersDouble(col[3]), champVersDouble(col[4]));
+    }
+    /* Troncon de distribution: [usine|-];amont;aval;-;pourcentage */
+    else if (LIGNE_EST_TRONCON(genre)) {
+        ajouterLigneTroncon(t,
+                            champEstValeur(col[0]) ? internerChamp(col[0]) : IDENTIFIANT_NUL,
+                            internerChamp(col[1]), internerChamp(col[2]),
+                            champEstValeur(col[4]) ? champVersDouble(col[4]) : 0.0);
+    }
+}
+
+/*
+ * Ecrit une section puis complete jusqu'au multiple de 8 suivant
+ * donnees NULL: la section est deja ecrite, seul l'alignement est complete.
+ */
+static void ecrireSection(FILE *fichier, const void *donnees, size_t taille, int *erreur) {
+    static const char zeros[ALIGNEMENT] = { 0 };
+    size_t reste = (ALIGNEMENT - taille % ALIGNEMENT) % ALIGNEMENT;
+
+    if (donnees != NULL && taille > 0 && fwrite(donnees, 1, taille, fichier) != taille)
+        *erreur = 1;
+    if (reste > 0 && fwrite(zeros, 1, reste, fichier) != reste)
+        *erreur = 1;
+}
+
+/*
+ * Construit le cache d'un fichier de donnees (commande "index")
+ * Retourne 0 en cas de succes, 1 sinon.
+ */
+int construireCache(const char *fichierDonnees) {
+    Lecteur lecteur;
+    Champ col[NB_COLONNES];
+    Tables tables;
+    EnteteCache entete;
+    struct stat infos;
+    uint32_t *debuts, *hachages;
+    uint8_t *genres;
+    char *nom, *temporaire;
+    const char *texte;
+    Champ champ;
+    FILE *fichier;
+    uint64_t tailleTextes = 0;
+    uint32_t nb, id;
+    int nbChamps;
+    int erreur = 0;
+
+    if (stat(fichierDonnees, &infos) != 0 || ouvrirLecteur(&lecteur, fichierDonnees) != 0) {
+        fprintf(stderr, "Erreur: impossible d'ouvrir %s\n", fichierDonnees);
+        return 1;
+    }
+
+    memset(&tables, 0, sizeof(Tables));
+    changerPhase(PHASE_ANALYSE);
+    while ((nbChamps = lireLigne(&lecteur, col)) >= 0)
+        rangerLigne(&tables, col, nbChamps);
+    compterLignes(&lecteur);
+    fermerLecteur(&lecteur);
+
+    changerPhase(PHASE_ECRITURE);
+
+    /* Textes et genres des identifiants, dans l'ordre des numeros */
+    nb = nombreIdentifiants();
+    debuts = (uint32_t*)malloc(((size_t)nb + 2) * sizeof(uint32_t));
+    hachages = (uint32_t*)calloc((size_t)nb + 1, sizeof(uint32_t));
+    genres = (uint8_t*)calloc((size_t)nb + 1, sizeof(uint8_t));
+    if (debuts == NULL || hachages == NULL || genres == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+    debuts[0] = 0;
+    for (id = 1; id <= nb; id++) {
+        champ = champDepuisChaine(texteIdentifiant(id));
+        debuts[id] = (uint32_t)tailleTextes;
+        tailleTextes += champ.longueur + 1;
+        if (tailleTextes > UINT32_MAX) {
+            fprintf(stderr, "Erreur: identifiants trop volumineux pour le cache\n");
+            free(debuts);
+            free(hachages);
+            free(genres);
+            libererTables(&tables);
+            return 1;
+        }
+        hachages[id] = hacherChamp(champ);
+        switch (genreNoeud(champ)) {
+            case NOEUD_USINE:  genres[id] = GENRE_USINE; break;
+            case NOEUD_SOURCE: genres[id] = GENRE_SOURCE; break;
+            default:           break;
+        }
+    }
+    debuts[nb + 1] = (uint32_t)tailleTextes;
+
+    memset(&entete, 0, sizeof(EnteteCache));
+    memcpy(entete.magie, MAGIE_CACHE, sizeof(entete.magie));
+    entete.tailleSource = (uint64_t)infos.st_size;
+    entete.secondesSource = (int64_t)infos.st_mtim.tv_sec;
+    entete.nanosecondesSource = (int64_t)infos.st_mtim.tv_nsec;
+    entete.nbIdentifiants = nb;
+    entete.nbUsines = tables.nbUsines;
+    entete.nbCaptages = tables.nbCaptages;
+    entete.nbTroncons = tables.nbTroncons;
+    entete.tailleTextes = tailleTextes;
+
+    /* Ecriture dans un fichier temporaire, renomme une fois complet */
+    nom = nomCache(fichierDonnees);
+    temporaire = (char*)malloc(strlen(nom) + 5);
+    if (temporaire == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+    sprintf(temporaire, "%s.tmp", nom);
+
+    fichier = fopen(temporaire, "wb");
+    if (fichier == NULL) {
+        fprintf(stderr, "Erreur: impossible de creer %s\n", temporaire);
+        erreur = 1;
+    } else {
+        ecrireSection(fichier, &entete, sizeof(EnteteCache), &erreur);
+        ecrireSection(fichier, debuts, ((size_t)nb + 2) * sizeof(uint32_t), &erreur);
+        for (id = 1; id <= nb; id++) {
+            texte = texteIdentifiant(id);
+            if (fwrite(texte, 1, debuts[id + 1] - debuts[id], fichier) != debuts[id + 1] - debuts[id])
+                erreur = 1;
+        }
+        ecrireSection(fichier, NULL, (size_t)tailleTextes, &erreur);
+        ecrireSection(fichier, hachages, ((size_t)nb + 1) * sizeof(uint32_t), &erreur);
+        ecrireSection(fichier, genres, (size_t)nb + 1, &erreur);
+
+        ecrireSection(fichier, tables.usineIdentifiant, tables.nbUsines * sizeof(uint32_t), &erreur);
+        ecrireSection(fichier, tables.usineCapacite, tables.nbUsines * sizeof(double), &erreur);
+
+        ecrireSection(fichier, tables.captageSource, tables.nbCaptages * sizeof(uint32_t), &erreur);
+        ecrireSection(fichier, tables.captageUsine, tables.nbCaptages * sizeof(uint32_t), &erreur);
+        ecrireSection(fichier, tables.captageVolume, tables.nbCaptages * sizeof(double), &erreur);
+        ecrireSection(fichier, tables.captagePourcentage, tables.nbCaptages * sizeof(double), &erreur);
+
+        ecrireSection(fichier, tables.tronconUsine, tables.nbTroncons * sizeof(uint32_t), &erreur);
+        ecrireSection(fichier, tables.tronconAmont, tables.nbTroncons * sizeof(uint32_t), &erreur);
+        ecrireSection(fichier, tables.tronconAval, tables.nbTroncons * sizeof(uint32_t), &erreur);
+        ecrireSection(fichier, tables.tronconPourcentage, tables.nbTroncons * sizeof(double), &erreur);
+
+        if (fclose(fichier) != 0)
+            erreur = 1;
+        if (!erreur && rename(temporaire, nom) != 0)
+            erreur = 1;
+        if (erreur) {
+            fprintf(stderr, "Erreur: ecriture de %s impossible\n", nom);
+            remove(temporaire);
+        }
+    }
+
+    if (!erreur)
+        printf("Cache %s: %u identifiants, %u usines, %u captages, %u troncons\n",
+               nom, nb, tables.nbUsines, tables.nbCaptages, tables.nbTroncons);
+
+    changerPhase(PHASE_LIBERATION);
+    free(temporaire);
+    free(nom);
+    free(debuts);
+    free(hachages);
+    free(genres);
+    libererTables(&tables);
+    return erreur;
+}
+
+/* ========== Lecture ========== */
+
+/* Retourne l'adresse de la section suivante, NULL si elle deborde du cache */
+static const void* lireSection(const Cache *cache, size_t *position, size_t taille) {
+    const char *debut = (const char*)cache->projection + *position;
+
+    if (taille > cache->taille - *position)
+        return NULL;
+    *position += taille;
+    *position += (ALIGNEMENT - *position % ALIGNEMENT) % ALIGNEMENT;
+    if (*position > cache->taille)
+        *position = cache->taille;
+    return debut;
+}
+
+/* Decoupe le cache projete en sections; retourne 0 si sa structure est valide */
+static int decouperCache(Cache *cache, const EnteteCache *entete, const uint32_t **debuts,
+                         const char **textes, const uint32_t **hachages) {
+    size_t position = 0;
+    size_t nbU = entete->nbUsines, nbC = entete->nbCaptages, nbT = entete->nbTroncons;
+    size_t nbI = entete->nbIdentifiants;
+
+    lireSection(cache, &position, sizeof(EnteteCache));
+    *debuts = lireSection(cache, &position, (nbI + 2) * sizeof(uint32_t));
+    *textes = lireSection(cache, &position, (size_t)entete->tailleTextes);
+    *hachages = lireSection(cache, &position, (nbI + 1) * sizeof(uint32_t));
+    cache->genres = lireSection(cache, &position, nbI + 1);
+
+    cache->usineIdentifiant = lireSection(cache, &position, nbU * sizeof(uint32_t));
+    cache->usineCapacite = lireSection(cache, &position, nbU * sizeof(double));
+
+    cache->captageSource = lireSection(cache, &position, nbC * sizeof(uint32_t));
+    cache->captageUsine = lireSection(cache, &position, nbC * sizeof(uint32_t));
+    cache->captageVolume = lireSection(cache, &position, nbC * sizeof(double));
+    cache->captagePourcentage = lireSection(cache, &position, nbC * sizeof(double));
+
+    cache->tronconUsine = lireSection(cache, &position, nbT * sizeof(uint32_t));
+    cache->tronconAmont = lireSection(cache, &position, nbT * sizeof(uint32_t));
+    cache->tronconAval = lireSection(cache, &position, nbT * sizeof(uint32_t));
+    cache->tronconPourcentage = lireSection(cache, &position, nbT * sizeof(double));
+
+    if (*debuts == NULL || *textes == NULL || *hachages == NULL || cache->genres == NULL ||
+        cache->usineIdentifiant == NULL || cache->usineCapacite == NULL ||
+        cache->captageSource == NULL || cache->captageUsine == NULL ||
+        cache->captageVolume == NULL || cache->captagePourcentage == NULL ||
+        cache->tronconUsine == NULL || cache->tronconAmont == NULL ||
+        cache->tronconAval == NULL || cache->tronconPourcentage == NULL)
+        return 1;
+    if ((*debuts)[nbI + 1] != entete->tailleTextes)
+        return 1;
+
+    cache->nbIdentifiants = entete->nbIdentifiants;
+    cache->nbUsines = entete->nbUsines;
+    cache->nbCaptages = entete->nbCaptages;
+    cache->nbTroncons = entete->nbTroncons;
+    return 0;
+}
+
+/* Verifie que les textes du cache sont bien formes */
+static int verifierTextes(const Cache *cache, const uint32_t *debuts, const char *textes) {
+    uint32_t id;
+
+    for (id = 1; id <= cache->nbIdentifiants; id++) {
+        if (debuts[id + 1] <= debuts[id] || textes[debuts[id + 1] - 1] != '\0')
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Ouvre le cache d'un fichier de donnees s'il existe et est a jour
+ * Les identifiants du cache sont enregistres dans la table des
+ * identifiants, qui doit etre vide. Leurs textes restent dans la
+ * projection: le cache ne doit etre ferme qu'apres l'ecriture des
+ * resultats.
+ * Retourne 0 si le cache est utilisable, 1 sinon (lire le texte).
+ */
+int ouvrirCache(Cache *cache, const char *fichierDonnees) {
+    struct stat source, infos;
+    const EnteteCache *entete;
+    const uint32_t *debuts, *hachages;
+    const char *textes;
+    char *nom;
+    void *projection;
+    int fd;
+
+    memset(cache, 0, sizeof(Cache));
+    if (estCheminStandard(fichierDonnees) ||
+        stat(fichierDonnees, &source) != 0 || !S_ISREG(source.st_mode))
+        return 1;
+
+    nom = nomCache(fichierDonnees);
+    fd = open(nom, O_RDONLY);
+    free(nom);
+    if (fd < 0)
+        return 1;
+
+    if (fstat(fd, &infos) != 0 || (size_t)infos.st_size < sizeof(EnteteCache)) {
+        close(fd);
+        return 1;
+    }
+
+    projection = mmap(NULL, (size_t)infos.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (projection == MAP_FAILED)
+        return 1;
+    cache->projection = projection;
+    cache->taille = (size_t)infos.st_size;
+
+    /* Le cache doit correspondre exactement au fichier de donnees */
+    entete = (const EnteteCache*)projection;
+    if (memcmp(entete->magie, MAGIE_CACHE, sizeof(entete->magie)) != 0 ||
+        entete->tailleSource != (uint64_t)source.st_size ||
+        entete->secondesSource != (int64_t)source.st_mtim.tv_sec ||
+        entete->nanosecondesSource != (int64_t)source.st_mtim.tv_nsec ||
+        decouperCache(cache, entete, &debuts, &textes, &hachages) != 0 ||
+        verifierTextes(cache, debuts, textes) != 0 || nombreIdentifiants() != 0) {
+        fermerCache(cache);
+        return 1;
+    }
+
+    adopterIdentifiants(textes, debuts, hachages, cache->nbIdentifiants);
+    return 0;
+}
+
+/* Libere la projection du cache */
+void fermerCache(Cache *cache) {
+    if (cache->projection != NULL)
+        munmap(cache->projection, cache->taille);
+    memset(cache, 0, sizeof(Cache));
+}
@@ -0,0 +1,68 @@
+/*
+ * cache.h - En-tete pour le cache binaire des fichiers de donnees
+ * Projet C-Wildwater
+ *
+ * "wildwater index <fichier.dat>" analyse le fichier une seule fois et
+ * ecrit a cote de lui un fichier <fichier.dat>.wwc contenant:
+ *   - le texte de chaque identifiant, dans l'ordre de leur numero,
+ *   - le genre de chaque identifiant (nom d'usine, nom de source),
+ *   - les lignes classees en trois tables par colonnes: usines,
+ *     captages (source -> usine) et troncons de distribution.
+ *
+ * Les commandes suivantes projettent ce cache avec mmap au lieu de
+ * relire le texte, tant qu'il correspond au fichier de donnees (meme
+ * taille et meme date de modification).
+ *
+ * Les textes des identifiants ne sont pas recopies: le cache doit rester
+ * ouvert tant que des resultats sont ecrits.
+ *
+ * Dans chaque table, les lignes gardent l'ordre du fichier: les sommes
+ * flottantes sont donc les memes qu'en lisant le texte.
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Extension ajoutee au nom du fichier de donnees */
+#define EXTENSION_CACHE ".wwc"
+
+/* Genre d'un identifiant (champs de bits) */
+#define GENRE_USINE  1         /* Plant, Module, Unit, Facility */
+#define GENRE_SOURCE 2         /* Source, Well, Spring, Fountain, Resurgence */
+
+/* Cache projete en memoire */
+typedef struct Cache {
+    void *projection;
+    size_t taille;
+
+    uint32_t nbIdentifiants;
+    const uint8_t *genres;             /* genres[id], id de 1 a nbIdentifiants */
+
+    /* Usines: -;Usine;-;capacite;- */
+    uint32_t nbUsines;
+    const uint32_t *usineIdentifiant;
+    const double *usineCapacite;       /* NAN si la ligne n'a pas la forme complete */
+
+    /* Captages: -;Source;Usine;volume;pourcentage */
+    uint32_t nbCaptages;
+    const uint32_t *captageSource;
+    const uint32_t *captageUsine;
+    const double *captageVolume;
+    const double *captagePourcentage;
+
+    /* Troncons: [usine|-];amont;aval;-;pourcentage */
+    uint32_t nbTroncons;
+    const uint32_t *tronconUsine;      /* IDENTIFIANT_NUL pour "-" */
+    const uint32_t *tronconAmont;
+    const uint32_t *tronconAval;
+    const double *tronconPourcentage;  /* 0 si absent */
+} Cache;
+
+int construireCache(const char *fichierDonnees);
+int ouvrirCache(Cache *cache, const char *fichierDonnees);
+void fermerCache(Cache *cache);
+
+#endif
@@ -0,0 +1,108 @@
+/*
+ * classement.c - Classement des lignes et des identifiants
+ * Projet C-Wildwater
+ *
+ * Table des prefixes: hachage parfait
+ *   h = (prefixe[0] + 2 * prefixe[1] + 10 * longueur) mod 32
+ * Chaque prefixe connu occupe sa propre case; une seule comparaison
+ * confirme la case trouvee. Les cases sont placees par la macro CASE a
+ * partir des memes caracteres: deux prefixes dans la meme case feraient
+ * echouer la compilation (-Werror=override-init).
+ */
+
+#include <string.h>
+#include "classement.h"
+
+#pragma GCC diagnostic error "-Woverride-init"
+
+#define TAILLE_TABLE 32
+
+/* Case d'un prefixe dont on donne les deux premiers caracteres et la longueur */
+#define CASE(c0, c1, longueur) \
+    (((unsigned int)(c0) + 2u * (unsigned int)(c1) + 10u * (unsigned int)(longueur)) % TAILLE_TABLE)
+
+/* Prefixe connu */
+typedef struct Prefixe {
+    const char *texte;         /* NULL pour une case vide */
+    size_t longueur;
+    int genre;
+} Prefixe;
+
+static const Prefixe PREFIXES[TAILLE_TABLE] = {
+    [CASE('P', 'l', 5)]  = { "Plant", 5, NOEUD_USINE },
+    [CASE('M', 'o', 6)]  = { "Module", 6, NOEUD_USINE },
+    [CASE('U', 'n', 4)]  = { "Unit", 4, NOEUD_USINE },
+    [CASE('F', 'a', 16)] = { "Facility complex", 16, NOEUD_USINE },
+    [CASE('S', 'o', 6)]  = { "Source", 6, NOEUD_SOURCE },
+    [CASE('W', 'e', 4)]  = { "Well", 4, NOEUD_SOURCE },
+    [CASE('W', 'e', 10)] = { "Well field", 10, NOEUD_SOURCE },
+    [CASE('S', 'p', 6)]  = { "Spring", 6, NOEUD_SOURCE },
+    [CASE('F', 'o', 8)]  = { "Fountain", 8, NOEUD_SOURCE },
+    [CASE('R', 'e', 10)] = { "Resurgence", 10, NOEUD_SOURCE },
+    [CASE('S', 't', 7)]  = { "Storage", 7, NOEUD_STOCKAGE },
+    [CASE('J', 'u', 8)]  = { "Junction", 8, NOEUD_JONCTION },
+    [CASE('S', 'e', 7)]  = { "Service", 7, NOEUD_RACCORDEMENT },
+    [CASE('C', 'u', 4)]  = { "Cust", 4, NOEUD_USAGER }
+};
+
+/* ========== Genre d'un identifiant ========== */
+
+/* Genre d'apres les mots contenus dans l'identifiant (prefixe inconnu) */
+static int genreParMots(Champ champ) {
+    if (champEstUsine(champ))
+        return NOEUD_USINE;
+    if (champEstSource(champ))
+        return NOEUD_SOURCE;
+    return NOEUD_INCONNU;
+}
+
+/*
+ * Genre d'un identifiant, d'apres le texte avant '#' (espaces de fin
+ * retires), ou tout le champ s'il n'a pas de '#'
+ */
+int genreNoeud(Champ champ) {
+    const unsigned char *texte = (const unsigned char*)champ.debut;
+    const char *diese = (const char*)memchr(champ.debut, '#', champ.longueur);
+    size_t longueur = (diese != NULL) ? (size_t)(diese - champ.debut) : champ.longueur;
+    const Prefixe *prefixe;
+
+    while (longueur > 0 && texte[longueur - 1] == ' ')
+        longueur--;
+    if (longueur < 2)
+        return genreParMots(champ);
+
+    prefixe = &PREFIXES[CASE(texte[0], texte[1], longueur)];
+    if (prefixe->texte != NULL && prefixe->longueur == longueur &&
+        memcmp(prefixe->texte, texte, longueur) == 0)
+        return prefixe->genre;
+    return genreParMots(champ);
+}
+
+/* ========== Genre d'une ligne ========== */
+
+/*
+ * Genre d'une ligne, d'apres sa forme:
+ *   -;X;-;...            usine
+ *   -;X;Y;volume;pct     captage
+ *   ?;X;Y;...            troncon, precise par le genre de Y
+ * Les noms de la ligne usine et du captage ne sont pas verifies ici.
+ */
+int classerLigne(const Champ colonnes[NB_COLONNES], int nbChamps) {
+    if (nbChamps < 3)
+        return LIGNE_AUTRE;
+
+    if (champEgal(colonnes[0], "-") && champEgal(colonnes[2], "-"))
+        return LIGNE_USINE;
+    if (champEgal(colonnes[0], "-") && champEstValeur(colonnes[3]) && champEstValeur(colonnes[4]))
+        return LIGNE_CAPTAGE;
+    if (!champEstValeur(colonnes[2]))
+        return LIGNE_AUTRE;
+
+    switch (genreNoeud(colonnes[2])) {
+        case NOEUD_STOCKAGE:     return LIGNE_STOCKAGE;
+        case NOEUD_JONCTION:     return LIGNE_JONCTION;
+        case NOEUD_RACCORDEMENT: return LIGNE_RACCORDEMENT;
+        case NOEUD_USAGER:       return LIGNE_USAGER;
+        default:                 return LIGNE_TRONCON;
+    }
+}
@@ -0,0 +1,47 @@
+/*
+ * classement.h - En-tete pour le classement des lignes et des identifiants
+ * Projet C-Wildwater
+ *
+ * Un identifiant a la forme "<prefixe> #<code>". Son genre se lit dans
+ * le prefixe, retrouve par une table de hachage parfaite construite a la
+ * compilation (voir classement.c). Un prefixe absent de la table est
+ * classe comme avant, en cherchant les mots d'usine et de source dans
+ * tout l'identifiant.
+ *
+ * Le genre d'une ligne depend de sa forme (colonnes "-" et valeurs
+ * presentes) puis, pour un troncon, du genre du noeud aval. Toutes les
+ * commandes passent par classerLigne: texte, cache, histogramme et fuites
+ * rangent donc les lignes de la meme facon.
+ */
+
+#ifndef CLASSEMENT_H
+#define CLASSEMENT_H
+
+#include "lecture.h"
+
+/* Genre d'un identifiant */
+#define NOEUD_INCONNU      0
+#define NOEUD_USINE        1   /* Plant, Module, Unit, Facility complex */
+#define NOEUD_SOURCE       2   /* Source, Well, Well field, Spring, Fountain, Resurgence */
+#define NOEUD_STOCKAGE     3   /* Storage */
+#define NOEUD_JONCTION     4   /* Junction */
+#define NOEUD_RACCORDEMENT 5   /* Service */
+#define NOEUD_USAGER       6   /* Cust */
+
+/* Genre d'une ligne */
+#define LIGNE_AUTRE        0   /* Vide, incomplete ou sans troncon */
+#define LIGNE_USINE        1   /* -;Usine;-;capacite;- */
+#define LIGNE_CAPTAGE      2   /* -;Source;Usine;volume;pourcentage */
+#define LIGNE_STOCKAGE     3   /* -;Usine;Stockage;-;pourcentage */
+#define LIGNE_JONCTION     4   /* Usine;Stockage;Jonction;-;pourcentage */
+#define LIGNE_RACCORDEMENT 5   /* Usine;Jonction;Raccordement;-;pourcentage */
+#define LIGNE_USAGER       6   /* Usine;Raccordement;Usager;-;pourcentage */
+#define LIGNE_TRONCON      7   /* Troncon vers un noeud de genre inconnu */
+
+/* Vrai pour les lignes qui relient un noeud amont (col2) a un aval (col3) */
+#define LIGNE_EST_TRONCON(genre) ((genre) >= LIGNE_STOCKAGE)
+
+int genreNoeud(Champ champ);
+int classerLigne(const Champ colonnes[NB_COLONNES], int nbChamps);
+
+#endif
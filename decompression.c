@@ -0,0 +1,339 @@
+/*
+ * decompression.c - Lecture des fichiers compresses
+ * Projet C-Wildwater
+ *
+ * Producteur (thread de decompression) et consommateur (lecteur) se
+ * partagent NB_TAMPONS_DECOMPRESSION tampons utilises en anneau:
+ *   - le producteur remplit le tampon prochainRempli s'il est libre,
+ *   - le consommateur vide le tampon prochainLu s'il est pret.
+ * Un tampon pret n'est touche que par le consommateur, un tampon libre
+ * que par le producteur: les copies se font donc hors du verrou, qui ne
+ * protege que les compteurs.
+ *
+ * gzip passe par zlib (gzread, qui enchaine les membres concatenes).
+ * zstd passe par libzstd, seulement si AVEC_ZSTD est defini.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <zlib.h>
+#ifdef AVEC_ZSTD
+#include <zstd.h>
+#endif
+#include "decompression.h"
+
+/* Octets de tete de chaque format */
+static const unsigned char MAGIE_GZIP[2] = { 0x1F, 0x8B };
+static const unsigned char MAGIE_ZSTD[4] = { 0x28, 0xB5, 0x2F, 0xFD };
+
+struct Decompresseur {
+    int fd;
+    int format;
+    const char *chemin;        /* Pour les messages d'erreur */
+    pthread_t thread;
+
+    /* Decodeur du format */
+    gzFile gz;
+#ifdef AVEC_ZSTD
+    ZSTD_DStream *flux;
+    ZSTD_inBuffer entree;
+    char *tamponEntree;
+    size_t tailleEntree;
+    size_t dernierRetour;      /* 0 quand la derniere trame est complete */
+#endif
+
+    /* Anneau de tampons */
+    char *tampons[NB_TAMPONS_DECOMPRESSION];
+    size_t tailles[NB_TAMPONS_DECOMPRESSION];
+    unsigned int prochainRempli;
+    unsigned int prochainLu;
+    unsigned int nbPrets;      /* Tampons remplis, pas encore vides */
+    size_t dejaLu;             /* Octets deja copies du tampon prochainLu */
+
+    pthread_mutex_t verrou;
+    pthread_cond_t pret;       /* Un tampon est pret, ou le producteur a termine */
+    pthread_cond_t libere;     /* Un tampon est libre, ou le lecteur est ferme */
+    int termine;               /* Le producteur n'ecrira plus */
+    int erreur;                /* Donnees illisibles ou corrompues */
+    int arret;                 /* Le lecteur est ferme: le producteur s'arrete */
+};
+
+/* ========== Reconnaissance du format ========== */
+
+/*
+ * Format d'un fichier d'apres ses premiers octets (lus sans deplacer la
+ * position de lecture); FORMAT_BRUT si le descripteur n'est pas un
+ * fichier ou n'est pas compresse
+ */
+int formatCompression(int fd) {
+    unsigned char tete[sizeof(MAGIE_ZSTD)];
+    ssize_t lus = pread(fd, tete, sizeof(tete), 0);
+
+    if (lus >= (ssize_t)sizeof(MAGIE_GZIP) && memcmp(tete, MAGIE_GZIP, sizeof(MAGIE_GZIP)) == 0)
+        return FORMAT_GZIP;
+    if (lus >= (ssize_t)sizeof(MAGIE_ZSTD) && memcmp(tete, MAGIE_ZSTD, sizeof(MAGIE_ZSTD)) == 0)
+        return FORMAT_ZSTD;
+    return FORMAT_BRUT;
+}
+
+/* ========== Producteur ========== */
+
+/* Remplit un tampon avec gzip; retourne les octets ecrits, 0 en fin, -1 en cas d'erreur */
+static ssize_t remplirGzip(Decompresseur *d, char *tampon, size_t capacite) {
+    size_t total = 0;
+    int lus, code;
+
+    while (total < capacite) {
+        lus = gzread(d->gz, tampon + total, (unsigned int)(capacite - total));
+        if (lus < 0) {
+            fprintf(stderr, "Erreur: donnees gzip invalides dans %s (%s)\n",
+                    d->chemin, gzerror(d->gz, &code));
+            return -1;
+        }
+        if (lus == 0) {
+            /* Fin prematuree du flux: gzread le signale par Z_BUF_ERROR */
+            gzerror(d->gz, &code);
+            if (code != Z_OK) {
+                fprintf(stderr, "Erreur: fichier gzip %s tronque\n", d->chemin);
+                return -1;
+            }
+            break;
+        }
+        total += (size_t)lus;
+    }
+    return (ssize_t)total;
+}
+
+#ifdef AVEC_ZSTD
+/* Remplit un tampon avec zstd; retourne les octets ecrits, 0 en fin, -1 en cas d'erreur */
+static ssize_t remplirZstd(Decompresseur *d, char *tampon, size_t capacite) {
+    ZSTD_outBuffer sortie;
+    ssize_t lus;
+
+    sortie.dst = tampon;
+    sortie.size = capacite;
+    sortie.pos = 0;
+    while (sortie.pos < sortie.size) {
+        /* Entree epuisee: lire la suite du fichier */
+        if (d->entree.pos == d->entree.size) {
+            lus = read(d->fd, d->tamponEntree, d->tailleEntree);
+            if (lus < 0 && errno == EINTR)
+                continue;
+            if (lus < 0) {
+                fprintf(stderr, "Erreur: lecture de %s impossible\n", d->chemin);
+                return -1;
+            }
+            if (lus == 0) {
+                if (d->dernierRetour != 0) {
+                    fprintf(stderr, "Erreur: fichier zstd %s tronque\n", d->chemin);
+                    return -1;
+                }
+                break;
+            }
+            d->entree.src = d->tamponEntree;
+            d->entree.size = (size_t)lus;
+            d->entree.pos = 0;
+        }
+        d->dernierRetour = ZSTD_decompressStream(d->flux, &sortie, &d->entree);
+        if (ZSTD_isError(d->dernierRetour)) {
+            fprintf(stderr, "Erreur: donnees zstd invalides dans %s (%s)\n",
+                    d->chemin, ZSTD_getErrorName(d->dernierRetour));
+            return -1;
+        }
+    }
+    return (ssize_t)sortie.pos;
+}
+#endif
+
+/* Boucle du thread de decompression */
+static void* decompresser(void *argument) {
+    Decompresseur *d = (Decompresseur*)argument;
+    unsigned int i;
+    ssize_t n;
+
+    for (;;) {
+        pthread_mutex_lock(&d->verrou);
+        while (d->nbPrets == NB_TAMPONS_DECOMPRESSION && !d->arret)
+            pthread_cond_wait(&d->libere, &d->verrou);
+        if (d->arret) {
+            pthread_mutex_unlock(&d->verrou);
+            return NULL;
+        }
+        i = d->prochainRempli;
+        pthread_mutex_unlock(&d->verrou);
+
+#ifdef AVEC_ZSTD
+        if (d->format == FORMAT_ZSTD)
+            n = remplirZstd(d, d->tampons[i], TAILLE_TAMPON_DECOMPRESSION);
+        else
+#endif
+            n = remplirGzip(d, d->tampons[i], TAILLE_TAMPON_DECOMPRESSION);
+
+        pthread_mutex_lock(&d->verrou);
+        if (n > 0) {
+            d->tailles[i] = (size_t)n;
+            d->prochainRempli = (i + 1) % NB_TAMPONS_DECOMPRESSION;
+            d->nbPrets++;
+        }
+        /* Un tampon incomplet est le dernier */
+        if (n < TAILLE_TAMPON_DECOMPRESSION) {
+            d->termine = 1;
+            d->erreur = (n < 0);
+        }
+        pthread_cond_signal(&d->pret);
+        pthread_mutex_unlock(&d->verrou);
+        if (d->termine)
+            return NULL;
+    }
+}
+
+/* ========== Ouverture et fermeture ========== */
+
+/* Prepare le decodeur du format; retourne 0 en cas de succes */
+static int ouvrirDecodeur(Decompresseur *d) {
+    if (d->format == FORMAT_GZIP) {
+        d->gz = gzdopen(d->fd, "rb");
+        if (d->gz == NULL)
+            return 1;
+        d->fd = -1;                    /* Ferme par gzclose */
+        gzbuffer(d->gz, 1 << 17);
+        return 0;
+    }
+#ifdef AVEC_ZSTD
+    if (d->format == FORMAT_ZSTD) {
+        d->flux = ZSTD_createDStream();
+        d->tailleEntree = ZSTD_DStreamInSize();
+        d->tamponEntree = (char*)malloc(d->tailleEntree);
+        if (d->flux == NULL || d->tamponEntree == NULL) {
+            fprintf(stderr, "Erreur: allocation memoire echouee\n");
+            exit(EXIT_FAILURE);
+        }
+        ZSTD_initDStream(d->flux);
+        d->entree.src = d->tamponEntree;
+        d->entree.size = 0;
+        d->entree.pos = 0;
+        d->dernierRetour = 0;
+        return 0;
+    }
+#endif
+    fprintf(stderr, "Erreur: %s est compresse en zstd, non pris en charge "
+            "(recompiler avec make ZSTD=1)\n", d->chemin);
+    return 1;
+}
+
+/* Libere le decodeur et ferme le fichier */
+static void fermerDecodeur(Decompresseur *d) {
+    if (d->gz != NULL)
+        gzclose(d->gz);
+#ifdef AVEC_ZSTD
+    if (d->flux != NULL)
+        ZSTD_freeDStream(d->flux);
+    free(d->tamponEntree);
+#endif
+    if (d->fd >= 0)
+        close(d->fd);
+}
+
+/*
+ * Lance la decompression d'un fichier (fd lui est confie et sera ferme)
+ * Retourne NULL si le format n'est pas pris en charge.
+ */
+Decompresseur* ouvrirDecompression(int fd, int format, const char *chemin) {
+    Decompresseur *d = (Decompresseur*)calloc(1, sizeof(Decompresseur));
+    int i;
+
+    if (d == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+    d->fd = fd;
+    d->format = format;
+    d->chemin = chemin;
+    if (ouvrirDecodeur(d) != 0) {
+        fermerDecodeur(d);
+        free(d);
+        return NULL;
+    }
+
+    for (i = 0; i < NB_TAMPONS_DECOMPRESSION; i++) {
+        d->tampons[i] = (char*)malloc(TAILLE_TAMPON_DECOMPRESSION);
+        if (d->tampons[i] == NULL) {
+            fprintf(stderr, "Erreur: allocation memoire echouee\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    pthread_mutex_init(&d->verrou, NULL);
+    pthread_cond_init(&d->pret, NULL);
+    pthread_cond_init(&d->libere, NULL);
+
+    if (pthread_create(&d->thread, NULL, decompresser, d) != 0) {
+        fprintf(stderr, "Erreur: creation du thread de decompression impossible\n");
+        exit(EXIT_FAILURE);
+    }
+    return d;
+}
+
+/*
+ * Copie la suite du texte decompresse (au plus capacite octets)
+ * Attend que le thread de decompression ait rempli un tampon.
+ * Retourne le nombre d'octets copies, 0 en fin de fichier, -1 si les
+ * donnees sont corrompues.
+ */
+ssize_t lireDecompression(Decompresseur *d, char *destination, size_t capacite) {
+    unsigned int i;
+    size_t n;
+
+    pthread_mutex_lock(&d->verrou);
+    while (d->nbPrets == 0 && !d->termine)
+        pthread_cond_wait(&d->pret, &d->verrou);
+    if (d->nbPrets == 0) {
+        pthread_mutex_unlock(&d->verrou);
+        return d->erreur ? -1 : 0;
+    }
+    i = d->prochainLu;
+    pthread_mutex_unlock(&d->verrou);
+
+    n = d->tailles[i] - d->dejaLu;
+    if (n > capacite)
+        n = capacite;
+    memcpy(destination, d->tampons[i] + d->dejaLu, n);
+    d->dejaLu += n;
+
+    /* Tampon vide: le rendre au producteur */
+    if (d->dejaLu == d->tailles[i]) {
+        d->dejaLu = 0;
+        pthread_mutex_lock(&d->verrou);
+        d->prochainLu = (i + 1) % NB_TAMPONS_DECOMPRESSION;
+        d->nbPrets--;
+        pthread_cond_signal(&d->libere);
+        pthread_mutex_unlock(&d->verrou);
+    }
+    return (ssize_t)n;
+}
+
+/* Arrete le thread de decompression et libere tout */
+void fermerDecompression(Decompresseur *d) {
+    int i;
+
+    if (d == NULL)
+        return;
+    pthread_mutex_lock(&d->verrou);
+    d->arret = 1;
+    pthread_cond_signal(&d->libere);
+    pthread_mutex_unlock(&d->verrou);
+    pthread_join(d->thread, NULL);
+
+    fermerDecodeur(d);
+    for (i = 0; i < NB_TAMPONS_DECOMPRESSION; i++)
+        free(d->tampons[i]);
+    pthread_mutex_destroy(&d->verrou);
+    pthread_cond_destroy(&d->pret);
+    pthread_cond_destroy(&d->libere);
+    free(d);
+}
@@ -0,0 +1,37 @@
+/*
+ * decompression.h - En-tete pour la lecture des fichiers compresses
+ * Projet C-Wildwater
+ *
+ * Un fichier de donnees compresse (gzip, ou zstd si le programme est
+ * compile avec "make ZSTD=1") est reconnu a ses premiers octets, quel que
+ * soit son nom. Il est decompresse par un thread dedie qui remplit un
+ * anneau de tampons pendant que le thread principal analyse les lignes:
+ * decompression et analyse se recouvrent au lieu de se suivre.
+ *
+ * Le lecteur voit le texte decompresse comme une entree en flux (voir
+ * lecture.h): lecture sequentielle, sans decoupage en tranches.
+ */
+
+#ifndef DECOMPRESSION_H
+#define DECOMPRESSION_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/* Formats reconnus */
+#define FORMAT_BRUT 0          /* Texte non compresse */
+#define FORMAT_GZIP 1
+#define FORMAT_ZSTD 2
+
+/* Anneau de tampons rempli par le thread de decompression */
+#define NB_TAMPONS_DECOMPRESSION 4
+#define TAILLE_TAMPON_DECOMPRESSION (1 << 20)
+
+typedef struct Decompresseur Decompresseur;
+
+int formatCompression(int fd);
+Decompresseur* ouvrirDecompression(int fd, int format, const char *chemin);
+ssize_t lireDecompression(Decompresseur *decompresseur, char *destination, size_t capacite);
+void fermerDecompression(Decompresseur *decompresseur);
+
+#endif
@@ -0,0 +1,267 @@
+/*
+ * etat.c - Etat incremental de l'histogramme (--state)
+ * Projet C-Wildwater
+ *
+ * Disposition du fichier d'etat (ordre des octets de la machine):
+ *   EnteteEtat
+ *   valeurs[nbUsines]     ValeursEtat: capacite, volume capte, volume traite
+ *   textes[tailleTextes]  identifiant de chaque usine, termine par '\0'
+ *
+ * Les usines sont designees par le texte de leur identifiant: les
+ * numeros de la table des identifiants changent d'un processus a l'autre.
+ *
+ * Comme le cache, l'etat est ecrit dans un fichier temporaire puis
+ * renomme: un etat a moitie ecrit n'est jamais relu.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "identifiants.h"
+#include "etat.h"
+
+#define MAGIE_ETAT "WWETAT01"
+
+/* Octets couverts par chacune des deux empreintes */
+#define TAILLE_FENETRE (64 * 1024)
+
+/* En-tete du fichier d'etat */
+typedef struct EnteteEtat {
+    char magie[8];
+    uint64_t position;         /* Octets du fichier de donnees deja agreges */
+    uint32_t empreinteDebut;   /* Hachage des premiers octets agreges */
+    uint32_t empreinteFin;     /* Hachage des derniers octets agreges */
+    uint32_t nbUsines;
+    uint32_t tailleTextes;
+} EnteteEtat;
+
+/* Totaux d'une usine */
+typedef struct ValeursEtat {
+    double capacite_max;
+    double volume_capte;
+    double volume_traite;
+} ValeursEtat;
+
+/* ========== Empreintes ========== */
+
+/* Hachage des octets [debut, fin) du fichier de donnees */
+static uint32_t empreinte(const Lecteur *lecteur, size_t debut, size_t fin) {
+    Champ champ;
+
+    champ.debut = (lecteur->donnees != NULL) ? lecteur->donnees + debut : "";
+    champ.longueur = fin - debut;
+    return hacherChamp(champ);
+}
+
+/* Remplit position et empreintes de l'en-tete */
+static void calculerEmpreintes(EnteteEtat *entete, const Lecteur *lecteur, size_t position) {
+    size_t fenetre = (position < TAILLE_FENETRE) ? position : TAILLE_FENETRE;
+
+    entete->position = (uint64_t)position;
+    entete->empreinteDebut = empreinte(lecteur, 0, fenetre);
+    entete->empreinteFin = empreinte(lecteur, position - fenetre, position);
+}
+
+/* ========== Lecture ========== */
+
+/* Lit tout le fichier d'etat; NULL s'il n'existe pas ou ne peut etre lu */
+static char* lireFichierEtat(const char *chemin, size_t *taille, int *absent) {
+    struct stat infos;
+    FILE *fichier;
+    char *contenu;
+
+    *absent = 0;
+    if (stat(chemin, &infos) != 0) {
+        *absent = (errno == ENOENT);
+        return NULL;
+    }
+    if (!S_ISREG(infos.st_mode) || (size_t)infos.st_size < sizeof(EnteteEtat))
+        return NULL;
+
+    fichier = fopen(chemin, "rb");
+    if (fichier == NULL)
+        return NULL;
+    *taille = (size_t)infos.st_size;
+    contenu = (char*)malloc(*taille);
+    if (contenu == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+    if (fread(contenu, 1, *taille, fichier) != *taille) {
+        free(contenu);
+        contenu = NULL;
+    }
+    fclose(fichier);
+    return contenu;
+}
+
+/*
+ * Charge l'etat enregistre pour ce fichier de donnees
+ * position: recoit le nombre d'octets deja agreges
+ * usines: recoit un tableau alloue (a liberer par l'appelant) des totaux
+ * de chaque usine, identifiants enregistres dans la table des identifiants
+ * Retourne 0 si l'etat est utilisable, 1 s'il faut relire tout le fichier
+ * (etat absent, illisible, ou fichier de donnees tronque ou reecrit).
+ */
+int chargerEtat(const char *chemin, const Lecteur *lecteur, size_t *position,
+                Usine **usines, uint32_t *nbUsines) {
+    EnteteEtat entete, attendu;
+    const ValeursEtat *valeurs;
+    const char *textes, *texte, *finTextes;
+    char *contenu;
+    size_t taille = 0;
+    Champ champ;
+    uint32_t i;
+    int absent;
+
+    *position = 0;
+    *usines = NULL;
+    *nbUsines = 0;
+
+    contenu = lireFichierEtat(chemin, &taille, &absent);
+    if (contenu == NULL) {
+        if (!absent)
+            fprintf(stderr, "Attention: etat %s illisible, relecture complete\n", chemin);
+        return 1;
+    }
+
+    /* Structure du fichier */
+    memcpy(&entete, contenu, sizeof(EnteteEtat));
+    if (memcmp(entete.magie, MAGIE_ETAT, sizeof(entete.magie)) != 0 ||
+        (taille - sizeof(EnteteEtat)) / sizeof(ValeursEtat) < entete.nbUsines ||
+        taille != sizeof(EnteteEtat) + (size_t)entete.nbUsines * sizeof(ValeursEtat)
+                  + entete.tailleTextes) {
+        fprintf(stderr, "Attention: etat %s illisible, relecture complete\n", chemin);
+        free(contenu);
+        return 1;
+    }
+
+    /* Le debut du fichier de donnees doit etre celui qui a ete agrege */
+    if (entete.position > (uint64_t)lecteur->taille) {
+        fprintf(stderr, "Attention: fichier de donnees tronque depuis l'etat %s, "
+                "relecture complete\n", chemin);
+        free(contenu);
+        return 1;
+    }
+    calculerEmpreintes(&attendu, lecteur, (size_t)entete.position);
+    if (attendu.empreinteDebut != entete.empreinteDebut ||
+        attendu.empreinteFin != entete.empreinteFin) {
+        fprintf(stderr, "Attention: fichier de donnees reecrit depuis l'etat %s, "
+                "relecture complete\n", chemin);
+        free(contenu);
+        return 1;
+    }
+
+    valeurs = (const ValeursEtat*)(contenu + sizeof(EnteteEtat));
+    textes = (const char*)(valeurs + entete.nbUsines);
+    finTextes = textes + entete.tailleTextes;
+
+    *usines = (Usine*)malloc(((size_t)entete.nbUsines + 1) * sizeof(Usine));
+    if (*usines == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+
+    texte = textes;
+    for (i = 0; i < entete.nbUsines; i++) {
+        const char *finTexte = (const char*)memchr(texte, '\0', (size_t)(finTextes - texte));
+        if (finTexte == NULL)
+            break;
+        champ.debut = texte;
+        champ.longueur = (size_t)(finTexte - texte);
+        (*usines)[i].identifiant = internerChamp(champ);
+        (*usines)[i].capacite_max = valeurs[i].capacite_max;
+        (*usines)[i].volume_capte = valeurs[i].volume_capte;
+        (*usines)[i].volume_traite = valeurs[i].volume_traite;
+        texte = finTexte + 1;
+    }
+    if (i < entete.nbUsines || texte != finTextes) {
+        fprintf(stderr, "Attention: etat %s illisible, relecture complete\n", chemin);
+        free(*usines);
+        *usines = NULL;
+        free(contenu);
+        return 1;
+    }
+
+    *position = (size_t)entete.position;
+    *nbUsines = entete.nbUsines;
+    free(contenu);
+    return 0;
+}
+
+/* ========== Ecriture ========== */
+
+/*
+ * Enregistre les totaux des usines et la position atteinte dans le
+ * fichier de donnees
+ * Retourne 0 en cas de succes, 1 sinon.
+ */
+int enregistrerEtat(const char *chemin, const Lecteur *lecteur, size_t position,
+                    const Usine *usines, uint32_t nbUsines) {
+    EnteteEtat entete;
+    ValeursEtat valeurs;
+    uint64_t tailleTextes = 0;
+    const char *texte;
+    char *temporaire;
+    FILE *fichier;
+    uint32_t i;
+    int erreur = 0;
+
+    for (i = 0; i < nbUsines; i++)
+        tailleTextes += strlen(texteIdentifiant(usines[i].identifiant)) + 1;
+    if (tailleTextes > UINT32_MAX) {
+        fprintf(stderr, "Erreur: identifiants trop volumineux pour l'etat\n");
+        return 1;
+    }
+
+    memset(&entete, 0, sizeof(EnteteEtat));
+    memcpy(entete.magie, MAGIE_ETAT, sizeof(entete.magie));
+    calculerEmpreintes(&entete, lecteur, position);
+    entete.nbUsines = nbUsines;
+    entete.tailleTextes = (uint32_t)tailleTextes;
+
+    /* Ecriture dans un fichier temporaire, renomme une fois complet */
+    temporaire = (char*)malloc(strlen(chemin) + 5);
+    if (temporaire == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+    sprintf(temporaire, "%s.tmp", chemin);
+
+    fichier = fopen(temporaire, "wb");
+    if (fichier == NULL) {
+        fprintf(stderr, "Erreur: impossible de creer %s\n", temporaire);
+        free(temporaire);
+        return 1;
+    }
+
+    if (fwrite(&entete, sizeof(EnteteEtat), 1, fichier) != 1)
+        erreur = 1;
+    for (i = 0; i < nbUsines && !erreur; i++) {
+        valeurs.capacite_max = usines[i].capacite_max;
+        valeurs.volume_capte = usines[i].volume_capte;
+        valeurs.volume_traite = usines[i].volume_traite;
+        if (fwrite(&valeurs, sizeof(ValeursEtat), 1, fichier) != 1)
+            erreur = 1;
+    }
+    for (i = 0; i < nbUsines && !erreur; i++) {
+        texte = texteIdentifiant(usines[i].identifiant);
+        if (fwrite(texte, 1, strlen(texte) + 1, fichier) != strlen(texte) + 1)
+            erreur = 1;
+    }
+
+    if (fclose(fichier) != 0)
+        erreur = 1;
+    if (!erreur && rename(temporaire, chemin) != 0)
+        erreur = 1;
+    if (erreur) {
+        fprintf(stderr, "Erreur: ecriture de %s impossible\n", chemin);
+        remove(temporaire);
+    }
+    free(temporaire);
+    return erreur;
+}
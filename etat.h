@@ -0,0 +1,33 @@
+/*
+ * etat.h - En-tete pour l'etat incremental de l'histogramme (--state)
+ * Projet C-Wildwater
+ *
+ * Le fichier de donnees grossit par ajout de lignes a la fin. Avec
+ * "histo ... --state <fichier>", les totaux de chaque usine sont
+ * enregistres avec le nombre d'octets deja agreges: au passage suivant,
+ * seules les lignes ajoutees depuis sont analysees.
+ *
+ * Les totaux enregistres sont exactement les sommes partielles du
+ * traitement complet: leur ajouter les lignes suivantes, avec les regles
+ * de insererAVL, donne les memes valeurs qu'une relecture du fichier.
+ *
+ * Pour reconnaitre un fichier tronque ou reecrit, l'etat garde aussi une
+ * empreinte des premiers octets et des derniers octets deja agreges. Si
+ * le fichier est plus court que la position enregistree ou si une
+ * empreinte differe, l'etat est ignore et tout le fichier est relu.
+ */
+
+#ifndef ETAT_H
+#define ETAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "lecture.h"
+#include "avl.h"
+
+int chargerEtat(const char *chemin, const Lecteur *lecteur, size_t *position,
+                Usine **usines, uint32_t *nbUsines);
+int enregistrerEtat(const char *chemin, const Lecteur *lecteur, size_t position,
+                    const Usine *usines, uint32_t nbUsines);
+
+#endif
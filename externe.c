@@ -0,0 +1,515 @@
+/*
+ * externe.c - Agregation de l'histogramme en memoire bornee
+ * Projet C-Wildwater
+ *
+ * Table bornee: adressage ouvert sur des entrees rangees dans un tableau,
+ * textes des cles dans un tas de caracteres. Avant chaque agrandissement,
+ * la taille totale allouee (entrees, cases, cles) est comparee a la
+ * limite: si elle serait depassee, la table n'accepte plus de nouvelle
+ * usine et ne fait plus que cumuler celles qu'elle contient.
+ *
+ * Fichiers temporaires (tmpfile, supprimes a la fermeture): suite
+ * d'enregistrements
+ *   longueur de la cle (uint32), capacite, capte, traite (double), cle
+ * Debordement: dans l'ordre du fichier. Series: par cle decroissante.
+ *
+ * Au plus NB_SERIES_MAX series sont ouvertes en meme temps: au-dela,
+ * elles sont d'abord fusionnees en une seule serie.
+ *
+ * Chaque passage relit le debordement du precedent: le cout croit avec
+ * le nombre d'usines qui ne tiennent pas dans la limite.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "identifiants.h"
+#include "statistiques.h"
+#include "avl.h"
+#include "externe.h"
+
+#define ENTREES_INITIALES 256
+#define CLES_INITIALES (16 * 1024)
+#define NB_SERIES_MAX 64
+
+/* Usine cumulee; sa cle est dans le tas des cles de la table */
+typedef struct Entree {
+    size_t cle;                /* Position du texte dans TableBornee.cles */
+    uint32_t longueur;
+    uint32_t hachage;
+    Usine usine;               /* identifiant inutilise */
+} Entree;
+
+/* Table des usines de taille allouee bornee */
+typedef struct TableBornee {
+    Entree *entrees;
+    uint32_t nb;
+    uint32_t capacite;
+    uint32_t *cases;           /* Indice + 1 d'une entree, 0 pour une case vide */
+    uint32_t nbCases;          /* Puissance de 2 */
+    char *cles;
+    size_t tailleCles;
+    size_t capaciteCles;
+    size_t limite;
+    int pleine;                /* 1 apres un premier refus: plus aucune nouvelle usine */
+} TableBornee;
+
+/* Serie triee en cours de fusion: fichier et enregistrement courant */
+typedef struct Serie {
+    FILE *fichier;
+    char *cle;
+    size_t capacite;
+    uint32_t longueur;
+    Usine usine;
+} Serie;
+
+/* ========== Utilitaires ========== */
+
+/* Alloue ou agrandit un tableau; quitte si la memoire manque */
+static void* reallouer(void *tableau, size_t taille) {
+    void *agrandi = realloc(tableau, (taille > 0) ? taille : 1);
+
+    if (agrandi == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+    return agrandi;
+}
+
+/* Ordre des cles: celui de strcmp sur les textes (comparerIdentifiants) */
+static int comparerCles(const char *a, uint32_t la, const char *b, uint32_t lb) {
+    int c = memcmp(a, b, (la < lb) ? la : lb);
+
+    if (c != 0)
+        return c;
+    return (la < lb) ? -1 : (la > lb);
+}
+
+/* Meme regle que insererAVL et ajouterUsine */
+static void cumulerValeurs(Usine *cible, const Usine *ajout) {
+    if (ajout->capacite_max > 0)
+        cible->capacite_max = ajout->capacite_max;
+    cible->volume_capte += ajout->volume_capte;
+    cible->volume_traite += ajout->volume_traite;
+}
+
+/* ========== Fichiers temporaires ========== */
+
+/* Cree un fichier temporaire; quitte en cas d'echec */
+static FILE* creerTemporaire(void) {
+    FILE *fichier = tmpfile();
+
+    if (fichier == NULL) {
+        fprintf(stderr, "Erreur: impossible de creer un fichier temporaire\n");
+        exit(EXIT_FAILURE);
+    }
+    return fichier;
+}
+
+/* Quitte si une lecture ou une ecriture du fichier temporaire a echoue */
+static void verifierTemporaire(FILE *fichier) {
+    if (ferror(fichier)) {
+        fprintf(stderr, "Erreur: acces au fichier temporaire impossible\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* Ajoute un enregistrement */
+static void ecrireEnregistrement(FILE *fichier, const char *cle, uint32_t longueur,
+                                 const Usine *usine) {
+    double valeurs[3];
+
+    valeurs[0] = usine->capacite_max;
+    valeurs[1] = usine->volume_capte;
+    valeurs[2] = usine->volume_traite;
+    fwrite(&longueur, sizeof(uint32_t), 1, fichier);
+    fwrite(valeurs, sizeof(double), 3, fichier);
+    fwrite(cle, 1, longueur, fichier);
+}
+
+/* Lit l'enregistrement suivant dans le tampon de la serie; retourne 0 a la fin */
+static int lireEnregistrement(Serie *serie) {
+    double valeurs[3];
+
+    if (fread(&serie->longueur, sizeof(uint32_t), 1, serie->fichier) != 1 ||
+        fread(valeurs, sizeof(double), 3, serie->fichier) != 3) {
+        verifierTemporaire(serie->fichier);
+        return 0;
+    }
+    if (serie->longueur + 1 > serie->capacite) {
+        serie->capacite = serie->longueur + 1;
+        serie->cle = (char*)reallouer(serie->cle, serie->capacite);
+    }
+    if (fread(serie->cle, 1, serie->longueur, serie->fichier) != serie->longueur) {
+        verifierTemporaire(serie->fichier);
+        fprintf(stderr, "Erreur: fichier temporaire tronque\n");
+        exit(EXIT_FAILURE);
+    }
+    serie->usine.identifiant = IDENTIFIANT_NUL;
+    serie->usine.capacite_max = valeurs[0];
+    serie->usine.volume_capte = valeurs[1];
+    serie->usine.volume_traite = valeurs[2];
+    return 1;
+}
+
+/* ========== Table bornee ========== */
+
+/* Taille allouee par la table pour les capacites donnees */
+static size_t tailleTable(uint32_t capacite, uint32_t nbCases, size_t capaciteCles) {
+    return (size_t)capacite * sizeof(Entree) + (size_t)nbCases * sizeof(uint32_t) + capaciteCles;
+}
+
+/* Initialise une table vide */
+static void initialiserTableBornee(TableBornee *table, size_t limite) {
+    table->capacite = ENTREES_INITIALES;
+    table->nbCases = 2 * ENTREES_INITIALES;
+    table->capaciteCles = CLES_INITIALES;
+    table->entrees = (Entree*)reallouer(NULL, table->capacite * sizeof(Entree));
+    table->cases = (uint32_t*)calloc(table->nbCases, sizeof(uint32_t));
+    table->cles = (char*)reallouer(NULL, table->capaciteCles);
+    if (table->cases == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+    table->nb = 0;
+    table->tailleCles = 0;
+    table->limite = limite;
+    table->pleine = 0;
+}
+
+/* Vide la table pour un nouveau passage, sans rendre sa memoire */
+static void viderTableBornee(TableBornee *table) {
+    memset(table->cases, 0, (size_t)table->nbCases * sizeof(uint32_t));
+    table->nb = 0;
+    table->tailleCles = 0;
+    table->pleine = 0;
+}
+
+/* Libere la table */
+static void libererTableBornee(TableBornee *table) {
+    free(table->entrees);
+    free(table->cases);
+    free(table->cles);
+}
+
+/* Case de la cle, ou case vide ou l'inserer */
+static uint32_t chercherCase(const TableBornee *table, const char *cle, uint32_t longueur,
+                             uint32_t hachage) {
+    uint32_t masque = table->nbCases - 1;
+    uint32_t c = hachage & masque;
+    const Entree *e;
+
+    while (table->cases[c] != 0) {
+        e = &table->entrees[table->cases[c] - 1];
+        if (e->hachage == hachage && e->longueur == longueur &&
+            memcmp(table->cles + e->cle, cle, longueur) == 0)
+            break;
+        c = (c + 1) & masque;
+    }
+    return c;
+}
+
+/*
+ * Fait de la place pour une entree et une cle de longueur donnee
+ * Retourne 0 si la limite serait depassee; une table vide accepte
+ * toujours sa premiere usine. Apres un refus, la table reste pleine
+ * jusqu'au passage suivant: une usine dont une ligne a ete reportee ne
+ * doit pas etre cumulee en partie dans ce passage.
+ */
+static int reserverPlace(TableBornee *table, uint32_t longueur) {
+    uint32_t capacite = table->capacite;
+    uint32_t nbCases = table->nbCases;
+    size_t capaciteCles = table->capaciteCles;
+    uint32_t i, c;
+
+    if (table->pleine)
+        return 0;
+    if (table->nb == capacite)
+        capacite *= 2;
+    if ((table->nb + 1) * 2 > nbCases)
+        nbCases *= 2;
+    while (table->tailleCles + longueur > capaciteCles)
+        capaciteCles *= 2;
+
+    if (capacite == table->capacite && nbCases == table->nbCases &&
+        capaciteCles == table->capaciteCles)
+        return 1;
+    if (table->nb > 0 && tailleTable(capacite, nbCases, capaciteCles) > table->limite) {
+        table->pleine = 1;
+        return 0;
+    }
+
+    if (capacite != table->capacite) {
+        table->entrees = (Entree*)reallouer(table->entrees, (size_t)capacite * sizeof(Entree));
+        table->capacite = capacite;
+    }
+    if (capaciteCles != table->capaciteCles) {
+        table->cles = (char*)reallouer(table->cles, capaciteCles);
+        table->capaciteCles = capaciteCles;
+    }
+    if (nbCases != table->nbCases) {
+        free(table->cases);
+        table->cases = (uint32_t*)calloc(nbCases, sizeof(uint32_t));
+        if (table->cases == NULL) {
+            fprintf(stderr, "Erreur: allocation memoire echouee\n");
+            exit(EXIT_FAILURE);
+        }
+        table->nbCases = nbCases;
+        for (i = 0; i < table->nb; i++) {
+            c = table->entrees[i].hachage & (nbCases - 1);
+            while (table->cases[c] != 0)
+                c = (c + 1) & (nbCases - 1);
+            table->cases[c] = i + 1;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Cumule une usine dans la table
+ * Retourne 0 si l'usine n'y est pas et que la table est pleine.
+ */
+static int cumulerBornee(TableBornee *table, Champ cle, const Usine *usine) {
+    uint32_t longueur = (uint32_t)cle.longueur;
+    uint32_t hachage = hacherChamp(cle);
+    uint32_t c = chercherCase(table, cle.debut, longueur, hachage);
+    Entree *e;
+
+    if (table->cases[c] != 0) {
+        cumulerValeurs(&table->entrees[table->cases[c] - 1].usine, usine);
+        return 1;
+    }
+    if (!reserverPlace(table, longueur))
+        return 0;
+
+    /* Les cases ont pu etre reconstruites */
+    c = chercherCase(table, cle.debut, longueur, hachage);
+    e = &table->entrees[table->nb];
+    e->cle = table->tailleCles;
+    e->longueur = longueur;
+    e->hachage = hachage;
+    e->usine = *usine;
+    memcpy(table->cles + table->tailleCles, cle.debut, longueur);
+    table->tailleCles += longueur;
+    table->cases[c] = ++table->nb;
+    return 1;
+}
+
+/* Textes des cles pendant le tri (qsort n'a pas de contexte) */
+static const char *clesEnTri;
+
+/* Ordre decroissant des cles, comme l'ecriture des histogrammes */
+static int comparerEntrees(const void *a, const void *b) {
+    const Entree *ea = (const Entree*)a;
+    const Entree *eb = (const Entree*)b;
+
+    return comparerCles(clesEnTri + eb->cle, eb->longueur, clesEnTri + ea->cle, ea->longueur);
+}
+
+/* Trie les entrees par cle decroissante (les cases deviennent invalides) */
+static void trierTableBornee(TableBornee *table) {
+    clesEnTri = table->cles;
+    qsort(table->entrees, table->nb, sizeof(Entree), comparerEntrees);
+}
+
+/* Ecrit une usine dans toutes les sorties */
+static void ecrireDansSorties(Sortie *sorties, const int *modes, int nbModes,
+                              const char *cle, uint32_t longueur, const Usine *usine) {
+    int i;
+
+    for (i = 0; i < nbModes; i++)
+        ecrireUsineNommee(&sorties[i], cle, longueur, usine, modes[i]);
+}
+
+/* ========== Fusion des series ========== */
+
+/* Vrai si la serie a passe avant la serie b (cle plus grande) */
+static int passeAvant(const Serie *a, const Serie *b) {
+    return comparerCles(a->cle, a->longueur, b->cle, b->longueur) > 0;
+}
+
+/* Fait descendre la serie i du tas */
+static void descendreSerie(Serie **tas, int nb, int i) {
+    Serie *tmp;
+    int fils, cible;
+
+    for (;;) {
+        cible = i;
+        fils = 2 * i + 1;
+        if (fils < nb && passeAvant(tas[fils], tas[cible]))
+            cible = fils;
+        fils++;
+        if (fils < nb && passeAvant(tas[fils], tas[cible]))
+            cible = fils;
+        if (cible == i)
+            return;
+        tmp = tas[i];
+        tas[i] = tas[cible];
+        tas[cible] = tmp;
+        i = cible;
+    }
+}
+
+/*
+ * Fusion a k voies des series (cles disjointes, chacune decroissante)
+ * Ecrit dans destination (nouvelle serie) si elle n'est pas NULL, sinon
+ * dans les sorties. Les fichiers des series sont fermes.
+ */
+static void fusionnerSeries(FILE **fichiers, int nbSeries, FILE *destination,
+                            Sortie *sorties, const int *modes, int nbModes) {
+    Serie *series = (Serie*)calloc((size_t)nbSeries, sizeof(Serie));
+    Serie **tas = (Serie**)calloc((size_t)nbSeries, sizeof(Serie*));
+    Serie *s;
+    int nb = 0;
+    int i;
+
+    if (series == NULL || tas == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < nbSeries; i++) {
+        series[i].fichier = fichiers[i];
+        rewind(series[i].fichier);
+        if (lireEnregistrement(&series[i]))
+            tas[nb++] = &series[i];
+    }
+    for (i = nb / 2 - 1; i >= 0; i--)
+        descendreSerie(tas, nb, i);
+
+    while (nb > 0) {
+        s = tas[0];
+        if (destination != NULL)
+            ecrireEnregistrement(destination, s->cle, s->longueur, &s->usine);
+        else
+            ecrireDansSorties(sorties, modes, nbModes, s->cle, s->longueur, &s->usine);
+        if (!lireEnregistrement(s))
+            tas[0] = tas[--nb];
+        descendreSerie(tas, nb, 0);
+    }
+
+    for (i = 0; i < nbSeries; i++) {
+        fclose(series[i].fichier);
+        free(series[i].cle);
+    }
+    free(tas);
+    free(series);
+}
+
+/* ========== Passages ========== */
+
+/* Usine a cumuler, ou a reporter au passage suivant si la table est pleine */
+static void absorber(TableBornee *table, FILE **debordement, Champ cle, const Usine *usine) {
+    if (cumulerBornee(table, cle, usine))
+        return;
+    if (*debordement == NULL)
+        *debordement = creerTemporaire();
+    ecrireEnregistrement(*debordement, cle.debut, (uint32_t)cle.longueur, usine);
+}
+
+/* Premier passage: lignes du fichier de donnees */
+static FILE* passerLignes(Lecteur *lecteur, AnalyseurLigne analyser, TableBornee *table) {
+    Champ col[NB_COLONNES];
+    Champ cle;
+    Usine usine;
+    FILE *debordement = NULL;
+    int nbChamps;
+
+    while ((nbChamps = lireLigne(lecteur, col)) >= 0) {
+        if (analyser(col, nbChamps, &cle, &usine))
+            absorber(table, &debordement, cle, &usine);
+    }
+    return debordement;
+}
+
+/* Passages suivants: enregistrements reportes, dans l'ordre du fichier */
+static FILE* passerDebordement(FILE *reporte, TableBornee *table) {
+    Serie lu = { NULL, NULL, 0, 0, { 0, 0.0, 0.0, 0.0 } };
+    FILE *debordement = NULL;
+    Champ cle;
+
+    lu.fichier = reporte;
+    rewind(reporte);
+    while (lireEnregistrement(&lu)) {
+        cle.debut = lu.cle;
+        cle.longueur = lu.longueur;
+        absorber(table, &debordement, cle, &lu.usine);
+    }
+    fclose(reporte);
+    free(lu.cle);
+    return debordement;
+}
+
+/*
+ * Agrege les usines du lecteur sans depasser limite octets pour la table,
+ * puis ecrit chaque usine, en ordre alphabetique inverse, dans les
+ * sorties (une par mode, en-tetes deja ecrits)
+ * Un echec d'acces aux fichiers temporaires arrete le programme.
+ */
+void agregerExterne(Lecteur *lecteur, size_t limite, AnalyseurLigne analyser,
+                   Sortie *sorties, const int *modes, int nbModes) {
+    TableBornee table;
+    FILE *series[NB_SERIES_MAX];
+    FILE *debordement;
+    FILE *serie;
+    uint64_t nbUsines = 0;
+    uint32_t i;
+    int nbSeries = 0;
+
+    initialiserTableBornee(&table, limite);
+
+    changerPhase(PHASE_ANALYSE);
+    debordement = passerLignes(lecteur, analyser, &table);
+    for (;;) {
+        changerPhase(PHASE_CONSTRUCTION);
+        trierTableBornee(&table);
+        nbUsines += table.nb;
+
+        /* Tout a tenu en un passage: ecriture directe */
+        if (debordement == NULL && nbSeries == 0) {
+            changerPhase(PHASE_ECRITURE);
+            for (i = 0; i < table.nb; i++)
+                ecrireDansSorties(sorties, modes, nbModes, table.cles + table.entrees[i].cle,
+                                  table.entrees[i].longueur, &table.entrees[i].usine);
+            break;
+        }
+
+        /* Serie triee de ce passage */
+        serie = creerTemporaire();
+        for (i = 0; i < table.nb; i++)
+            ecrireEnregistrement(serie, table.cles + table.entrees[i].cle,
+                                 table.entrees[i].longueur, &table.entrees[i].usine);
+        fflush(serie);
+        verifierTemporaire(serie);
+        series[nbSeries++] = serie;
+
+        /* Trop de series ouvertes: les reunir en une seule */
+        if (nbSeries == NB_SERIES_MAX) {
+            serie = creerTemporaire();
+            fusionnerSeries(series, nbSeries, serie, NULL, NULL, 0);
+            fflush(serie);
+            verifierTemporaire(serie);
+            series[0] = serie;
+            nbSeries = 1;
+        }
+
+        if (debordement == NULL)
+            break;
+        fflush(debordement);
+        verifierTemporaire(debordement);
+        viderTableBornee(&table);
+        changerPhase(PHASE_ANALYSE);
+        debordement = passerDebordement(debordement, &table);
+    }
+
+    if (nbSeries > 0) {
+        changerPhase(PHASE_ECRITURE);
+        fusionnerSeries(series, nbSeries, NULL, sorties, modes, nbModes);
+    }
+
+    noterStructure(nbUsines, 0, 0);
+    libererTableBornee(&table);
+}
@@ -0,0 +1,33 @@
+/*
+ * externe.h - En-tete pour l'agregation de l'histogramme en memoire bornee
+ * Projet C-Wildwater
+ *
+ * Avec "histo ... --mem-limit <taille>", les usines ne sont pas rangees
+ * dans la table des identifiants ni dans un AVL: elles sont cumulees dans
+ * une table dont la taille allouee ne depasse pas la limite. Quand elle
+ * est pleine, les lignes des usines qui n'y sont pas encore sont ecrites
+ * telles quelles dans un fichier temporaire de debordement, qui est
+ * agrege au passage suivant. Chaque passage laisse une serie triee dans
+ * un fichier temporaire; les series sont enfin fusionnees (fusion a k
+ * voies) dans l'ordre alphabetique inverse des histogrammes.
+ *
+ * Une usine est cumulee entierement pendant un seul passage, dans
+ * l'ordre du fichier: les sommes sont exactement celles du traitement
+ * en memoire, et les fichiers produits sont identiques.
+ */
+
+#ifndef EXTERNE_H
+#define EXTERNE_H
+
+#include <stddef.h>
+#include "lecture.h"
+#include "parallele.h"
+#include "sortie.h"
+
+/* Plus petite limite acceptee (octets) */
+#define LIMITE_MEMOIRE_MIN (64 * 1024)
+
+void agregerExterne(Lecteur *lecteur, size_t limite, AnalyseurLigne analyser,
+                    Sortie *sorties, const int *modes, int nbModes);
+
+#endif
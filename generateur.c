@@ -0,0 +1,213 @@
+/*
+ * generateur.c - Generateur de fichiers de donnees synthetiques
+ * Projet C-Wildwater
+ *
+ * Ecrit sur la sortie standard (ou dans un fichier) un reseau au format
+ * de wildwater.dat: usines, captages et arbre de distribution
+ * stockages -> jonctions -> raccordements -> usagers.
+ *
+ * Le generateur pseudo-aleatoire est un xorshift64*: pour une meme
+ * graine et les memes parametres, le fichier produit est identique
+ * d'une machine a l'autre.
+ *
+ * Usage:
+ *   ./generateur <nb_lignes> [-s graine] [-o fichier] [--sources N]
+ *                [--stockages N] [--profondeur N] [--sortance N]
+ *
+ * Les usines sont generees une par une jusqu'a depasser nb_lignes: le
+ * fichier contient donc un peu plus de nb_lignes lignes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* Profondeur maximale de l'arbre aval (stockage compris) */
+#define PROFONDEUR_MAX 8
+
+/* Taille du tampon de sortie */
+#define TAILLE_TAMPON (1 << 20)
+
+/* Parametres du reseau genere */
+typedef struct Parametres {
+    uint64_t nbLignes;         /* Nombre de lignes a atteindre */
+    uint64_t graine;
+    int sources;               /* Nombre maximal de captages par usine */
+    int stockages;             /* Nombre maximal de stockages par usine */
+    int profondeur;            /* Niveaux sous l'usine, stockage compris */
+    int sortance;              /* Nombre maximal d'enfants par noeud aval */
+} Parametres;
+
+static uint64_t etat;
+
+static const char *prefixesUsines[] = { "Facility complex", "Plant", "Module", "Unit" };
+static const char *prefixesSources[] = { "Source", "Well", "Spring", "Fountain", "Resurgence" };
+
+/* ========== Generateur pseudo-aleatoire ========== */
+
+/* Tirage xorshift64* */
+static uint64_t tirer(void) {
+    etat ^= etat >> 12;
+    etat ^= etat << 25;
+    etat ^= etat >> 27;
+    return etat * 2685821657736338717ULL;
+}
+
+/* Entier dans [a, b] */
+static int tirerEntre(int a, int b) {
+    return a + (int)(tirer() % (uint64_t)(b - a + 1));
+}
+
+/* Pourcentage de fuite dans [0, 5[ avec 3 decimales */
+static double tirerPourcentage(void) {
+    return (double)(tirer() % 5000) / 1000.0;
+}
+
+/* ========== Ecriture du reseau ========== */
+
+/* Nom d'un niveau aval: Storage en haut, Cust en bas, Service juste au-dessus */
+static const char* nomNiveau(int niveau, int profondeur) {
+    if (niveau == 0)
+        return "Storage";
+    if (niveau == profondeur - 1)
+        return "Cust";
+    if (niveau == profondeur - 2)
+        return "Service";
+    return "Junction";
+}
+
+/*
+ * Ecrit les enfants d'un noeud aval, en profondeur
+ * chemin: suffixe numerique du noeud parent (ex. "12_0_3")
+ * Retourne le nombre de lignes ecrites.
+ */
+static uint64_t ecrireAval(FILE *f, const Parametres *p, const char *usine,
+                           const char *parent, const char *chemin, int niveau) {
+    char enfant[128], cheminEnfant[96];
+    int i, nb;
+    uint64_t lignes = 0;
+
+    if (niveau >= p->profondeur)
+        return 0;
+
+    nb = tirerEntre(1, p->sortance);
+    for (i = 0; i < nb; i++) {
+        snprintf(cheminEnfant, sizeof(cheminEnfant), "%s_%d", chemin, i);
+        snprintf(enfant, sizeof(enfant), "%s #%s", nomNiveau(niveau, p->profondeur), cheminEnfant);
+        fprintf(f, "%s;%s;%s;-;%.3f\n", usine, parent, enfant, tirerPourcentage());
+        lignes++;
+        lignes += ecrireAval(f, p, usine, enfant, cheminEnfant, niveau + 1);
+    }
+    return lignes;
+}
+
+/* Ecrit une usine, ses captages et son reseau aval; retourne le nombre de lignes */
+static uint64_t ecrireUsineGeneree(FILE *f, const Parametres *p, uint64_t numero) {
+    char usine[64], stockage[96], chemin[32];
+    int i, nb;
+    uint64_t lignes = 0;
+
+    snprintf(usine, sizeof(usine), "%s #%c%07llu",
+             prefixesUsines[tirer() % 4], 'A' + (int)(tirer() % 26), (unsigned long long)numero);
+    fprintf(f, "-;%s;-;%d;-\n", usine, tirerEntre(1000, 90000));
+    lignes++;
+
+    nb = tirerEntre(1, p->sources);
+    for (i = 0; i < nb; i++) {
+        fprintf(f, "-;%s #%llu_%d;%s;%d;%.3f\n", prefixesSources[tirer() % 5],
+                (unsigned long long)numero, i, usine, tirerEntre(10, 5000), tirerPourcentage());
+        lignes++;
+    }
+
+    /* Les stockages sont rattaches a l'usine par une ligne -;usine;stockage */
+    nb = tirerEntre(0, p->stockages);
+    for (i = 0; i < nb && p->profondeur > 0; i++) {
+        snprintf(chemin, sizeof(chemin), "%llu_%d", (unsigned long long)numero, i);
+        snprintf(stockage, sizeof(stockage), "Storage #%s", chemin);
+        fprintf(f, "-;%s;%s;-;%.3f\n", usine, stockage, tirerPourcentage());
+        lignes++;
+        lignes += ecrireAval(f, p, usine, stockage, chemin, 1);
+    }
+    return lignes;
+}
+
+/* Lit un entier strictement positif; retourne 0 s'il est invalide */
+static long lireEntier(const char *texte) {
+    char *fin;
+    long valeur = strtol(texte, &fin, 10);
+    return (*fin == '\0' && valeur > 0) ? valeur : 0;
+}
+
+/* Fonction principale */
+int main(int argc, char *argv[]) {
+    Parametres p = { 0, 1, 4, 3, 4, 3 };
+    const char *fichierSortie = NULL;
+    FILE *f = stdout;
+    uint64_t lignes = 0, numero = 0;
+    int i;
+
+    if (argc < 2 || (p.nbLignes = (uint64_t)strtoull(argv[1], NULL, 10)) == 0) {
+        fprintf(stderr, "Usage: %s <nb_lignes> [-s graine] [-o fichier] [--sources N]\n", argv[0]);
+        fprintf(stderr, "        [--stockages N] [--profondeur N] [--sortance N]\n");
+        return 1;
+    }
+
+    /* Options: toutes suivies d'une valeur */
+    for (i = 2; i < argc; i += 2) {
+        int *cible = NULL;
+
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Erreur: option incomplete '%s'\n", argv[i]);
+            return 1;
+        }
+        if (strcmp(argv[i], "-o") == 0) {
+            fichierSortie = argv[i + 1];
+            continue;
+        }
+        if (strcmp(argv[i], "-s") == 0) {
+            p.graine = (uint64_t)strtoull(argv[i + 1], NULL, 10);
+            continue;
+        }
+
+        if (strcmp(argv[i], "--sources") == 0) cible = &p.sources;
+        else if (strcmp(argv[i], "--stockages") == 0) cible = &p.stockages;
+        else if (strcmp(argv[i], "--profondeur") == 0) cible = &p.profondeur;
+        else if (strcmp(argv[i], "--sortance") == 0) cible = &p.sortance;
+        else {
+            fprintf(stderr, "Erreur: option inconnue '%s'\n", argv[i]);
+            return 1;
+        }
+        *cible = (int)lireEntier(argv[i + 1]);
+        if (*cible == 0) {
+            fprintf(stderr, "Erreur: valeur invalide '%s' pour %s\n", argv[i + 1], argv[i]);
+            return 1;
+        }
+    }
+
+    if (p.profondeur > PROFONDEUR_MAX) {
+        fprintf(stderr, "Erreur: profondeur maximale %d\n", PROFONDEUR_MAX);
+        return 1;
+    }
+
+    if (fichierSortie != NULL) {
+        f = fopen(fichierSortie, "w");
+        if (f == NULL) {
+            fprintf(stderr, "Erreur: impossible de creer %s\n", fichierSortie);
+            return 1;
+        }
+    }
+    setvbuf(f, NULL, _IOFBF, TAILLE_TAMPON);
+
+    /* Une graine nulle bloquerait le xorshift */
+    etat = p.graine * 0x9E3779B97F4A7C15ULL + 1;
+
+    while (lignes < p.nbLignes)
+        lignes += ecrireUsineGeneree(f, &p, numero++);
+
+    if (fichierSortie != NULL)
+        fclose(f);
+    fprintf(stderr, "%llu lignes, %llu usines\n", (unsigned long long)lignes,
+            (unsigned long long)numero);
+    return 0;
+}
@@ -0,0 +1,238 @@
+/*
+ * identifiants.c - Table globale des identifiants
+ * Projet C-Wildwater
+ *
+ * Table de hachage a adressage ouvert (sondage lineaire). Les cases
+ * contiennent le numero de l'identifiant; le texte, sa longueur et son
+ * hachage sont ranges dans le tableau des entrees. Les textes sont
+ * copies dans une arene.
+ *
+ * Les identifiants adoptes d'un cache binaire (numeros 1 a nbAdoptes)
+ * sont lus directement dans le cache; les entrees ne servent qu'aux
+ * identifiants enregistres ensuite (numero nbAdoptes + indice).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "memoire.h"
+#include "identifiants.h"
+
+#define NB_CASES_INITIAL 1024
+
+/* Identifiant enregistre */
+typedef struct Entree {
+    const char *texte;         /* Copie terminee par '\0' (dans l'arene) */
+    uint32_t longueur;
+    uint32_t hachage;
+} Entree;
+
+/* Table des identifiants */
+typedef struct TableIdentifiants {
+    uint32_t *cases;           /* Numero de l'identifiant, 0 = case libre */
+    uint32_t nbCases;          /* Puissance de 2 (0: cases pas encore construites) */
+    Entree *entrees;           /* entrees[0] est reserve (IDENTIFIANT_NUL) */
+    uint32_t nbEntrees;
+    uint32_t capaciteEntrees;
+    Arene textes;
+
+    /* Identifiants adoptes (cache binaire) */
+    const char *textesAdoptes;
+    const uint32_t *debutsAdoptes;
+    const uint32_t *hachagesAdoptes;
+    uint32_t nbAdoptes;
+} TableIdentifiants;
+
+static TableIdentifiants table = { NULL, 0, NULL, 0, 0, { NULL }, NULL, NULL, NULL, 0 };
+
+/* ========== Acces aux identifiants ========== */
+
+/* Texte d'un identifiant */
+const char* texteIdentifiant(uint32_t identifiant) {
+    if (identifiant <= table.nbAdoptes)
+        return table.textesAdoptes + table.debutsAdoptes[identifiant];
+    return table.entrees[identifiant - table.nbAdoptes].texte;
+}
+
+/* Longueur du texte d'un identifiant */
+static uint32_t longueurIdentifiant(uint32_t identifiant) {
+    if (identifiant <= table.nbAdoptes)
+        return table.debutsAdoptes[identifiant + 1] - table.debutsAdoptes[identifiant] - 1;
+    return table.entrees[identifiant - table.nbAdoptes].longueur;
+}
+
+/* Hachage du texte d'un identifiant */
+static uint32_t hachageIdentifiant(uint32_t identifiant) {
+    if (identifiant <= table.nbAdoptes)
+        return table.hachagesAdoptes[identifiant];
+    return table.entrees[identifiant - table.nbAdoptes].hachage;
+}
+
+/* Nombre d'identifiants enregistres */
+uint32_t nombreIdentifiants(void) {
+    return table.nbAdoptes + ((table.nbEntrees == 0) ? 0 : table.nbEntrees - 1);
+}
+
+/* ========== Hachage ========== */
+
+/* Hachage FNV-1a d'un champ */
+uint32_t hacherChamp(Champ champ) {
+    uint32_t h = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < champ.longueur; i++) {
+        h ^= (unsigned char)champ.debut[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* ========== Table ========== */
+
+/* Alloue un tableau de cases libres */
+static uint32_t* creerCases(uint32_t nbCases) {
+    uint32_t *cases = (uint32_t*)calloc(nbCases, sizeof(uint32_t));
+    if (cases == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+    return cases;
+}
+
+/*
+ * Replace tous les identifiants dans nbCases cases
+ * Les identifiants sont distincts: aucune comparaison de texte.
+ */
+static void repartirIdentifiants(uint32_t nbCases) {
+    uint32_t *cases = creerCases(nbCases);
+    uint32_t nb = nombreIdentifiants();
+    uint32_t id, c;
+
+    for (id = 1; id <= nb; id++) {
+        c = hachageIdentifiant(id) & (nbCases - 1);
+        while (cases[c] != IDENTIFIANT_NUL)
+            c = (c + 1) & (nbCases - 1);
+        cases[c] = id;
+    }
+
+    free(table.cases);
+    table.cases = cases;
+    table.nbCases = nbCases;
+}
+
+/* Construit les cases si besoin (table neuve ou adoptee) */
+static void preparerCases(void) {
+    uint32_t nbCases = NB_CASES_INITIAL;
+
+    if (table.cases != NULL)
+        return;
+    while (nbCases < 2 * (nombreIdentifiants() + 1))
+        nbCases *= 2;
+    repartirIdentifiants(nbCases);
+}
+
+/* Retourne la case de l'identifiant, ou la case libre ou il doit aller */
+static uint32_t trouverCase(Champ champ, uint32_t hachage) {
+    uint32_t c = hachage & (table.nbCases - 1);
+    uint32_t id;
+
+    while ((id = table.cases[c]) != IDENTIFIANT_NUL) {
+        if (hachageIdentifiant(id) == hachage && longueurIdentifiant(id) == champ.longueur &&
+            memcmp(texteIdentifiant(id), champ.debut, champ.longueur) == 0)
+            return c;
+        c = (c + 1) & (table.nbCases - 1);
+    }
+    return c;
+}
+
+/*
+ * Retourne le numero d'un identifiant, en l'enregistrant s'il est nouveau
+ * Le texte n'est copie que lors du premier enregistrement.
+ */
+uint32_t internerChamp(Champ champ) {
+    uint32_t hachage = hacherChamp(champ);
+    uint32_t c, indice, id;
+    Entree *e;
+
+    preparerCases();
+
+    c = trouverCase(champ, hachage);
+    if (table.cases[c] != IDENTIFIANT_NUL)
+        return table.cases[c];
+
+    indice = reserverElement((void**)&table.entrees, &table.nbEntrees,
+                             &table.capaciteEntrees, sizeof(Entree));
+    id = table.nbAdoptes + indice;
+    e = &table.entrees[indice];
+    e->texte = copierDansArene(&table.textes, champ.debut, champ.longueur);
+    e->longueur = (uint32_t)champ.longueur;
+    e->hachage = hachage;
+    table.cases[c] = id;
+
+    /* Taux de remplissage maximal: 1/2 */
+    if (nombreIdentifiants() * 2 > table.nbCases)
+        repartirIdentifiants(table.nbCases * 2);
+
+    return id;
+}
+
+/*
+ * Adopte des identifiants deja numerotes (cache binaire)
+ * Le texte du numero i commence a textes + debuts[i] et se termine par
+ * '\0' (debuts a nb + 2 elements); hachages[i] est son hachage.
+ * Rien n'est copie: les tableaux doivent rester valides tant que la
+ * table est utilisee. La table doit etre vide.
+ *
+ * Les cases ne sont construites qu'a la premiere recherche: un
+ * traitement qui ne fait qu'ecrire des textes n'en a pas besoin.
+ */
+void adopterIdentifiants(const char *textes, const uint32_t *debuts,
+                         const uint32_t *hachages, uint32_t nb) {
+    table.textesAdoptes = textes;
+    table.debutsAdoptes = debuts;
+    table.hachagesAdoptes = hachages;
+    table.nbAdoptes = nb;
+}
+
+/* Retourne le numero d'un identifiant deja enregistre, IDENTIFIANT_NUL sinon */
+uint32_t chercherIdentifiant(Champ champ) {
+    if (nombreIdentifiants() == 0)
+        return IDENTIFIANT_NUL;
+    preparerCases();
+    return table.cases[trouverCase(champ, hacherChamp(champ))];
+}
+
+/* Libere la table et tous les textes */
+void libererIdentifiants(void) {
+    free(table.cases);
+    free(table.entrees);
+    libererArene(&table.textes);
+    table.cases = NULL;
+    table.nbCases = 0;
+    table.entrees = NULL;
+    table.nbEntrees = 0;
+    table.capaciteEntrees = 0;
+    table.textesAdoptes = NULL;
+    table.debutsAdoptes = NULL;
+    table.hachagesAdoptes = NULL;
+    table.nbAdoptes = 0;
+}
+
+/* ========== Ordre alphabetique ========== */
+
+/* Equivalent de strcmp sur les textes de deux identifiants */
+int comparerIdentifiants(uint32_t a, uint32_t b) {
+    if (a == b)
+        return 0;
+    return strcmp(texteIdentifiant(a), texteIdentifiant(b));
+}
+
+/* Comparateur pour qsort */
+static int comparerPourTri(const void *a, const void *b) {
+    return comparerIdentifiants(*(const uint32_t*)a, *(const uint32_t*)b);
+}
+
+/* Trie un tableau de numeros selon l'ordre alphabetique des textes */
+void trierIdentifiants(uint32_t *identifiants, size_t nb) {
+    qsort(identifiants, nb, sizeof(uint32_t), comparerPourTri);
+}
@@ -0,0 +1,39 @@
+/*
+ * identifiants.h - En-tete pour la table des identifiants
+ * Projet C-Wildwater
+ *
+ * Chaque identifiant distinct du fichier (usine, stockage, usager...)
+ * est stocke une seule fois dans une table de hachage globale et recoit
+ * un numero 32 bits. Les arbres ne manipulent que ces numeros: une
+ * comparaison de cles devient une comparaison d'entiers.
+ *
+ * Le numero 0 (IDENTIFIANT_NUL) ne designe aucun identifiant.
+ * L'ordre alphabetique n'est utilise qu'au moment d'ecrire les resultats.
+ */
+
+#ifndef IDENTIFIANTS_H
+#define IDENTIFIANTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "lecture.h"
+
+#define IDENTIFIANT_NUL 0
+
+/* Hachage FNV-1a d'un champ */
+uint32_t hacherChamp(Champ champ);
+
+/* Table globale */
+uint32_t internerChamp(Champ champ);
+void adopterIdentifiants(const char *textes, const uint32_t *debuts,
+                         const uint32_t *hachages, uint32_t nb);
+uint32_t chercherIdentifiant(Champ champ);
+const char* texteIdentifiant(uint32_t identifiant);
+uint32_t nombreIdentifiants(void);
+void libererIdentifiants(void);
+
+/* Ordre alphabetique des identifiants */
+int comparerIdentifiants(uint32_t a, uint32_t b);
+void trierIdentifiants(uint32_t *identifiants, size_t nb);
+
+#endif
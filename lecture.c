@@ -0,0 +1,577 @@
+/*
+ * lecture.c - Lecture du fichier de donnees sans copie
+ * Projet C-Wildwater
+ *
+ * Le fichier est projete en memoire avec mmap. Si la projection est
+ * impossible (tube, fichier special), il est lu entierement en memoire:
+ * le reste du programme ne voit pas la difference.
+ *
+ * L'entree standard ("-") est projetee si c'est un fichier ordinaire,
+ * sinon lue en flux par blocs: la memoire reste bornee par la taille
+ * d'un bloc et de la plus longue ligne. Un fichier compresse est lu en
+ * flux de la meme facon, depuis son thread de decompression.
+ *
+ * Les separateurs d'une ligne (';' et '\n') sont cherches 16 octets a la
+ * fois (SSE2, present sur tout processeur x86-64) ou 32 (AVX2, si le
+ * processeur le permet, choisi a l'execution). Sur les autres machines,
+ * le decoupage passe par memchr.
+ *
+ * Les nombres sont convertis sans atof quand c'est possible de facon
+ * exacte: au plus 19 chiffres significatifs, une mantisse representable
+ * exactement et au plus 22 decimales. La valeur est alors le quotient de
+ * deux doubles exacts, donc correctement arrondie comme par strtod, et ne
+ * depend pas de la locale.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "lecture.h"
+#include "decompression.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define AVX2_POSSIBLE 1
+#endif
+
+#define TAILLE_BLOC (1 << 20)
+#define TAILLE_NOMBRE 64
+
+/* Limites du calcul exact de champVersDouble */
+#define MAX_CHIFFRES 19
+#define MAX_DECIMALES 22
+#define MAX_MANTISSE_EXACTE (UINT64_C(1) << 53)
+
+/* Chaine vide pointee par les colonnes absentes */
+static const char VIDE[] = "";
+
+/* Puissances de 10 representees exactement par un double */
+static const double PUISSANCES_DIX[MAX_DECIMALES + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*
+ * Recherche des separateurs d'une ligne
+ * p: debut de la ligne, fin: fin des donnees
+ * seps: recoit la position des NB_COLONNES - 1 premiers ';' de la ligne
+ * Retourne la position du '\n' qui termine la ligne (fin s'il n'y en a
+ * pas); *nbSeps recoit le nombre de ';' retenus.
+ */
+typedef const char* (*Decoupeur)(const char *p, const char *fin, const char **seps, int *nbSeps);
+
+static const char* decouperScalaire(const char *p, const char *fin, const char **seps, int *nbSeps);
+static Decoupeur decouper = decouperScalaire;
+static int decoupageChoisi = 0;
+
+/* ========== Ouverture et fermeture ========== */
+
+/* Retourne 1 si le chemin designe l'entree ou la sortie standard */
+int estCheminStandard(const char *chemin) {
+    return strcmp(chemin, CHEMIN_STANDARD) == 0;
+}
+
+/* Prepare la lecture en flux de l'entree standard ou d'un fichier compresse */
+static int ouvrirFlux(Lecteur *lecteur) {
+    lecteur->donnees = (char*)malloc(TAILLE_BLOC);
+    if (lecteur->donnees == NULL)
+        return 1;
+    lecteur->capacite = TAILLE_BLOC;
+    lecteur->flux = 1;
+    return 0;
+}
+
+/*
+ * Complete le tampon d'un flux jusqu'a contenir une ligne entiere a
+ * partir de la position courante, ou jusqu'a la fin du flux
+ * Les lignes deja lues sont retirees du tampon.
+ */
+static void completerFlux(Lecteur *lecteur) {
+    size_t debutRecherche;
+    ssize_t lus;
+
+    if (lecteur->finFlux || memchr(lecteur->donnees + lecteur->position, '\n',
+                                   lecteur->taille - lecteur->position) != NULL)
+        return;
+
+    /* Ramener la ligne commencee au debut du tampon */
+    lecteur->taille -= lecteur->position;
+    memmove(lecteur->donnees, lecteur->donnees + lecteur->position, lecteur->taille);
+    lecteur->position = 0;
+
+    for (;;) {
+        if (lecteur->taille == lecteur->capacite) {
+            char *agrandi = (char*)realloc(lecteur->donnees, lecteur->capacite * 2);
+            if (agrandi == NULL) {
+                fprintf(stderr, "Erreur: allocation memoire echouee\n");
+                exit(EXIT_FAILURE);
+            }
+            lecteur->donnees = agrandi;
+            lecteur->capacite *= 2;
+        }
+        debutRecherche = lecteur->taille;
+        if (lecteur->decompresseur != NULL)
+            lus = lireDecompression(lecteur->decompresseur, lecteur->donnees + lecteur->taille,
+                                    lecteur->capacite - lecteur->taille);
+        else
+            lus = read(STDIN_FILENO, lecteur->donnees + lecteur->taille,
+                       lecteur->capacite - lecteur->taille);
+        if (lus < 0 && errno == EINTR && lecteur->decompresseur == NULL)
+            continue;
+        /* Donnees incompletes: aucun resultat ne serait juste */
+        if (lus < 0) {
+            fprintf(stderr, "Erreur: lecture des donnees interrompue\n");
+            exit(EXIT_FAILURE);
+        }
+        if (lus == 0) {
+            lecteur->finFlux = 1;
+            return;
+        }
+        lecteur->taille += (size_t)lus;
+        if (memchr(lecteur->donnees + debutRecherche, '\n', (size_t)lus) != NULL)
+            return;
+    }
+}
+
+/* Lit tout le contenu d'un descripteur dans un tampon alloue */
+static int lireToutFichier(Lecteur *lecteur, int fd) {
+    size_t capacite = TAILLE_BLOC;
+    ssize_t lus;
+    char *tampon = (char*)malloc(capacite);
+
+    if (tampon == NULL)
+        return 1;
+
+    lecteur->taille = 0;
+    for (;;) {
+        if (lecteur->taille == capacite) {
+            char *agrandi = (char*)realloc(tampon, capacite * 2);
+            if (agrandi == NULL) {
+                free(tampon);
+                return 1;
+            }
+            tampon = agrandi;
+            capacite *= 2;
+        }
+        lus = read(fd, tampon + lecteur->taille, capacite - lecteur->taille);
+        if (lus < 0) {
+            free(tampon);
+            return 1;
+        }
+        if (lus == 0)
+            break;
+        lecteur->taille += (size_t)lus;
+    }
+
+    lecteur->donnees = tampon;
+    lecteur->mappe = 0;
+    return 0;
+}
+
+/*
+ * Ouvre un fichier de donnees
+ * Retourne 0 en cas de succes, 1 en cas d'erreur
+ */
+int ouvrirLecteur(Lecteur *lecteur, const char *chemin) {
+    struct stat infos;
+    void *projection;
+    int format;
+    int fd;
+
+    lecteur->donnees = NULL;
+    lecteur->taille = 0;
+    lecteur->position = 0;
+    lecteur->mappe = 0;
+    lecteur->flux = 0;
+    lecteur->finFlux = 0;
+    lecteur->capacite = 0;
+    lecteur->decompresseur = NULL;
+    memset(lecteur->nbLignes, 0, sizeof(lecteur->nbLignes));
+    if (!decoupageChoisi)
+        choisirDecoupage(meilleurDecoupage());
+
+    /* Entree standard: dupliquee pour que fermer le lecteur ne la ferme pas */
+    if (estCheminStandard(chemin)) {
+        if (fstat(STDIN_FILENO, &infos) != 0 || !S_ISREG(infos.st_mode))
+            return ouvrirFlux(lecteur);
+        fd = dup(STDIN_FILENO);
+    } else {
+        fd = open(chemin, O_RDONLY);
+    }
+    if (fd < 0)
+        return 1;
+
+    /* Fichier compresse: lu en flux, decompresse par un autre thread */
+    format = formatCompression(fd);
+    if (format != FORMAT_BRUT) {
+        lecteur->decompresseur = ouvrirDecompression(fd, format, chemin);
+        if (lecteur->decompresseur == NULL)
+            return 1;
+        if (ouvrirFlux(lecteur) != 0) {
+            fermerDecompression(lecteur->decompresseur);
+            lecteur->decompresseur = NULL;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (fstat(fd, &infos) == 0 && S_ISREG(infos.st_mode)) {
+        /* Fichier vide: rien a projeter */
+        if (infos.st_size == 0) {
+            close(fd);
+            return 0;
+        }
+        projection = mmap(NULL, (size_t)infos.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (projection != MAP_FAILED) {
+            posix_madvise(projection, (size_t)infos.st_size, POSIX_MADV_SEQUENTIAL);
+            lecteur->donnees = (char*)projection;
+            lecteur->taille = (size_t)infos.st_size;
+            lecteur->mappe = 1;
+            close(fd);
+            return 0;
+        }
+    }
+
+    /* Repli: lecture complete en memoire */
+    if (lireToutFichier(lecteur, fd) != 0) {
+        close(fd);
+        return 1;
+    }
+    close(fd);
+    return 0;
+}
+
+/* Reprend la lecture a une position (debut d'une ligne) du fichier */
+void placerLecteur(Lecteur *lecteur, size_t position) {
+    lecteur->position = position;
+}
+
+/*
+ * Position qui suit la derniere fin de ligne du fichier (0 s'il n'y en a
+ * aucune): au-dela commence une ligne incomplete, peut-etre en cours
+ * d'ecriture
+ */
+size_t finDerniereLigne(const Lecteur *lecteur) {
+    size_t position = lecteur->taille;
+
+    while (position > 0 && lecteur->donnees[position - 1] != '\n')
+        position--;
+    return position;
+}
+
+/* Libere la projection ou le tampon, arrete la decompression */
+void fermerLecteur(Lecteur *lecteur) {
+    fermerDecompression(lecteur->decompresseur);
+    lecteur->decompresseur = NULL;
+    if (lecteur->donnees != NULL) {
+        if (lecteur->mappe)
+            munmap(lecteur->donnees, lecteur->taille);
+        else
+            free(lecteur->donnees);
+    }
+    lecteur->donnees = NULL;
+    lecteur->taille = 0;
+    lecteur->position = 0;
+}
+
+/* ========== Decoupage des lignes ========== */
+
+/* Fin de ligne apres le dernier separateur retenu */
+static const char* chercherFinLigne(const char *p, const char *fin) {
+    const char *finLigne = (const char*)memchr(p, '\n', (size_t)(fin - p));
+    return (finLigne != NULL) ? finLigne : fin;
+}
+
+/* Termine octet par octet une recherche commencee par blocs */
+static const char* terminerDecoupage(const char *p, const char *fin, const char **seps,
+                                     int n, int *nbSeps) {
+    while (p < fin && *p != '\n') {
+        if (*p == ';' && n < NB_COLONNES - 1)
+            seps[n++] = p;
+        p++;
+    }
+    *nbSeps = n;
+    return p;
+}
+
+/* Decoupage par memchr: fin de ligne, puis separateurs dans la ligne */
+static const char* decouperScalaire(const char *p, const char *fin, const char **seps, int *nbSeps) {
+    const char *finLigne = chercherFinLigne(p, fin);
+    const char *sep;
+    int n = 0;
+
+    while (n < NB_COLONNES - 1) {
+        sep = (const char*)memchr(p, ';', (size_t)(finLigne - p));
+        if (sep == NULL)
+            break;
+        seps[n++] = sep;
+        p = sep + 1;
+    }
+    *nbSeps = n;
+    return finLigne;
+}
+
+#if defined(__SSE2__)
+/* Decoupage par blocs de 16 octets */
+static const char* decouperSSE2(const char *p, const char *fin, const char **seps, int *nbSeps) {
+    const __m128i pointVirgule = _mm_set1_epi8(';');
+    const __m128i retour = _mm_set1_epi8('\n');
+    unsigned int masqueFin, masqueSep;
+    int n = 0;
+
+    while (fin - p >= 16) {
+        __m128i bloc = _mm_loadu_si128((const __m128i*)p);
+        masqueFin = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(bloc, retour));
+        masqueSep = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(bloc, pointVirgule));
+        /* Seuls comptent les separateurs avant la fin de ligne */
+        if (masqueFin != 0)
+            masqueSep &= (masqueFin & (0u - masqueFin)) - 1;
+        while (masqueSep != 0 && n < NB_COLONNES - 1) {
+            seps[n++] = p + __builtin_ctz(masqueSep);
+            masqueSep &= masqueSep - 1;
+        }
+        if (masqueFin != 0) {
+            *nbSeps = n;
+            return p + __builtin_ctz(masqueFin);
+        }
+        p += 16;
+        if (n == NB_COLONNES - 1) {
+            *nbSeps = n;
+            return chercherFinLigne(p, fin);
+        }
+    }
+    return terminerDecoupage(p, fin, seps, n, nbSeps);
+}
+#endif
+
+#if defined(AVX2_POSSIBLE)
+/* Decoupage par blocs de 32 octets (processeurs AVX2 seulement) */
+__attribute__((target("avx2")))
+static const char* decouperAVX2(const char *p, const char *fin, const char **seps, int *nbSeps) {
+    const __m256i pointVirgule = _mm256_set1_epi8(';');
+    const __m256i retour = _mm256_set1_epi8('\n');
+    uint32_t masqueFin, masqueSep;
+    int n = 0;
+
+    while (fin - p >= 32) {
+        __m256i bloc = _mm256_loadu_si256((const __m256i*)p);
+        masqueFin = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bloc, retour));
+        masqueSep = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bloc, pointVirgule));
+        if (masqueFin != 0)
+            masqueSep &= (masqueFin & (0u - masqueFin)) - 1;
+        while (masqueSep != 0 && n < NB_COLONNES - 1) {
+            seps[n++] = p + __builtin_ctz(masqueSep);
+            masqueSep &= masqueSep - 1;
+        }
+        if (masqueFin != 0) {
+            *nbSeps = n;
+            return p + __builtin_ctz(masqueFin);
+        }
+        p += 32;
+        if (n == NB_COLONNES - 1) {
+            *nbSeps = n;
+            return chercherFinLigne(p, fin);
+        }
+    }
+    return terminerDecoupage(p, fin, seps, n, nbSeps);
+}
+#endif
+
+/* Niveau de decoupage le plus rapide disponible sur ce processeur */
+int meilleurDecoupage(void) {
+#if defined(AVX2_POSSIBLE)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return DECOUPAGE_AVX2;
+#endif
+#if defined(__SSE2__)
+    return DECOUPAGE_SSE2;
+#else
+    return DECOUPAGE_SCALAIRE;
+#endif
+}
+
+/*
+ * Impose le decoupage des lignes (ramene au meilleur niveau disponible)
+ * Doit etre appele avant de lancer des threads de lecture; sans appel,
+ * le premier ouvrirLecteur choisit le meilleur niveau.
+ */
+void choisirDecoupage(int niveau) {
+    int meilleur = meilleurDecoupage();
+
+    if (niveau > meilleur)
+        niveau = meilleur;
+    decouper = decouperScalaire;
+#if defined(__SSE2__)
+    if (niveau >= DECOUPAGE_SSE2)
+        decouper = decouperSSE2;
+#endif
+#if defined(AVX2_POSSIBLE)
+    if (niveau >= DECOUPAGE_AVX2)
+        decouper = decouperAVX2;
+#endif
+    decoupageChoisi = 1;
+}
+
+/*
+ * Decoupe la ligne suivante en colonnes
+ * La derniere colonne s'etend jusqu'a la fin de la ligne.
+ * Les colonnes absentes sont vides (longueur 0).
+ * Retourne le nombre de colonnes lues (0 pour une ligne vide),
+ * ou -1 quand le fichier est termine.
+ */
+int lireLigne(Lecteur *lecteur, Champ colonnes[NB_COLONNES]) {
+    const char *seps[NB_COLONNES - 1];
+    const char *p, *fin, *finLigne;
+    int nbSeps;
+    int nbChamps = 0;
+    int i;
+
+    if (lecteur->flux)
+        completerFlux(lecteur);
+    if (lecteur->position >= lecteur->taille)
+        return -1;
+
+    p = lecteur->donnees + lecteur->position;
+    fin = lecteur->donnees + lecteur->taille;
+
+    finLigne = decouper(p, fin, seps, &nbSeps);
+    lecteur->position = (size_t)(finLigne - lecteur->donnees) + 1;
+
+    /* Ignorer le '\r' des fichiers au format Windows */
+    if (finLigne > p && finLigne[-1] == '\r')
+        finLigne--;
+
+    if (finLigne > p) {
+        for (i = 0; i < nbSeps; i++) {
+            colonnes[nbChamps].debut = p;
+            colonnes[nbChamps].longueur = (size_t)(seps[i] - p);
+            nbChamps++;
+            p = seps[i] + 1;
+        }
+        colonnes[nbChamps].debut = p;
+        colonnes[nbChamps].longueur = (size_t)(finLigne - p);
+        nbChamps++;
+    }
+
+    for (i = nbChamps; i < NB_COLONNES; i++) {
+        colonnes[i].debut = VIDE;
+        colonnes[i].longueur = 0;
+    }
+
+    lecteur->nbLignes[nbChamps]++;
+    return nbChamps;
+}
+
+/* ========== Operations sur les champs ========== */
+
+/* Construit un champ a partir d'une chaine terminee par '\0' */
+Champ champDepuisChaine(const char *chaine) {
+    Champ champ;
+    champ.debut = chaine;
+    champ.longueur = strlen(chaine);
+    return champ;
+}
+
+/* Teste l'egalite d'un champ avec une chaine */
+int champEgal(Champ champ, const char *chaine) {
+    return strncmp(champ.debut, chaine, champ.longueur) == 0 &&
+           chaine[champ.longueur] == '\0';
+}
+
+/* Un champ porte une valeur s'il n'est ni vide ni egal a "-" */
+int champEstValeur(Champ champ) {
+    return champ.longueur > 1 || (champ.longueur == 1 && champ.debut[0] != '-');
+}
+
+/* Equivalent de strstr sur un champ */
+int champContient(Champ champ, const char *motif) {
+    size_t taille = strlen(motif);
+    size_t i;
+
+    if (taille > champ.longueur)
+        return 0;
+    for (i = 0; i + taille <= champ.longueur; i++) {
+        if (champ.debut[i] == motif[0] && memcmp(champ.debut + i, motif, taille) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/* Vrai si le champ designe une usine (Plant, Module, Unit, Facility) */
+int champEstUsine(Champ champ) {
+    return champContient(champ, "Plant") || champContient(champ, "Module") ||
+           champContient(champ, "Unit") || champContient(champ, "Facility");
+}
+
+/* Vrai si le champ designe une source (Source, Well, Spring, Fountain, Resurgence) */
+int champEstSource(Champ champ) {
+    return champContient(champ, "Source") || champContient(champ, "Well") ||
+           champContient(champ, "Spring") || champContient(champ, "Fountain") ||
+           champContient(champ, "Resurgence");
+}
+
+/* Conversion par atof, pour les formes que champVersDouble ne traite pas */
+static double champVersDoubleAtof(Champ champ) {
+    char nombre[TAILLE_NOMBRE];
+    size_t taille = champ.longueur;
+
+    if (taille >= TAILLE_NOMBRE)
+        taille = TAILLE_NOMBRE - 1;
+    memcpy(nombre, champ.debut, taille);
+    nombre[taille] = '\0';
+    return atof(nombre);
+}
+
+/*
+ * Equivalent de atof sur un champ
+ * Forme traitee directement: [+-]chiffres[.chiffres]; le reste (espaces,
+ * exposant, texte apres le nombre, trop de chiffres) passe par atof.
+ */
+double champVersDouble(Champ champ) {
+    const char *p = champ.debut;
+    const char *fin = champ.debut + champ.longueur;
+    uint64_t mantisse = 0;
+    int nbChiffres = 0;
+    int significatifs = 0;
+    int decimales = 0;
+    int negatif = 0;
+    double valeur;
+
+    if (p < fin && (*p == '-' || *p == '+')) {
+        negatif = (*p == '-');
+        p++;
+    }
+    for (; p < fin && *p >= '0' && *p <= '9'; p++, nbChiffres++) {
+        mantisse = mantisse * 10 + (uint64_t)(*p - '0');
+        if (mantisse != 0 && ++significatifs > MAX_CHIFFRES)
+            return champVersDoubleAtof(champ);
+    }
+    if (p < fin && *p == '.') {
+        for (p++; p < fin && *p >= '0' && *p <= '9'; p++, nbChiffres++, decimales++) {
+            mantisse = mantisse * 10 + (uint64_t)(*p - '0');
+            if (mantisse != 0 && ++significatifs > MAX_CHIFFRES)
+                return champVersDoubleAtof(champ);
+        }
+    }
+    if (p != fin || nbChiffres == 0 || decimales > MAX_DECIMALES ||
+        mantisse > MAX_MANTISSE_EXACTE)
+        return champVersDoubleAtof(champ);
+
+    /* Quotient de deux valeurs exactes: un seul arrondi */
+    valeur = (double)mantisse;
+    if (decimales > 0)
+        valeur /= PUISSANCES_DIX[decimales];
+    return negatif ? -valeur : valeur;
+}
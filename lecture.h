@@ -0,0 +1,82 @@
+/*
+ * lecture.h - En-tete pour la lecture du fichier de donnees
+ * Projet C-Wildwater
+ *
+ * Le fichier est projete en memoire (mmap) et decoupe en lignes puis
+ * en colonnes sans aucune copie: chaque colonne est un Champ, c'est a
+ * dire un pointeur vers le debut du texte et sa longueur.
+ * Une copie n'est faite que lorsqu'un identifiant doit etre conserve
+ * (creation d'un noeud).
+ *
+ * Le chemin "-" designe l'entree standard. Si elle n'est pas un fichier
+ * ordinaire (tube), elle est lue en flux: le tampon ne contient que les
+ * lignes en cours, et les champs d'une ligne ne restent valides que
+ * jusqu'a la lecture de la ligne suivante. Un lecteur en flux ne peut
+ * pas etre rembobine ni decoupe en tranches.
+ *
+ * Un fichier compresse (gzip, zstd) est lui aussi lu en flux, a partir
+ * du texte fourni par le thread de decompression (decompression.h).
+ *
+ * Format d'une ligne: col1;col2;col3;col4;col5
+ */
+
+#ifndef LECTURE_H
+#define LECTURE_H
+
+#include <stddef.h>
+
+#define NB_COLONNES 5
+
+/* Recherche des separateurs d'une ligne (choisirDecoupage) */
+#define DECOUPAGE_SCALAIRE 0   /* memchr */
+#define DECOUPAGE_SSE2     1   /* Blocs de 16 octets */
+#define DECOUPAGE_AVX2     2   /* Blocs de 32 octets */
+
+/* Chemin designant l'entree ou la sortie standard */
+#define CHEMIN_STANDARD "-"
+
+struct Decompresseur;
+
+/* Colonne d'une ligne: tranche du fichier, non terminee par '\0' */
+typedef struct Champ {
+    const char *debut;
+    size_t longueur;
+} Champ;
+
+/* Lecteur sequentiel d'un fichier de donnees */
+typedef struct Lecteur {
+    char *donnees;             /* Contenu du fichier */
+    size_t taille;             /* Taille du contenu en octets */
+    size_t position;           /* Debut de la prochaine ligne */
+    int mappe;                 /* 1 si projete par mmap, 0 si lu en memoire */
+    int flux;                  /* 1 si lu en flux depuis l'entree standard */
+    int finFlux;               /* 1 quand le flux est epuise */
+    size_t capacite;           /* Taille allouee du tampon (flux) */
+    struct Decompresseur *decompresseur; /* Source d'un flux compresse, ou NULL */
+    size_t nbLignes[NB_COLONNES + 1]; /* Lignes lues, selon leur nombre de colonnes */
+} Lecteur;
+
+/* Ouverture et fermeture */
+int ouvrirLecteur(Lecteur *lecteur, const char *chemin);
+int estCheminStandard(const char *chemin);
+void placerLecteur(Lecteur *lecteur, size_t position);
+size_t finDerniereLigne(const Lecteur *lecteur);
+void fermerLecteur(Lecteur *lecteur);
+
+/* Lit la ligne suivante: retourne le nombre de colonnes, -1 en fin de fichier */
+int lireLigne(Lecteur *lecteur, Champ colonnes[NB_COLONNES]);
+
+/* Choix du decoupage des lignes */
+int meilleurDecoupage(void);
+void choisirDecoupage(int niveau);
+
+/* Operations sur les champs */
+Champ champDepuisChaine(const char *chaine);
+int champEgal(Champ champ, const char *chaine);
+int champEstValeur(Champ champ);
+int champContient(Champ champ, const char *motif);
+int champEstUsine(Champ champ);
+int champEstSource(Champ champ);
+double champVersDouble(Champ champ);
+
+#endif
@@ -6,302 +6,1691 @@
  * Il peut generer des histogrammes ou calculer les fuites d'une usine.
  * 
  * Usage:
- *   ./wildwater histo <mode> <fichier_entree> <fichier_sortie>
- *   ./wildwater leaks <id_usine> <fichier_entree> <fichier_sortie>
+ *   ./wildwater histo <mode> <fichier_entree> <fichier_sortie> [-j N] [--backend=avl|hash]
+ *                     [--petites <fichier>] [--grandes <fichier>] [--mem-limit <taille>]
+ *   ./wildwater leaks <id_usine> <fichier_entree> <fichier_sortie> [-j N]
+ *   ./wildwater leaks --all <fichier_entree> <fichier_sortie>
+ *   ./wildwater leaks --ids <fichier_ids> <fichier_entree> <fichier_sortie>
+ *   ./wildwater leaks --detail <id_usine> <fichier_entree> <fichier_sortie>
+ *   ./wildwater index <fichier_entree>
+ *   ./wildwater serve <fichier_entree>
+ *
+ * fichier_entree peut etre compresse (gzip, ou zstd avec make ZSTD=1).
+ *
+ * Le chemin "-" designe l'entree standard (fichier_entree, fichier_ids)
+ * ou la sortie standard (fichier_sortie); index et serve exigent un
+ * fichier.
+ *
+ * leaks --detail ajoute au total les NB_PIRES_TRONCONS troncons qui
+ * perdent le plus et le chemin de plus forte perte cumulee depuis l'usine.
+ *
+ * histo --mem-limit borne la memoire de l'agregation (voir externe.h):
+ * les usines en trop passent par des fichiers temporaires.
+ *
+ * L'option --stats (a n'importe quelle position) ecrit sur la sortie
+ * d'erreur la duree de chaque phase et quelques compteurs, en JSON.
  * 
  * Modes pour histo: max, src, real, all
+ *
+ * Plusieurs modes separes par des virgules (ex: max,src,real,all) sont
+ * calcules par une seule lecture: fichier_sortie est alors un repertoire
+ * qui recoit un fichier vol_<mode>.dat par mode, et les chemins de
+ * --petites et --grandes contiennent %s, remplace par le nom du mode.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+#include "lecture.h"
+#include "identifiants.h"
 #include "avl.h"
+#include "table_usines.h"
 #include "arbre_distrib.h"
+#include "parallele.h"
+#include "cache.h"
+#include "selection.h"
+#include "statistiques.h"
+#include "sortie.h"
+#include "etat.h"
+#include "classement.h"
+#include "externe.h"
 
+/* Taille maximale d'une ligne du fichier d'identifiants (--ids) */
 #define TAILLE_LIGNE 256
 
-/* 
- * Traitement pour generer l'histogramme des usines
- * mode: 1=max, 2=src, 3=real, 4=all
+/* Modes de l'histogramme: 1=max, 2=src, 3=real, 4=all */
+#define NB_MODES 4
+
+/* Structures d'agregation de l'histogramme (--backend) */
+#define BACKEND_AVL 0
+#define BACKEND_HASH 1
+
+/* Options facultatives de l'histogramme */
+typedef struct OptionsHisto {
+    int nbThreads;             /* Threads d'ingestion (1 = traitement sequentiel) */
+    int backend;               /* BACKEND_AVL ou BACKEND_HASH */
+    char *fichierPetites;      /* NB_PETITES plus petites usines, ou NULL */
+    char *fichierGrandes;      /* NB_GRANDES plus grandes usines, ou NULL */
+    char *fichierEtat;         /* Etat incremental (--state), ou NULL */
+    size_t limiteMemoire;      /* Agregation en memoire bornee (--mem-limit), 0 sinon */
+} OptionsHisto;
+
+/* Noms des modes, indices par numero de mode */
+static const char *NOMS_MODES[NB_MODES + 1] = { NULL, "max", "src", "real", "all" };
+
+/* Messages de fin de traitement: sur la sortie d'erreur si les resultats
+ * sont ecrits sur la sortie standard ("-") */
+static FILE *messages;
+
+/*
+ * Analyse une ligne pour l'histogramme
+ * Remplit la cle (usine concernee) et les valeurs a cumuler.
+ * Retourne 1 si la ligne concerne une usine, 0 sinon.
  */
-int traiterHistogramme(char *fichierEntree, char *fichierSortie, int mode) {
-    FILE *fIn, *fOut;
-    char ligne[TAILLE_LIGNE];
-    char col1[50], col2[50], col3[50], col4[50], col5[50];
-    NoeudAVL *racine = NULL;
-    Usine usine;
-    int nbChamps;
-    int h;
+static int analyserLigneHisto(Champ col[NB_COLONNES], int nbChamps, Champ *cle, Usine *usine) {
     double volumeCapte, pourcentageFuite;
 
-    /* Ouvrir le fichier d'entree */
-    fIn = fopen(fichierEntree, "r");
-    if (fIn == NULL) {
-        fprintf(stderr, "Erreur: impossible d'ouvrir %s\n", fichierEntree);
-        return 1;
+    switch (classerLigne(col, nbChamps)) {
+        /* Ligne d'usine: -;Usine;-;capacite;- */
+        case LIGNE_USINE:
+            if (!champEgal(col[4], "-") || col[3].longueur == 0 ||
+                genreNoeud(col[1]) != NOEUD_USINE)
+                return 0;
+            *cle = col[1];
+            usine->identifiant = IDENTIFIANT_NUL;
+            usine->capacite_max = champVersDouble(col[3]);
+            usine->volume_capte = 0.0;
+            usine->volume_traite = 0.0;
+            return 1;
+
+        /* Ligne de captage: -;Source;Usine;volume;pourcentage */
+        case LIGNE_CAPTAGE:
+            if (genreNoeud(col[1]) != NOEUD_SOURCE || genreNoeud(col[2]) != NOEUD_USINE)
+                return 0;
+            volumeCapte = champVersDouble(col[3]);
+            pourcentageFuite = champVersDouble(col[4]);
+
+            *cle = col[2];
+            usine->identifiant = IDENTIFIANT_NUL;
+            usine->capacite_max = 0.0;
+            usine->volume_capte = volumeCapte;
+            usine->volume_traite = volumeCapte * (1.0 - pourcentageFuite / 100.0);
+            return 1;
+
+        default:
+            return 0;
     }
+}
 
-    /* Lire chaque ligne du fichier */
-    while (fgets(ligne, TAILLE_LIGNE, fIn) != NULL) {
-        col1[0] = '\0';
-        col2[0] = '\0';
-        col3[0] = '\0';
-        col4[0] = '\0';
-        col5[0] = '\0';
+/* Cumule une usine dans l'AVL en cours de chargement ou dans la table selon le backend */
+static void cumulerUsine(PoolAVL *pool, ChargementAVL *chargement, TableUsines *table,
+                         int backend, Usine usine) {
+    if (backend == BACKEND_HASH)
+        ajouterUsine(table, usine);
+    else
+        chargerUsineAVL(pool, chargement, usine);
+}
 
-        nbChamps = sscanf(ligne, "%49[^;];%49[^;];%49[^;];%49[^;];%49[^\n]",
-                          col1, col2, col3, col4, col5);
+/*
+ * Agrege les usines a partir du cache
+ * Memes regles que analyserLigneHisto; les genres des identifiants
+ * remplacent les recherches de motifs dans le texte.
+ */
+static uint32_t agregerCacheHisto(Cache *cache, PoolAVL *pool, TableUsines *table, int backend) {
+    ChargementAVL chargement;
+    Usine usine;
+    uint32_t i;
 
-        if (nbChamps < 2)
+    commencerChargementAVL(pool, &chargement);
+    usine.volume_capte = 0.0;
+    usine.volume_traite = 0.0;
+    for (i = 0; i < cache->nbUsines; i++) {
+        usine.identifiant = cache->usineIdentifiant[i];
+        usine.capacite_max = cache->usineCapacite[i];
+        if (isnan(usine.capacite_max) || !(cache->genres[usine.identifiant] & GENRE_USINE))
             continue;
+        cumulerUsine(pool, &chargement, table, backend, usine);
+    }
 
-        /* Ligne d'usine: -;Usine;-;capacite;- */
-        if (strcmp(col1, "-") == 0 && strcmp(col3, "-") == 0 && 
-            strcmp(col5, "-") == 0 && strlen(col4) > 0) {
-            if (strstr(col2, "Plant") != NULL || strstr(col2, "Module") != NULL ||
-                strstr(col2, "Unit") != NULL || strstr(col2, "Facility") != NULL) {
-                memset(&usine, 0, sizeof(Usine));
-                strncpy(usine.identifiant, col2, 49);
-                usine.identifiant[49] = '\0';
-                usine.capacite_max = atof(col4);
-                usine.volume_capte = 0.0;
-                usine.volume_traite = 0.0;
-                h = 0;
-                racine = insererAVL(racine, usine, &h);
-            }
-        }
-        /* Ligne de captage: -;Source;Usine;volume;pourcentage */
-        else if (strcmp(col1, "-") == 0 && strlen(col4) > 0 && strcmp(col4, "-") != 0 &&
-                 strlen(col5) > 0 && strcmp(col5, "-") != 0) {
-            if ((strstr(col2, "Source") != NULL || strstr(col2, "Well") != NULL ||
-                 strstr(col2, "Spring") != NULL || strstr(col2, "Fountain") != NULL ||
-                 strstr(col2, "Resurgence") != NULL) &&
-                (strstr(col3, "Plant") != NULL || strstr(col3, "Module") != NULL ||
-                 strstr(col3, "Unit") != NULL || strstr(col3, "Facility") != NULL)) {
-                
-                volumeCapte = atof(col4);
-                pourcentageFuite = atof(col5);
-
-                memset(&usine, 0, sizeof(Usine));
-                strncpy(usine.identifiant, col3, 49);
-                usine.identifiant[49] = '\0';
-                usine.capacite_max = 0.0;
-                usine.volume_capte = volumeCapte;
-                usine.volume_traite = volumeCapte * (1.0 - pourcentageFuite / 100.0);
-                
-                h = 0;
-                racine = insererAVL(racine, usine, &h);
-            }
+    usine.capacite_max = 0.0;
+    for (i = 0; i < cache->nbCaptages; i++) {
+        if (!(cache->genres[cache->captageSource[i]] & GENRE_SOURCE) ||
+            !(cache->genres[cache->captageUsine[i]] & GENRE_USINE))
+            continue;
+        usine.identifiant = cache->captageUsine[i];
+        usine.volume_capte = cache->captageVolume[i];
+        usine.volume_traite = usine.volume_capte * (1.0 - cache->captagePourcentage[i] / 100.0);
+        cumulerUsine(pool, &chargement, table, backend, usine);
+    }
+    return terminerChargementAVL(pool, &chargement);
+}
+
+/* Selections alimentees par un meme parcours des usines */
+typedef struct ListeSelections {
+    Selection *selections;
+    int nb;
+} ListeSelections;
+
+/* Propose une usine a toutes les selections (petites puis grandes de chaque mode) */
+static void proposerAuxSelections(const Usine *usine, void *contexte) {
+    ListeSelections *liste = (ListeSelections*)contexte;
+    int i;
+
+    for (i = 0; i < liste->nb; i++)
+        proposerUsine(&liste->selections[i], usine);
+}
+
+/* Ecrit une selection dans son fichier; retourne 0 en cas de succes */
+static int ecrireFichierSelection(Selection *selection, char *fichier) {
+    Sortie sortie;
+
+    if (ouvrirSortie(&sortie, fichier, 0) != 0) {
+        fprintf(stderr, "Erreur: impossible de creer %s\n", fichier);
+        return 1;
+    }
+    ecrireSelection(selection, &sortie);
+    if (fermerSortie(&sortie) != 0) {
+        fprintf(stderr, "Erreur: ecriture de %s impossible\n", fichier);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Chemin d'un fichier d'extremes pour un mode: le premier "%s" du modele
+ * est remplace par le nom du mode (plusieurs modes a la fois).
+ * Retourne une chaine allouee.
+ */
+static char* cheminPourMode(const char *modele, int mode) {
+    const char *marque = strstr(modele, "%s");
+    size_t avant = (size_t)(marque - modele);
+    size_t taille = strlen(modele) - 2 + strlen(NOMS_MODES[mode]) + 1;
+    char *chemin = (char*)malloc(taille);
+
+    if (chemin == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee pour un nom de fichier\n");
+        exit(EXIT_FAILURE);
+    }
+    snprintf(chemin, taille, "%.*s%s%s", (int)avant, modele, NOMS_MODES[mode], marque + 2);
+    return chemin;
+}
+
+/* Ecrit une selection dans le fichier donne par un modele (ou le modele lui-meme) */
+static int ecrireSelectionMode(Selection *selection, const char *modele, int mode, int nbModes) {
+    char *chemin;
+    int code;
+
+    if (modele == NULL)
+        return 0;
+    if (nbModes == 1)
+        return ecrireFichierSelection(selection, (char*)modele);
+    chemin = cheminPourMode(modele, mode);
+    code = ecrireFichierSelection(selection, chemin);
+    free(chemin);
+    return code;
+}
+
+/*
+ * Ecrit les fichiers des plus petites et plus grandes usines (graphiques)
+ * Un seul parcours des usines alimente les deux tas bornes de chaque mode.
+ */
+static int ecrireExtremes(PoolAVL *pool, uint32_t racine, TableUsines *table, const int *modes,
+                          int nbModes, OptionsHisto *options) {
+    Selection selections[2 * NB_MODES];
+    ListeSelections liste;
+    int code = 0;
+    int i;
+
+    for (i = 0; i < nbModes; i++) {
+        initialiserSelection(&selections[2 * i], NB_PETITES, SELECTION_PETITES, modes[i]);
+        initialiserSelection(&selections[2 * i + 1], NB_GRANDES, SELECTION_GRANDES, modes[i]);
+    }
+    liste.selections = selections;
+    liste.nb = 2 * nbModes;
+
+    if (options->backend == BACKEND_HASH)
+        parcoursTableUsines(table, proposerAuxSelections, &liste);
+    else
+        parcoursAVL(pool, racine, proposerAuxSelections, &liste);
+
+    for (i = 0; i < nbModes; i++) {
+        code |= ecrireSelectionMode(&selections[2 * i], options->fichierPetites, modes[i], nbModes);
+        code |= ecrireSelectionMode(&selections[2 * i + 1], options->fichierGrandes, modes[i], nbModes);
+        libererSelection(&selections[2 * i]);
+        libererSelection(&selections[2 * i + 1]);
+    }
+    return code;
+}
+
+/* Note la taille de la structure d'agregation (--stats) */
+static void noterHistogramme(PoolAVL *pool, uint32_t racine, TableUsines *table, int backend) {
+    if (!statistiquesActives())
+        return;
+    if (backend == BACKEND_HASH)
+        noterStructure(table->nb, 0, 0);
+    else
+        noterStructure((uint64_t)compterNoeuds(pool, racine), pool->nbRotations,
+                       (uint32_t)hauteurAVL(pool, racine));
+}
+
+/* Usines a enregistrer dans l'etat incremental */
+typedef struct ListeEtat {
+    Usine *usines;
+    uint32_t nb;
+} ListeEtat;
+
+/*
+ * Cumule les usines des lignes lues jusqu'a la position fin du fichier
+ * (SIZE_MAX: jusqu'a la fin du fichier, y compris lu en flux)
+ */
+static void lireLignesHisto(Lecteur *lecteur, size_t fin, PoolAVL *pool,
+                            ChargementAVL *chargement, TableUsines *table, int backend) {
+    Champ col[NB_COLONNES];
+    Champ cle;
+    Usine usine;
+    int nbChamps;
+
+    changerPhase(PHASE_ANALYSE);
+    while (lecteur->position < fin && (nbChamps = lireLigne(lecteur, col)) >= 0) {
+        if (analyserLigneHisto(col, nbChamps, &cle, &usine)) {
+            changerPhase(PHASE_CONSTRUCTION);
+            usine.identifiant = internerChamp(cle);
+            cumulerUsine(pool, chargement, table, backend, usine);
+            changerPhase(PHASE_ANALYSE);
         }
     }
+}
+
+/* Range une usine dans le tableau a enregistrer (--state) */
+static void collecterPourEtat(const Usine *usine, void *contexte) {
+    ListeEtat *liste = (ListeEtat*)contexte;
+    liste->usines[liste->nb++] = *usine;
+}
+
+/* Enregistre l'etat: usines agregees jusqu'a la position du fichier */
+static void enregistrerEtatHisto(char *fichierEtat, Lecteur *lecteur, size_t position,
+                                 PoolAVL *pool, uint32_t racine, TableUsines *table,
+                                 int backend) {
+    ListeEtat liste;
+    uint32_t nb = (backend == BACKEND_HASH) ? table->nb : (uint32_t)compterNoeuds(pool, racine);
+
+    liste.usines = (Usine*)malloc(((size_t)nb + 1) * sizeof(Usine));
+    if (liste.usines == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+    liste.nb = 0;
+    if (backend == BACKEND_HASH)
+        parcoursTableUsines(table, collecterPourEtat, &liste);
+    else
+        parcoursAVL(pool, racine, collecterPourEtat, &liste);
+
+    /* En cas d'echec, le prochain passage relira tout le fichier */
+    enregistrerEtat(fichierEtat, lecteur, position, liste.usines, liste.nb);
+    free(liste.usines);
+}
+
+/*
+ * Agrege les usines en reprenant l'etat enregistre (--state)
+ * Seules les lignes ajoutees depuis l'enregistrement sont analysees,
+ * toujours sequentiellement. L'etat est ensuite mis a jour jusqu'a la
+ * derniere ligne complete: une derniere ligne sans fin de ligne (en
+ * cours d'ajout) compte dans l'histogramme, mais sera relue entiere au
+ * prochain passage.
+ */
+static int agregerAvecEtat(char *fichierEntree, OptionsHisto *options, PoolAVL *pool,
+                           uint32_t *racine, TableUsines *table) {
+    Lecteur lecteur;
+    ChargementAVL chargement;
+    Usine *usines;
+    uint32_t nbUsines, i;
+    size_t position, finLignes;
+
+    if (ouvrirLecteur(&lecteur, fichierEntree) != 0) {
+        fprintf(stderr, "Erreur: impossible d'ouvrir %s\n", fichierEntree);
+        return 1;
+    }
+    /* L'etat repere les octets deja agreges dans le fichier lui-meme */
+    if (lecteur.flux) {
+        fprintf(stderr, "Erreur: --state necessite un fichier de donnees non compresse\n");
+        fermerLecteur(&lecteur);
+        return 1;
+    }
+    finLignes = finDerniereLigne(&lecteur);
+
+    /* Totaux deja agreges, avant les lignes ajoutees */
+    commencerChargementAVL(pool, &chargement);
+    if (chargerEtat(options->fichierEtat, &lecteur, &position, &usines, &nbUsines) == 0) {
+        changerPhase(PHASE_CONSTRUCTION);
+        for (i = 0; i < nbUsines; i++)
+            cumulerUsine(pool, &chargement, table, options->backend, usines[i]);
+        free(usines);
+    }
+
+    placerLecteur(&lecteur, position);
+    lireLignesHisto(&lecteur, finLignes, pool, &chargement, table, options->backend);
+    *racine = terminerChargementAVL(pool, &chargement);
+
+    changerPhase(PHASE_ECRITURE);
+    enregistrerEtatHisto(options->fichierEtat, &lecteur, finLignes, pool, *racine, table,
+                         options->backend);
+
+    /* Derniere ligne incomplete eventuelle */
+    lireLignesHisto(&lecteur, SIZE_MAX, pool, &chargement, table, options->backend);
+    *racine = terminerChargementAVL(pool, &chargement);
+
+    compterLignes(&lecteur);
+    fermerLecteur(&lecteur);
+    noterHistogramme(pool, *racine, table, options->backend);
+    return 0;
+}
+
+/*
+ * Agrege les usines du fichier pour l'histogramme
+ * Le cache doit deja etre ouvert (avecCache) ou absent: ses identifiants
+ * sont adoptes une seule fois par processus.
+ * Retourne 0 en cas de succes, 1 si le fichier ne peut pas etre lu.
+ */
+static int agregerHistogramme(char *fichierEntree, Cache *cache, int avecCache,
+                              OptionsHisto *options, PoolAVL *pool, uint32_t *racine,
+                              TableUsines *table) {
+    Lecteur lecteur;
+    ChargementAVL chargement;
 
-    fclose(fIn);
+    *racine = INDICE_NUL;
+    if (options->fichierEtat != NULL)
+        return agregerAvecEtat(fichierEntree, options, pool, racine, table);
+    if (avecCache) {
+        /* Lignes deja classees et converties */
+        changerPhase(PHASE_CONSTRUCTION);
+        *racine = agregerCacheHisto(cache, pool, table, options->backend);
+        noterHistogramme(pool, *racine, table, options->backend);
+        return 0;
+    }
 
-    /* Ouvrir le fichier de sortie */
-    fOut = fopen(fichierSortie, "w");
-    if (fOut == NULL) {
-        fprintf(stderr, "Erreur: impossible de creer %s\n", fichierSortie);
-        libererAVL(racine);
+    /* Ouvrir le fichier d'entree */
+    if (ouvrirLecteur(&lecteur, fichierEntree) != 0) {
+        fprintf(stderr, "Erreur: impossible d'ouvrir %s\n", fichierEntree);
         return 1;
     }
 
-    /* Ecrire l'en-tete */
+    if (options->nbThreads > 1 && !lecteur.flux) {
+        /* Decoupage du fichier en tranches traitees en parallele */
+        if (options->backend == BACKEND_HASH)
+            construireTableParallele(&lecteur, options->nbThreads, analyserLigneHisto, table);
+        else
+            *racine = construireAVLParallele(&lecteur, options->nbThreads, analyserLigneHisto, pool);
+    } else {
+        /* Lire chaque ligne du fichier */
+        commencerChargementAVL(pool, &chargement);
+        lireLignesHisto(&lecteur, SIZE_MAX, pool, &chargement, table, options->backend);
+        *racine = terminerChargementAVL(pool, &chargement);
+    }
+
+    compterLignes(&lecteur);
+    fermerLecteur(&lecteur);
+    noterHistogramme(pool, *racine, table, options->backend);
+    return 0;
+}
+
+/* Ecrit l'en-tete de l'histogramme d'un mode */
+static void ecrireEnteteHistogramme(Sortie *sortie, int mode) {
     if (mode == 1) {
-        fprintf(fOut, "identifier;max volume (M.m3.year-1)\n");
+        ecrireChaine(sortie, "identifier;max volume (M.m3.year-1)\n");
     } else if (mode == 2) {
-        fprintf(fOut, "identifier;source volume (M.m3.year-1)\n");
+        ecrireChaine(sortie, "identifier;source volume (M.m3.year-1)\n");
     } else if (mode == 3) {
-        fprintf(fOut, "identifier;real volume (M.m3.year-1)\n");
+        ecrireChaine(sortie, "identifier;real volume (M.m3.year-1)\n");
     } else if (mode == 4) {
-        fprintf(fOut, "identifier;real volume;lost volume;available capacity\n");
+        ecrireChaine(sortie, "identifier;real volume;lost volume;available capacity\n");
+    }
+}
+
+/*
+ * Ecrit l'en-tete puis les lignes de chaque histogramme, usines en ordre
+ * inverse; un seul tri (ou parcours de l'AVL) sert a toutes les sorties
+ */
+static void ecrireHistogrammes(Sortie *sorties, const int *modes, int nbModes, int backend,
+                               PoolAVL *pool, uint32_t racine, TableUsines *table) {
+    int i;
+
+    for (i = 0; i < nbModes; i++)
+        ecrireEnteteHistogramme(&sorties[i], modes[i]);
+
+    if (backend == BACKEND_HASH)
+        ecrireTableUsinesModes(table, sorties, modes, nbModes);
+    else
+        parcoursInverseAVLModes(pool, racine, sorties, modes, nbModes);
+}
+
+/* Ecrit l'en-tete et les lignes de l'histogramme, usines en ordre inverse */
+static void ecrireHistogramme(Sortie *sortie, int mode, int backend, PoolAVL *pool, uint32_t racine,
+                              TableUsines *table) {
+    ecrireHistogrammes(sortie, &mode, 1, backend, pool, racine, table);
+}
+
+/*
+ * Histogrammes en memoire bornee (--mem-limit): lecture du texte, sans
+ * cache ni table des identifiants, agregation par externe.c
+ */
+static int histogrammeExterne(char *fichierEntree, char **fichiersSortie, const int *modes,
+                              int nbModes, OptionsHisto *options) {
+    Sortie sorties[NB_MODES];
+    Lecteur lecteur;
+    int code = 0;
+    int i, j;
+
+    if (ouvrirLecteur(&lecteur, fichierEntree) != 0) {
+        fprintf(stderr, "Erreur: impossible d'ouvrir %s\n", fichierEntree);
+        return 1;
+    }
+    for (i = 0; i < nbModes; i++) {
+        if (ouvrirSortie(&sorties[i], fichiersSortie[i], 0) != 0) {
+            fprintf(stderr, "Erreur: impossible de creer %s\n", fichiersSortie[i]);
+            for (j = 0; j < i; j++)
+                fermerSortie(&sorties[j]);
+            fermerLecteur(&lecteur);
+            return 1;
+        }
+        ecrireEnteteHistogramme(&sorties[i], modes[i]);
+    }
+
+    agregerExterne(&lecteur, options->limiteMemoire, analyserLigneHisto, sorties, modes, nbModes);
+    compterLignes(&lecteur);
+    fermerLecteur(&lecteur);
+
+    for (i = 0; i < nbModes; i++) {
+        if (fermerSortie(&sorties[i]) != 0) {
+            fprintf(stderr, "Erreur: ecriture de %s impossible\n", fichiersSortie[i]);
+            code = 1;
+        }
+    }
+    if (code == 0)
+        fprintf(messages, "Traitement histogramme termine avec succes\n");
+    changerPhase(PHASE_LIBERATION);
+    return code;
+}
+
+/* 
+ * Traitement pour generer les histogrammes des usines
+ * modes: un ou plusieurs modes (1=max, 2=src, 3=real, 4=all), chacun
+ *        ecrit dans le fichier de meme rang de fichiersSortie
+ * options: threads, backend (BACKEND_AVL: AVL equilibre a chaque
+ *          insertion, BACKEND_HASH: table de hachage triee une seule
+ *          fois a l'ecriture) et fichiers des extremes pour les graphiques
+ *
+ * Les usines sont agregees une seule fois quel que soit le nombre de
+ * modes. Si le fichier a un cache a jour (commande index), il est utilise
+ * a la place du texte.
+ */
+int traiterHistogramme(char *fichierEntree, char **fichiersSortie, const int *modes, int nbModes,
+                       OptionsHisto *options) {
+    Sortie sorties[NB_MODES];
+    Cache cache;
+    PoolAVL pool;
+    uint32_t racine;
+    TableUsines table;
+    int avecCache;
+    int code;
+    int i, j;
+
+    if (options->limiteMemoire > 0)
+        return histogrammeExterne(fichierEntree, fichiersSortie, modes, nbModes, options);
+
+    initialiserPoolAVL(&pool);
+    initialiserTableUsines(&table);
+
+    /* L'etat incremental suppose la lecture du texte */
+    if (options->fichierEtat != NULL) {
+        memset(&cache, 0, sizeof(Cache));
+        avecCache = 0;
+    } else {
+        avecCache = (ouvrirCache(&cache, fichierEntree) == 0);
+    }
+    if (agregerHistogramme(fichierEntree, &cache, avecCache, options, &pool, &racine, &table) != 0) {
+        libererAVL(&pool);
+        libererTableUsines(&table);
+        fermerCache(&cache);
+        return 1;
+    }
+
+    /* Ouvrir les fichiers de sortie */
+    changerPhase(PHASE_ECRITURE);
+    for (i = 0; i < nbModes; i++) {
+        if (ouvrirSortie(&sorties[i], fichiersSortie[i], 0) != 0) {
+            fprintf(stderr, "Erreur: impossible de creer %s\n", fichiersSortie[i]);
+            for (j = 0; j < i; j++)
+                fermerSortie(&sorties[j]);
+            libererAVL(&pool);
+            libererTableUsines(&table);
+            fermerCache(&cache);
+            return 1;
+        }
+    }
+
+    ecrireHistogrammes(sorties, modes, nbModes, options->backend, &pool, racine, &table);
+    code = 0;
+    for (i = 0; i < nbModes; i++) {
+        if (fermerSortie(&sorties[i]) != 0) {
+            fprintf(stderr, "Erreur: ecriture de %s impossible\n", fichiersSortie[i]);
+            code = 1;
+        }
     }
 
-    parcoursInverseAVL(racine, fOut, mode);
+    /* Plus petites et plus grandes usines pour les graphiques */
+    if (options->fichierPetites != NULL || options->fichierGrandes != NULL)
+        code |= ecrireExtremes(&pool, racine, &table, modes, nbModes, options);
 
-    fclose(fOut);
-    printf("Traitement histogramme termine avec succes\n");
-    libererAVL(racine);
+    if (code == 0)
+        fprintf(messages, "Traitement histogramme termine avec succes\n");
+    changerPhase(PHASE_LIBERATION);
+    libererAVL(&pool);
+    libererTableUsines(&table);
+    fermerCache(&cache);
+    return code;
+}
+
+/* Note la taille du reseau: noeuds de l'arbre et de l'index (--stats) */
+static void noterReseau(const Reseau *reseau) {
+    /* Les pools utilises contiennent l'element reserve INDICE_NUL */
+    uint64_t nbNoeuds = (reseau->nbNoeuds > 0) ? reseau->nbNoeuds - 1 : 0;
+    uint64_t nbIndex = (reseau->nbIndex > 0) ? reseau->nbIndex - 1 : 0;
+
+    noterStructure(nbNoeuds + nbIndex, reseau->nbRotations, reseau->profondeurMax);
+}
+
+/* Signale les troncons non rattaches a l'arbre */
+static void signalerIgnores(uint32_t nbIgnores) {
+    if (nbIgnores > 0)
+        fprintf(stderr, "Attention: %u troncon(s) ignore(s), noeud aval deja rattache "
+                "a un autre parent\n", nbIgnores);
+}
+
+/* Signale les troncons vers un noeud deja atteint lors du dernier calcul */
+static void signalerRevisites(const Reseau *reseau, const char *idUsine) {
+    if (reseau->nbRevisites > 0)
+        fprintf(stderr, "Attention: %u troncon(s) vers un noeud deja atteint depuis %s "
+                "(cycle ou parent multiple), sous-arbre compte une seule fois\n",
+                reseau->nbRevisites, idUsine);
+}
+
+/* Retourne le noeud associe a un identifiant, en le creant si besoin */
+static uint32_t obtenirNoeud(Reseau *reseau, uint32_t *index, uint32_t id, double pourcentage) {
+    uint32_t noeud = rechercherAVLIndex(reseau, *index, id);
+    int h = 0;
+
+    if (noeud == INDICE_NUL) {
+        noeud = creerArbre(reseau, id, pourcentage);
+        *index = insererAVLIndex(reseau, *index, id, noeud, &h);
+    }
+    return noeud;
+}
+
+/*
+ * Ajoute un troncon amont -> aval au reseau, l'amont etant cree s'il
+ * n'est pas encore connu: un troncon peut preceder celui de son amont
+ * dans le fichier. Regle commune a leaks <id> et a la foret (--all,
+ * --ids, serve), qui donnent ainsi les memes fuites quel que soit
+ * l'ordre des lignes.
+ * Retourne 1 si le troncon est ignore: l'aval a deja un parent (ou est
+ * l'amont lui-meme).
+ */
+static int ajouterTroncon(Reseau *reseau, uint32_t *index, uint32_t amont, uint32_t aval,
+                          double pourcentage) {
+    uint32_t parent = obtenirNoeud(reseau, index, amont, 0.0);
+    uint32_t enfant = obtenirNoeud(reseau, index, aval, pourcentage);
+
+    if (enfant == parent || NOEUD_ARBRE(reseau, enfant)->parent != INDICE_NUL)
+        return 1;
+    NOEUD_ARBRE(reseau, enfant)->pourcentage = pourcentage;
+    ajouterEnfant(reseau, parent, enfant);
     return 0;
 }
 
+/* Troncon de l'usine lu dans le fichier, en attente de construction */
+typedef struct TronconLu {
+    uint32_t amont;
+    uint32_t aval;
+    double pourcentage;
+} TronconLu;
+
+/* Troncons lus, dans l'ordre du fichier */
+typedef struct ListeTroncons {
+    TronconLu *troncons;
+    size_t nb;
+    size_t capacite;
+} ListeTroncons;
+
+/* Ajoute un troncon a la liste, en l'agrandissant si besoin */
+static void ajouterTronconLu(ListeTroncons *liste, uint32_t amont, uint32_t aval,
+                             double pourcentage) {
+    if (liste->nb == liste->capacite) {
+        size_t capacite = (liste->capacite == 0) ? 1024 : liste->capacite * 2;
+        TronconLu *agrandie = (TronconLu*)realloc(liste->troncons, capacite * sizeof(TronconLu));
+        if (agrandie == NULL) {
+            fprintf(stderr, "Erreur: allocation memoire echouee\n");
+            exit(EXIT_FAILURE);
+        }
+        liste->troncons = agrandie;
+        liste->capacite = capacite;
+    }
+    liste->troncons[liste->nb].amont = amont;
+    liste->troncons[liste->nb].aval = aval;
+    liste->troncons[liste->nb].pourcentage = pourcentage;
+    liste->nb++;
+}
+
+/*
+ * Ecrit le detail des fuites (leaks --detail), apres la ligne du total:
+ *   upstream;downstream;lost volume   pires troncons, du plus fuyard
+ *   node;cumulated lost volume        chemin de plus forte perte cumulee,
+ *                                     de l'usine au dernier noeud
+ */
+static void ecrireDetailFuites(Sortie *sortie, Reseau *reseau, uint32_t racine, DetailFuites *detail) {
+    uint32_t *chemin;
+    uint32_t nb, i;
+    int k;
+
+    trierPiresTroncons(reseau, detail);
+    ecrireChaine(sortie, "upstream;downstream;lost volume (M.m3.year-1)\n");
+    for (k = 0; k < detail->nbPires; k++) {
+        ecrireChaine(sortie, texteIdentifiant(NOEUD_ARBRE(reseau, detail->pires[k].amont)->identifiant));
+        ecrireCaractere(sortie, ';');
+        ecrireChaine(sortie, texteIdentifiant(NOEUD_ARBRE(reseau, detail->pires[k].aval)->identifiant));
+        ecrireCaractere(sortie, ';');
+        ecrireDecimal6(sortie, detail->pires[k].perte / 1000.0);
+        ecrireCaractere(sortie, '\n');
+    }
+
+    chemin = cheminPireFuite(reseau, racine, detail, &nb);
+    ecrireChaine(sortie, "node;cumulated lost volume (M.m3.year-1)\n");
+    for (i = 0; i < nb; i++) {
+        ecrireChaine(sortie, texteIdentifiant(NOEUD_ARBRE(reseau, chemin[i])->identifiant));
+        ecrireCaractere(sortie, ';');
+        ecrireDecimal6(sortie, detail->cumuls[chemin[i]] / 1000.0);
+        ecrireCaractere(sortie, '\n');
+    }
+    free(chemin);
+}
+
 /*
  * Traitement pour calculer les fuites d'une usine
  * 
  * Utilise:
  * - Un Arbre pour representer le reseau de distribution
  * - Un AVL_Index pour retrouver rapidement les noeuds par leur nom
+ *
+ * Le texte est lu en une seule passe: les captages de l'usine donnent
+ * le volume initial, et ses troncons sont gardes dans l'ordre du fichier
+ * puis rattaches a l'arbre une fois l'usine trouvee. L'entree peut donc
+ * etre un tube ("-"). Si le fichier a un cache a jour, les tables du
+ * cache sont parcourues au lieu du texte.
+ *
+ * avecDetail: le meme parcours note aussi les pires troncons et le
+ * chemin de plus forte perte, ecrits apres le total (leaks --detail).
+ * nbThreads: 0 pour le calcul sequentiel, sinon nombre de threads du
+ * parcours par vol de travail (-j N), au total identique pour tout N.
  */
-int traiterFuites(char *fichierEntree, char *fichierSortie, char *idUsine) {
-    FILE *fIn, *fOut;
-    char ligne[TAILLE_LIGNE];
-    char col1[50], col2[50], col3[50], col4[50], col5[50];
+int traiterFuites(char *fichierEntree, char *fichierSortie, char *idUsine, int avecDetail,
+                  int nbThreads) {
+    Sortie sortie;
+    Lecteur lecteur;
+    Cache cache;
+    Champ col[NB_COLONNES];
+    ListeTroncons lus = { NULL, 0, 0 };
     int nbChamps;
+    int genre;
+    int avecCache;
     int usine_trouvee = 0;
     int h;
-    float volume_initial = 0.0f;
-    float fuites_totales = 0.0f;
-    float pourcentage;
+    int code = 0;
+    double volume_initial = 0.0;
+    double fuites_totales = 0.0;
+    double pourcentage;
+    uint32_t i;
+    size_t j;
+    uint32_t nbIgnores = 0;
 
     /* Arbre de distribution et AVL d'index */
-    Arbre *racineArbre = NULL;
-    AVL_Index *racineIndex = NULL;
-    Arbre *parent, *nouveau;
+    DetailFuites detail;
+    Reseau reseau;
+    uint32_t racineArbre = INDICE_NUL;
+    uint32_t racineIndex = INDICE_NUL;
+    uint32_t id;
+
+    avecCache = (ouvrirCache(&cache, fichierEntree) == 0);
 
     /* Ouvrir le fichier d'entree */
-    fIn = fopen(fichierEntree, "r");
-    if (fIn == NULL) {
+    if (!avecCache && ouvrirLecteur(&lecteur, fichierEntree) != 0) {
         fprintf(stderr, "Erreur: impossible d'ouvrir %s\n", fichierEntree);
         return 1;
     }
 
-    /* ========== Premiere passe: calculer le volume initial ========== */
-    /* On cherche les lignes source -> usine pour notre usine */
-    while (fgets(ligne, TAILLE_LIGNE, fIn) != NULL) {
-        col1[0] = '\0';
-        col2[0] = '\0';
-        col3[0] = '\0';
-        col4[0] = '\0';
-        col5[0] = '\0';
+    /* ========== Lecture: volume initial et troncons de l'usine ========== */
+    changerPhase(PHASE_ANALYSE);
+    if (avecCache) {
+        id = chercherIdentifiant(champDepuisChaine(idUsine));
+        for (i = 0; i < cache.nbCaptages; i++) {
+            if (id == IDENTIFIANT_NUL || cache.captageUsine[i] != id)
+                continue;
+            double vol = cache.captageVolume[i];
+            double fuite = cache.captagePourcentage[i];
+            volume_initial += vol * (1.0 - fuite / 100.0);
+            usine_trouvee = 1;
+        }
+    } else {
+        while ((nbChamps = lireLigne(&lecteur, col)) >= 0) {
+            genre = classerLigne(col, nbChamps);
 
-        nbChamps = sscanf(ligne, "%49[^;];%49[^;];%49[^;];%49[^;];%49[^\n]",
-                          col1, col2, col3, col4, col5);
+            /* Ligne source -> usine: -;Source;Usine;volume;pourcentage */
+            if (genre == LIGNE_CAPTAGE && champEgal(col[2], idUsine)) {
+                double vol = champVersDouble(col[3]);
+                double fuite = champVersDouble(col[4]);
+                volume_initial += vol * (1.0 - fuite / 100.0);
+                usine_trouvee = 1;
+            }
 
-        if (nbChamps < 2)
-            continue;
+            /* 
+             * Verifier si cette ligne concerne notre usine:
+             * - col1 contient l'usine (pour distribution)
+             * - OU col1 = "-" et col2 = usine (pour usine -> stockage)
+             */
+            else if (LIGNE_EST_TRONCON(genre) &&
+                     (champEgal(col[0], idUsine) ||
+                      (champEgal(col[0], "-") && champEgal(col[1], idUsine)))) {
 
-        /* Ligne source -> usine: -;Source;Usine;volume;pourcentage */
-        if (strcmp(col1, "-") == 0 && strcmp(col3, idUsine) == 0 &&
-            strlen(col4) > 0 && strcmp(col4, "-") != 0 &&
-            strlen(col5) > 0 && strcmp(col5, "-") != 0) {
-            float vol = (float)atof(col4);
-            float fuite = (float)atof(col5);
-            volume_initial += vol * (1.0f - fuite / 100.0f);
-            usine_trouvee = 1;
+                /* Recuperer le pourcentage de fuite */
+                if (champEstValeur(col[4])) {
+                    pourcentage = champVersDouble(col[4]);
+                } else {
+                    pourcentage = 0.0;
+                }
+                ajouterTronconLu(&lus, internerChamp(col[1]), internerChamp(col[2]), pourcentage);
+            }
         }
+
+        compterLignes(&lecteur);
+        fermerLecteur(&lecteur);
     }
 
     /* Si l'usine n'est pas trouvee, ecrire -1 */
     if (!usine_trouvee) {
-        fclose(fIn);
-        fOut = fopen(fichierSortie, "a");
-        if (fOut == NULL) {
+        fermerCache(&cache);
+        free(lus.troncons);
+        changerPhase(PHASE_ECRITURE);
+        if (ouvrirSortie(&sortie, fichierSortie, 1) != 0) {
             fprintf(stderr, "Erreur: impossible d'ouvrir %s\n", fichierSortie);
             return 1;
         }
-        fprintf(fOut, "%s;-1\n", idUsine);
-        fclose(fOut);
+        ecrireChaine(&sortie, idUsine);
+        ecrireChaine(&sortie, ";-1\n");
+        if (fermerSortie(&sortie) != 0) {
+            fprintf(stderr, "Erreur: ecriture de %s impossible\n", fichierSortie);
+            return 1;
+        }
         return 0;
     }
 
-    /* ========== Deuxieme passe: construire l'arbre de distribution ========== */
-    rewind(fIn);
+    /* ========== Construction de l'arbre de distribution ========== */
 
     /* Creer le noeud racine (l'usine elle-meme) */
-    racineArbre = creerArbre(idUsine, 0.0f);
+    changerPhase(PHASE_CONSTRUCTION);
+    initialiserReseau(&reseau);
+    id = internerChamp(champDepuisChaine(idUsine));
+    racineArbre = creerArbre(&reseau, id, 0.0);
     h = 0;
-    racineIndex = insererAVLIndex(racineIndex, idUsine, racineArbre, &h);
+    racineIndex = insererAVLIndex(&reseau, racineIndex, id, racineArbre, &h);
+
+    if (avecCache) {
+        /* Troncons de l'usine, ou qui partent de l'usine (-;usine;stockage) */
+        for (i = 0; i < cache.nbTroncons; i++) {
+            if (cache.tronconUsine[i] != id &&
+                (cache.tronconUsine[i] != IDENTIFIANT_NUL || cache.tronconAmont[i] != id))
+                continue;
+            nbIgnores += ajouterTroncon(&reseau, &racineIndex, cache.tronconAmont[i],
+                                        cache.tronconAval[i], cache.tronconPourcentage[i]);
+        }
+    } else {
+        /* Troncons dans l'ordre du fichier, un amont inconnu etant cree */
+        for (j = 0; j < lus.nb; j++)
+            nbIgnores += ajouterTroncon(&reseau, &racineIndex, lus.troncons[j].amont,
+                                        lus.troncons[j].aval, lus.troncons[j].pourcentage);
+        free(lus.troncons);
+    }
 
-    while (fgets(ligne, TAILLE_LIGNE, fIn) != NULL) {
-        col1[0] = '\0';
-        col2[0] = '\0';
-        col3[0] = '\0';
-        col4[0] = '\0';
-        col5[0] = '\0';
+    signalerIgnores(nbIgnores);
 
-        nbChamps = sscanf(ligne, "%49[^;];%49[^;];%49[^;];%49[^;];%49[^\n]",
-                          col1, col2, col3, col4, col5);
+    /* ========== Calculer les fuites ========== */
+    compacterReseau(&reseau);
+    changerPhase(PHASE_CALCUL);
+    if (avecDetail)
+        fuites_totales = calculerFuitesDetail(&reseau, racineArbre, volume_initial, &detail);
+    else if (nbThreads > 0)
+        fuites_totales = calculerFuitesParallele(&reseau, racineArbre, volume_initial, nbThreads);
+    else
+        fuites_totales = calculerFuites(&reseau, racineArbre, volume_initial);
+    signalerRevisites(&reseau, idUsine);
+    noterReseau(&reseau);
 
-        if (nbChamps < 3)
-            continue;
+    /* Convertir en millions de m3 */
+    fuites_totales = fuites_totales / 1000.0;
+
+    /* Ecrire le resultat */
+    changerPhase(PHASE_ECRITURE);
+    if (ouvrirSortie(&sortie, fichierSortie, 1) != 0) {
+        fprintf(stderr, "Erreur: impossible d'ouvrir %s\n", fichierSortie);
+        if (avecDetail)
+            libererDetailFuites(&detail);
+        libererReseau(&reseau);
+        fermerCache(&cache);
+        return 1;
+    }
+
+    ecrireChaine(&sortie, idUsine);
+    ecrireCaractere(&sortie, ';');
+    ecrireDecimal6(&sortie, fuites_totales);
+    ecrireCaractere(&sortie, '\n');
+    if (avecDetail)
+        ecrireDetailFuites(&sortie, &reseau, racineArbre, &detail);
+    if (fermerSortie(&sortie) != 0) {
+        fprintf(stderr, "Erreur: ecriture de %s impossible\n", fichierSortie);
+        code = 1;
+    }
+
+    /* Liberer la memoire */
+    changerPhase(PHASE_LIBERATION);
+    if (avecDetail)
+        libererDetailFuites(&detail);
+    libererReseau(&reseau);
+    fermerCache(&cache);
+
+    if (code == 0)
+        fprintf(messages, "Fuites calculees pour %s: %.6f M.m3\n", idUsine, fuites_totales);
+    return code;
+}
 
-        /* 
-         * Verifier si cette ligne concerne notre usine:
-         * - col1 contient l'usine (pour distribution)
-         * - OU col1 = "-" et col2 = usine (pour usine -> stockage)
+/* Ecrit la ligne de fuites d'une usine de la foret */
+static void ecrireFuitesUsine(Reseau *reseau, uint32_t usine, void *contexte) {
+    Sortie *sortie = (Sortie*)contexte;
+    Arbre *n = NOEUD_ARBRE(reseau, usine);
+    double fuites;
+
+    /* volume < 0: usine declaree mais alimentee par aucune source */
+    if (n->volume < 0.0) {
+        ecrireChaine(sortie, texteIdentifiant(n->identifiant));
+        ecrireChaine(sortie, ";-1\n");
+        return;
+    }
+    changerPhase(PHASE_CALCUL);
+    fuites = calculerFuites(reseau, usine, n->volume) / 1000.0;
+    signalerRevisites(reseau, texteIdentifiant(n->identifiant));
+    changerPhase(PHASE_ECRITURE);
+    ecrireChaine(sortie, texteIdentifiant(n->identifiant));
+    ecrireCaractere(sortie, ';');
+    ecrireDecimal6(sortie, fuites);
+    ecrireCaractere(sortie, '\n');
+}
+
+/* Enregistre une usine dans l'index des usines (volume -1 = sans source) */
+static uint32_t obtenirUsine(Reseau *reseau, uint32_t *index, uint32_t *usines, uint32_t id) {
+    uint32_t usine = rechercherAVLIndex(reseau, *usines, id);
+    int h = 0;
+
+    if (usine == INDICE_NUL) {
+        usine = obtenirNoeud(reseau, index, id, 0.0);
+        NOEUD_ARBRE(reseau, usine)->volume = -1.0;
+        *usines = insererAVLIndex(reseau, *usines, id, usine, &h);
+    }
+    return usine;
+}
+
+/* Ajoute le volume d'un captage au volume entrant de l'usine */
+static void ajouterCaptage(Reseau *reseau, uint32_t *index, uint32_t *usines, uint32_t id,
+                           double volume, double fuite) {
+    uint32_t usine = obtenirUsine(reseau, index, usines, id);
+    Arbre *n = NOEUD_ARBRE(reseau, usine);
+
+    if (n->volume < 0.0)
+        n->volume = 0.0;
+    n->volume += volume * (1.0 - fuite / 100.0);
+}
+
+/* Liste des numeros d'identifiant des usines, a trier avant ecriture */
+typedef struct ListeUsines {
+    uint32_t *identifiants;
+    size_t nb;
+} ListeUsines;
+
+/* Ajoute une usine de l'index a la liste */
+static void collecterUsine(Reseau *reseau, uint32_t usine, void *contexte) {
+    ListeUsines *liste = (ListeUsines*)contexte;
+    liste->identifiants[liste->nb++] = NOEUD_ARBRE(reseau, usine)->identifiant;
+}
+
+/* Foret de distribution de toutes les usines */
+typedef struct Foret {
+    Reseau reseau;
+    uint32_t racineIndex;      /* Index de tous les noeuds */
+    uint32_t racineUsines;     /* Index des usines seules */
+} Foret;
+
+/*
+ * Construit la foret de distribution de toutes les usines
+ * Le fichier n'est lu qu'une seule fois. Comme pour l'histogramme, le
+ * cache doit deja etre ouvert (avecCache) ou absent.
+ * Retourne 0 en cas de succes, 1 si le fichier ne peut pas etre lu.
+ */
+static int construireForet(char *fichierEntree, Cache *cache, int avecCache, Foret *foret) {
+    Lecteur lecteur;
+    Champ col[NB_COLONNES];
+    int nbChamps;
+    int genre;
+    double pourcentage;
+    uint32_t nbIgnores = 0;
+    uint32_t j;
+    Reseau *reseau = &foret->reseau;
+
+    initialiserReseau(reseau);
+    foret->racineIndex = INDICE_NUL;
+    foret->racineUsines = INDICE_NUL;
+
+    if (avecCache) {
+        changerPhase(PHASE_CONSTRUCTION);
+        /*
+         * Les tables du cache sont parcourues l'une apres l'autre: chaque
+         * table garde l'ordre du fichier, ce qui suffit pour obtenir les
+         * memes listes d'enfants et les memes sommes de volumes.
          */
-        if ((strcmp(col1, idUsine) == 0) || 
-            (strcmp(col1, "-") == 0 && strcmp(col2, idUsine) == 0)) {
-            
-            /* Recuperer le pourcentage de fuite */
-            if (strlen(col5) > 0 && strcmp(col5, "-") != 0) {
-                pourcentage = (float)atof(col5);
-            } else {
-                pourcentage = 0.0f;
-            }
+        for (j = 0; j < cache->nbUsines; j++)
+            obtenirUsine(reseau, &foret->racineIndex, &foret->racineUsines,
+                         cache->usineIdentifiant[j]);
+        for (j = 0; j < cache->nbCaptages; j++)
+            ajouterCaptage(reseau, &foret->racineIndex, &foret->racineUsines,
+                           cache->captageUsine[j], cache->captageVolume[j],
+                           cache->captagePourcentage[j]);
+        for (j = 0; j < cache->nbTroncons; j++)
+            nbIgnores += ajouterTroncon(reseau, &foret->racineIndex, cache->tronconAmont[j],
+                                        cache->tronconAval[j], cache->tronconPourcentage[j]);
+    } else {
+        if (ouvrirLecteur(&lecteur, fichierEntree) != 0) {
+            fprintf(stderr, "Erreur: impossible d'ouvrir %s\n", fichierEntree);
+            libererReseau(reseau);
+            return 1;
+        }
+
+        changerPhase(PHASE_ANALYSE);
+        while ((nbChamps = lireLigne(&lecteur, col)) >= 0) {
+            genre = classerLigne(col, nbChamps);
 
-            /* Chercher le parent dans l'AVL d'index */
-            parent = rechercherAVLIndex(racineIndex, col2);
-            
-            if (parent != NULL && strlen(col3) > 0 && strcmp(col3, "-") != 0) {
-                /* Creer le nouveau noeud enfant */
-                nouveau = creerArbre(col3, pourcentage);
-                
-                /* Ajouter comme enfant du parent (via liste chainee) */
-                ajouterEnfant(parent, nouveau);
-                
-                /* Ajouter au AVL d'index pour pouvoir le retrouver */
-                h = 0;
-                racineIndex = insererAVLIndex(racineIndex, col3, nouveau, &h);
+            /* Ligne d'usine: -;Usine;-;capacite;- */
+            if (genre == LIGNE_USINE) {
+                changerPhase(PHASE_CONSTRUCTION);
+                obtenirUsine(reseau, &foret->racineIndex, &foret->racineUsines,
+                             internerChamp(col[1]));
+            }
+            /* Ligne source -> usine: -;Source;Usine;volume;pourcentage */
+            else if (genre == LIGNE_CAPTAGE) {
+                double volume = champVersDouble(col[3]);
+                double fuite = champVersDouble(col[4]);
+                changerPhase(PHASE_CONSTRUCTION);
+                ajouterCaptage(reseau, &foret->racineIndex, &foret->racineUsines,
+                               internerChamp(col[2]), volume, fuite);
             }
+            /* Troncon de distribution: [usine|-];amont;aval;-;pourcentage */
+            else if (LIGNE_EST_TRONCON(genre)) {
+                if (champEstValeur(col[4])) {
+                    pourcentage = champVersDouble(col[4]);
+                } else {
+                    pourcentage = 0.0;
+                }
+                changerPhase(PHASE_CONSTRUCTION);
+                nbIgnores += ajouterTroncon(reseau, &foret->racineIndex, internerChamp(col[1]),
+                                            internerChamp(col[2]), pourcentage);
+            }
+            changerPhase(PHASE_ANALYSE);
         }
+
+        compterLignes(&lecteur);
+        fermerLecteur(&lecteur);
     }
 
-    fclose(fIn);
+    changerPhase(PHASE_CONSTRUCTION);
+    compacterReseau(reseau);
+    signalerIgnores(nbIgnores);
+    return 0;
+}
 
-    /* ========== Calculer les fuites ========== */
-    fuites_totales = calculerFuites(racineArbre, volume_initial);
+/*
+ * Traitement par lot: calcule les fuites de plusieurs usines
+ *
+ * Le fichier n'est lu qu'une seule fois: toute la foret de distribution
+ * est construite, puis les fuites de chaque usine sont calculees.
+ * fichierIds: une usine par ligne ("-" pour l'entree standard), ou NULL
+ * pour toutes les usines
+ */
+int traiterFuitesLot(char *fichierEntree, char *fichierSortie, char *fichierIds) {
+    FILE *fIds;
+    Sortie sortie;
+    char *ligne = NULL;
+    size_t capaciteLigne = 0;
+    size_t longueur;
+    Foret foret;
+    Reseau *reseau = &foret.reseau;
+    uint32_t usine;
+    Cache cache;
+    int avecCache;
+    ListeUsines liste;
+    size_t i;
+    int code;
 
-    /* Convertir en millions de m3 */
-    fuites_totales = fuites_totales / 1000.0f;
+    avecCache = (ouvrirCache(&cache, fichierEntree) == 0);
+    if (construireForet(fichierEntree, &cache, avecCache, &foret) != 0) {
+        fermerCache(&cache);
+        return 1;
+    }
 
-    /* Ecrire le resultat */
-    fOut = fopen(fichierSortie, "a");
-    if (fOut == NULL) {
+    /* ========== Calcul et ecriture des fuites ========== */
+    changerPhase(PHASE_ECRITURE);
+    if (ouvrirSortie(&sortie, fichierSortie, 1) != 0) {
         fprintf(stderr, "Erreur: impossible d'ouvrir %s\n", fichierSortie);
-        libererArbre(racineArbre);
-        libererAVLIndex(racineIndex);
+        libererReseau(reseau);
+        fermerCache(&cache);
         return 1;
     }
 
-    fprintf(fOut, "%s;%.6f\n", idUsine, fuites_totales);
-    fclose(fOut);
+    if (fichierIds == NULL) {
+        /* Toutes les usines, dans l'ordre alphabetique */
+        liste.nb = 0;
+        liste.identifiants = (uint32_t*)malloc(((size_t)reseau->nbIndex + 1) * sizeof(uint32_t));
+        if (liste.identifiants == NULL) {
+            fprintf(stderr, "Erreur: allocation memoire echouee\n");
+            exit(EXIT_FAILURE);
+        }
+        parcoursAVLIndex(reseau, foret.racineUsines, collecterUsine, &liste);
+        trierIdentifiants(liste.identifiants, liste.nb);
+        for (i = 0; i < liste.nb; i++) {
+            usine = rechercherAVLIndex(reseau, foret.racineUsines, liste.identifiants[i]);
+            ecrireFuitesUsine(reseau, usine, &sortie);
+        }
+        free(liste.identifiants);
+    } else {
+        /* "-": identifiants lus sur l'entree standard */
+        fIds = estCheminStandard(fichierIds) ? stdin : fopen(fichierIds, "r");
+        if (fIds == NULL) {
+            fprintf(stderr, "Erreur: impossible d'ouvrir %s\n", fichierIds);
+            fermerSortie(&sortie);
+            libererReseau(reseau);
+            fermerCache(&cache);
+            return 1;
+        }
+        /* getline: un identifiant n'a pas de longueur maximale */
+        while (getline(&ligne, &capaciteLigne, fIds) != -1) {
+            /* Retirer la fin de ligne */
+            longueur = strcspn(ligne, "\r\n");
+            ligne[longueur] = '\0';
+            if (longueur == 0)
+                continue;
 
-    /* Liberer la memoire */
-    libererArbre(racineArbre);
-    libererAVLIndex(racineIndex);
+            usine = rechercherAVLIndex(reseau, foret.racineUsines,
+                                       chercherIdentifiant(champDepuisChaine(ligne)));
+            if (usine == INDICE_NUL) {
+                ecrireChaine(&sortie, ligne);
+                ecrireChaine(&sortie, ";-1\n");
+            } else {
+                ecrireFuitesUsine(reseau, usine, &sortie);
+            }
+        }
+        free(ligne);
+        if (fIds != stdin)
+            fclose(fIds);
+    }
 
-    printf("Fuites calculees pour %s: %.6f M.m3\n", idUsine, fuites_totales);
+    code = 0;
+    if (fermerSortie(&sortie) != 0) {
+        fprintf(stderr, "Erreur: ecriture de %s impossible\n", fichierSortie);
+        code = 1;
+    }
+
+    noterReseau(reseau);
+    changerPhase(PHASE_LIBERATION);
+    libererReseau(reseau);
+    fermerCache(&cache);
+
+    if (code == 0)
+        fprintf(messages, "Fuites calculees par lot\n");
+    return code;
+}
+
+/* Taille en octets, suivie ou non de K, M ou G (puissances de 1024); 0 si invalide */
+static size_t lireTaille(const char *texte) {
+    char *fin;
+    unsigned long long valeur = strtoull(texte, &fin, 10);
+    int decalage = 0;
+
+    if (fin == texte || *texte < '0' || *texte > '9')
+        return 0;
+    if (*fin == 'K' || *fin == 'k')
+        decalage = 10;
+    else if (*fin == 'M' || *fin == 'm')
+        decalage = 20;
+    else if (*fin == 'G' || *fin == 'g')
+        decalage = 30;
+    if (decalage != 0)
+        fin++;
+    if (*fin != '\0' || valeur > (SIZE_MAX >> decalage))
+        return 0;
+    return (size_t)(valeur << decalage);
+}
+
+/* Numero d'un mode d'histogramme (1=max, 2=src, 3=real, 4=all), 0 si inconnu */
+static int lireMode(const char *texte) {
+    int mode;
+
+    for (mode = 1; mode <= NB_MODES; mode++) {
+        if (strcmp(texte, NOMS_MODES[mode]) == 0)
+            return mode;
+    }
     return 0;
 }
 
+/*
+ * Liste de modes separes par des virgules ("max,src,real,all")
+ * Remplit modes dans l'ordre donne; retourne leur nombre, 0 si un mode
+ * est inconnu ou repete.
+ */
+static int lireModes(const char *texte, int modes[NB_MODES]) {
+    char nom[8];
+    const char *fin;
+    size_t longueur;
+    int vus = 0;
+    int nb = 0;
+    int mode;
+
+    while (1) {
+        fin = strchr(texte, ',');
+        longueur = (fin != NULL) ? (size_t)(fin - texte) : strlen(texte);
+        if (longueur >= sizeof(nom))
+            return 0;
+        memcpy(nom, texte, longueur);
+        nom[longueur] = '\0';
+        mode = lireMode(nom);
+        if (mode == 0 || (vus & (1 << mode)) || nb == NB_MODES)
+            return 0;
+        vus |= 1 << mode;
+        modes[nb++] = mode;
+        if (fin == NULL)
+            return nb;
+        texte = fin + 1;
+    }
+}
+
+/* ========== Index du serveur ========== */
+
+/* Arbres interroges par rang: ordre alphabetique, et par valeur de chaque mode */
+typedef struct IndexServeur {
+    Usine *usines;             /* Usines par ordre alphabetique */
+    uint32_t nb;
+    ArbreRang alphabetique;
+    ArbreRang parValeur[NB_MODES + 1];      /* Indice: mode */
+    int construit[NB_MODES + 1];
+} IndexServeur;
+
+/* Construit l'arbre alphabetique des usines de l'histogramme */
+static void construireIndexServeur(IndexServeur *index, PoolAVL *pool, uint32_t racine) {
+    int mode;
+
+    index->nb = 0;
+    index->usines = (Usine*)malloc(((size_t)compterNoeuds(pool, racine) + 1) * sizeof(Usine));
+    if (index->usines == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+    listerUsinesAVL(pool, racine, index->usines, &index->nb);
+
+    construireArbreRang(&index->alphabetique, index->usines, index->nb, comparerUsinesAlphabetique);
+    for (mode = 1; mode <= NB_MODES; mode++)
+        index->construit[mode] = 0;
+}
+
+/* Arbre par valeur du mode, construit a la premiere demande */
+static const ArbreRang* arbreParValeur(IndexServeur *index, int mode) {
+    Usine *copie;
+
+    if (!index->construit[mode]) {
+        copie = (Usine*)malloc(((size_t)index->nb + 1) * sizeof(Usine));
+        if (copie == NULL) {
+            fprintf(stderr, "Erreur: allocation memoire echouee\n");
+            exit(EXIT_FAILURE);
+        }
+        memcpy(copie, index->usines, (size_t)index->nb * sizeof(Usine));
+        construireArbreRang(&index->parValeur[mode], copie, index->nb, COMPARATEURS_VALEUR[mode]);
+        index->construit[mode] = 1;
+        free(copie);
+    }
+    return &index->parValeur[mode];
+}
+
+static void libererIndexServeur(IndexServeur *index) {
+    int mode;
+
+    for (mode = 1; mode <= NB_MODES; mode++) {
+        if (index->construit[mode])
+            libererArbreRang(&index->parValeur[mode]);
+    }
+    libererArbreRang(&index->alphabetique);
+    free(index->usines);
+}
+
+/* Entier strictement positif (rang, nombre d'usines), 0 si invalide */
+static uint32_t lireRang(const char *texte) {
+    char *fin;
+    unsigned long valeur;
+
+    if (*texte < '0' || *texte > '9')
+        return 0;
+    valeur = strtoul(texte, &fin, 10);
+    if (*fin != '\0' || valeur > UINT32_MAX)
+        return 0;
+    return (uint32_t)valeur;
+}
+
+static void ecrireEntier(Sortie *sortie, long long valeur) {
+    char texte[24];
+
+    snprintf(texte, sizeof(texte), "%lld", valeur);
+    ecrireChaine(sortie, texte);
+}
+
+/* Capacite, volume capte et volume traite (M.m3), precedes de ';' */
+static void ecrireVolumes(Sortie *sortie, const Usine *volumes) {
+    ecrireCaractere(sortie, ';');
+    ecrireDecimal6(sortie, volumes->capacite_max / 1000.0);
+    ecrireCaractere(sortie, ';');
+    ecrireDecimal6(sortie, volumes->volume_capte / 1000.0);
+    ecrireCaractere(sortie, ';');
+    ecrireDecimal6(sortie, volumes->volume_traite / 1000.0);
+    ecrireCaractere(sortie, '\n');
+}
+
+/* rank <id_usine> */
+static void repondreRang(IndexServeur *index, const char *identifiant, Sortie *sortie) {
+    uint32_t rang = compterAvantRang(&index->alphabetique, identifiant, 0);
+    const Usine *usine = selectionnerRang(&index->alphabetique, rang);
+
+    ecrireChaine(sortie, identifiant);
+    ecrireCaractere(sortie, ';');
+    if (usine != NULL && strcmp(texteIdentifiant(usine->identifiant), identifiant) == 0)
+        ecrireEntier(sortie, (long long)rang + 1);
+    else
+        ecrireEntier(sortie, -1);
+    ecrireCaractere(sortie, '\n');
+}
+
+/* select <k> */
+static void repondreSelection(IndexServeur *index, uint32_t k, Sortie *sortie) {
+    const Usine *usine = selectionnerRang(&index->alphabetique, k - 1);
+
+    if (usine == NULL) {
+        ecrireChaine(sortie, "Erreur: rang hors limites\n");
+        return;
+    }
+    ecrireChaine(sortie, texteIdentifiant(usine->identifiant));
+    ecrireVolumes(sortie, usine);
+}
+
+/* sum <id_a>;<id_b> */
+static void repondreSomme(IndexServeur *index, const char *premier, const char *dernier,
+                          Sortie *sortie) {
+    uint32_t debut = compterAvantRang(&index->alphabetique, premier, 0);
+    uint32_t fin = compterAvantRang(&index->alphabetique, dernier, 1);
+    Usine somme;
+    uint32_t nb = sommeRangs(&index->alphabetique, debut, fin, &somme);
+
+    ecrireEntier(sortie, (long long)nb);
+    ecrireVolumes(sortie, &somme);
+}
+
+/* top <mode> <k>: rangs nb-1, nb-2, ... de l'arbre par valeur */
+static void repondreTop(IndexServeur *index, int mode, uint32_t k, Sortie *sortie) {
+    const ArbreRang *arbre = arbreParValeur(index, mode);
+    uint32_t i;
+
+    if (k > index->nb)
+        k = index->nb;
+    for (i = 0; i < k; i++)
+        ecrireUsine(sortie, selectionnerRang(arbre, index->nb - 1 - i), mode);
+}
+
+/*
+ * Mode serveur: le fichier est charge une seule fois (usines de
+ * l'histogramme et foret de distribution), puis les requetes sont lues
+ * sur l'entree standard, une par ligne:
+ *   histo <mode>       histogramme complet, comme le fichier de histo
+ *   leaks <id_usine>   <id_usine>;<fuites> (-1 si l'usine est inconnue)
+ *   rank <id_usine>    <id_usine>;<rang alphabetique a partir de 1> (-1 si inconnue)
+ *   select <k>         ligne complete de la k-ieme usine par ordre alphabetique
+ *   sum <id_a>;<id_b>  <nombre>;<capacite>;<capte>;<traite> des usines
+ *                      d'identifiant compris entre id_a et id_b (inclus)
+ *   top <mode> <k>     les k plus grandes usines du mode, de la plus grande
+ *                      a la plus petite (lignes de l'histogramme)
+ *   quit               fin du serveur (comme la fin de l'entree)
+ *
+ * Les requetes rank, select, sum et top interrogent des arbres a agregats
+ * de sous-arbre (ArbreRang, voir avl.h): O(log n) par requete (O(k log n) pour
+ * top), sans parcourir les usines. L'arbre alphabetique est construit au
+ * chargement, l'arbre par valeur d'un mode a sa premiere requete top.
+ * Les volumes sont en millions de m3, comme dans les histogrammes.
+ *
+ * Chaque reponse se termine par une ligne vide, et la sortie est videe
+ * apres chaque reponse: un script peut dialoguer avec le serveur par
+ * des tubes. Une requete invalide recoit une ligne "Erreur: ...".
+ * Les messages de chargement sont ecrits sur la sortie d'erreur.
+ */
+int traiterServeur(char *fichierEntree) {
+    OptionsHisto options = { 1, BACKEND_AVL, NULL, NULL, NULL, 0 };
+    char ligne[TAILLE_LIGNE];
+    char *argument;
+    size_t longueur;
+    Cache cache;
+    int avecCache;
+    PoolAVL pool;
+    uint32_t racine;
+    TableUsines table;
+    Foret foret;
+    Sortie sortie;
+    IndexServeur index;
+    char *suite;
+    uint32_t usine, k;
+    int mode, c;
+
+    initialiserPoolAVL(&pool);
+    initialiserTableUsines(&table);
+
+    /* ========== Chargement ========== */
+    avecCache = (ouvrirCache(&cache, fichierEntree) == 0);
+    if (agregerHistogramme(fichierEntree, &cache, avecCache, &options, &pool, &racine, &table) != 0) {
+        libererAVL(&pool);
+        libererTableUsines(&table);
+        fermerCache(&cache);
+        return 1;
+    }
+    if (construireForet(fichierEntree, &cache, avecCache, &foret) != 0) {
+        libererAVL(&pool);
+        libererTableUsines(&table);
+        fermerCache(&cache);
+        return 1;
+    }
+    construireIndexServeur(&index, &pool, racine);
+    fprintf(stderr, "Serveur pret: %d usines, %u noeuds de distribution\n",
+            compterNoeuds(&pool, racine),
+            (foret.reseau.nbNoeuds > 0) ? foret.reseau.nbNoeuds - 1 : 0);
+
+    /* ========== Requetes ========== */
+    sortieDepuisDescripteur(&sortie, STDOUT_FILENO);
+    while (fgets(ligne, TAILLE_LIGNE, stdin) != NULL) {
+        longueur = strcspn(ligne, "\r\n");
+        if (ligne[longueur] == '\0' && !feof(stdin)) {
+            /* Ligne tronquee: ignorer la suite */
+            while ((c = getchar()) != EOF && c != '\n')
+                ;
+            ecrireChaine(&sortie, "Erreur: requete trop longue\n\n");
+            viderSortie(&sortie);
+            continue;
+        }
+        ligne[longueur] = '\0';
+        if (longueur == 0)
+            continue;
+
+        argument = strchr(ligne, ' ');
+        if (argument != NULL)
+            *argument++ = '\0';
+
+        if (strcmp(ligne, "quit") == 0) {
+            break;
+        } else if (strcmp(ligne, "histo") == 0 && argument != NULL &&
+                   (mode = lireMode(argument)) != 0) {
+            changerPhase(PHASE_ECRITURE);
+            ecrireHistogramme(&sortie, mode, options.backend, &pool, racine, &table);
+        } else if (strcmp(ligne, "leaks") == 0 && argument != NULL) {
+            usine = rechercherAVLIndex(&foret.reseau, foret.racineUsines,
+                                       chercherIdentifiant(champDepuisChaine(argument)));
+            if (usine == INDICE_NUL) {
+                ecrireChaine(&sortie, argument);
+                ecrireChaine(&sortie, ";-1\n");
+            } else {
+                ecrireFuitesUsine(&foret.reseau, usine, &sortie);
+            }
+        } else if (strcmp(ligne, "rank") == 0 && argument != NULL) {
+            repondreRang(&index, argument, &sortie);
+        } else if (strcmp(ligne, "select") == 0 && argument != NULL &&
+                   (k = lireRang(argument)) != 0) {
+            repondreSelection(&index, k, &sortie);
+        } else if (strcmp(ligne, "sum") == 0 && argument != NULL &&
+                   (suite = strchr(argument, ';')) != NULL) {
+            *suite++ = '\0';
+            repondreSomme(&index, argument, suite, &sortie);
+        } else if (strcmp(ligne, "top") == 0 && argument != NULL &&
+                   (suite = strchr(argument, ' ')) != NULL &&
+                   (*suite++ = '\0', (mode = lireMode(argument)) != 0) &&
+                   (k = lireRang(suite)) != 0) {
+            repondreTop(&index, mode, k, &sortie);
+        } else {
+            ecrireChaine(&sortie, "Erreur: requete invalide (histo <max|src|real|all>, leaks <id_usine>, "
+                                  "rank <id_usine>, select <k>, sum <id_a>;<id_b>, "
+                                  "top <max|src|real|all> <k>, quit)\n");
+        }
+        ecrireCaractere(&sortie, '\n');
+        viderSortie(&sortie);
+    }
+    fermerSortie(&sortie);
+
+    noterReseau(&foret.reseau);
+    changerPhase(PHASE_LIBERATION);
+    libererAVL(&pool);
+    libererIndexServeur(&index);
+    libererTableUsines(&table);
+    libererReseau(&foret.reseau);
+    fermerCache(&cache);
+    return 0;
+}
+
+/*
+ * Libere la table des identifiants, partagee par tous les traitements,
+ * puis ecrit les mesures si --stats est actif
+ */
+static void terminer(const char *commande, int minChamps) {
+    changerPhase(PHASE_LIBERATION);
+    libererIdentifiants();
+    ecrireStatistiques(commande, minChamps);
+}
+
 /* Fonction principale */
 int main(int argc, char *argv[]) {
-    int mode;
+    int modes[NB_MODES];
+    char *fichiersSortie[NB_MODES];
+    int nbModes;
+    int nbThreads;
+    OptionsHisto options = { 1, BACKEND_AVL, NULL, NULL, NULL, 0 };
+    int minChamps = 3;
+    int code;
+    int i, j;
+
+    /* --stats est accepte a n'importe quelle position: on le retire */
+    for (i = 1, j = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stats") == 0)
+            activerStatistiques();
+        else
+            argv[j++] = argv[i];
+    }
+    argc = j;
+    argv[argc] = NULL;
+    messages = stdout;
+
+    /* index et serve ont besoin d'un fichier: le cache est range a cote,
+     * et serve lit ses requetes sur l'entree standard */
+    if (argc == 3 && (strcmp(argv[1], "index") == 0 || strcmp(argv[1], "serve") == 0) &&
+        estCheminStandard(argv[2])) {
+        fprintf(stderr, "Erreur: %s necessite un fichier, pas l'entree standard\n", argv[1]);
+        return 1;
+    }
+
+    /* Construction du cache binaire d'un fichier de donnees */
+    if (argc == 3 && strcmp(argv[1], "index") == 0) {
+        code = construireCache(argv[2]);
+        terminer(argv[1], minChamps);
+        return code;
+    }
+
+    /* Requetes sur l'entree standard, fichier charge une seule fois */
+    if (argc == 3 && strcmp(argv[1], "serve") == 0) {
+        code = traiterServeur(argv[2]);
+        terminer(argv[1], minChamps);
+        return code;
+    }
 
     if (argc < 5) {
         fprintf(stderr, "Usage:\n");
-        fprintf(stderr, "  %s histo <mode> <fichier_entree> <fichier_sortie>\n", argv[0]);
-        fprintf(stderr, "  %s leaks <id_usine> <fichier_entree> <fichier_sortie>\n", argv[0]);
-        fprintf(stderr, "Modes: max, src, real, all\n");
+        fprintf(stderr, "  %s histo <mode> <fichier_entree> <fichier_sortie> [-j N] [--backend=avl|hash]\n", argv[0]);
+        fprintf(stderr, "        [--petites <fichier>] [--grandes <fichier>] [--state <fichier>]\n");
+        fprintf(stderr, "        [--mem-limit <taille>[K|M|G]]\n");
+        fprintf(stderr, "  %s leaks <id_usine> <fichier_entree> <fichier_sortie> [-j N]\n", argv[0]);
+        fprintf(stderr, "  %s leaks --all <fichier_entree> <fichier_sortie>\n", argv[0]);
+        fprintf(stderr, "  %s leaks --ids <fichier_ids> <fichier_entree> <fichier_sortie>\n", argv[0]);
+        fprintf(stderr, "  %s leaks --detail <id_usine> <fichier_entree> <fichier_sortie>\n", argv[0]);
+        fprintf(stderr, "  %s index <fichier_entree>\n", argv[0]);
+        fprintf(stderr, "  %s serve <fichier_entree>\n", argv[0]);
+        fprintf(stderr, "Fichiers: \"-\" designe l'entree ou la sortie standard\n");
+        fprintf(stderr, "Option --stats: mesures (JSON) sur la sortie d'erreur\n");
+        fprintf(stderr, "Modes: max, src, real, all, ou une liste (max,src,real,all) et un repertoire\n");
+        fprintf(stderr, "       de sortie a la place de fichier_sortie (vol_<mode>.dat)\n");
         return 1;
     }
 
+    /* Resultats sur la sortie standard: les messages passent sur la sortie d'erreur */
+    if (estCheminStandard(((strcmp(argv[2], "--ids") == 0 || strcmp(argv[2], "--detail") == 0) &&
+                           argc >= 6) ? argv[5] : argv[4]))
+        messages = stderr;
+
     if (strcmp(argv[1], "histo") == 0) {
-        if (strcmp(argv[2], "max") == 0) mode = 1;
-        else if (strcmp(argv[2], "src") == 0) mode = 2;
-        else if (strcmp(argv[2], "real") == 0) mode = 3;
-        else if (strcmp(argv[2], "all") == 0) mode = 4;
-        else {
+        nbModes = lireModes(argv[2], modes);
+        if (nbModes == 0) {
             fprintf(stderr, "Erreur: mode inconnu '%s'\n", argv[2]);
             return 1;
         }
-        return traiterHistogramme(argv[3], argv[4], mode);
+        /* Options facultatives apres les arguments positionnels */
+        for (i = 5; i < argc; i++) {
+            if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+                options.nbThreads = atoi(argv[++i]);
+                if (options.nbThreads < 1) {
+                    fprintf(stderr, "Erreur: nombre de threads invalide '%s'\n", argv[i]);
+                    return 1;
+                }
+            } else if (strcmp(argv[i], "--backend=avl") == 0) {
+                options.backend = BACKEND_AVL;
+            } else if (strcmp(argv[i], "--backend=hash") == 0) {
+                options.backend = BACKEND_HASH;
+            } else if (strcmp(argv[i], "--petites") == 0 && i + 1 < argc) {
+                options.fichierPetites = argv[++i];
+            } else if (strcmp(argv[i], "--grandes") == 0 && i + 1 < argc) {
+                options.fichierGrandes = argv[++i];
+            } else if (strcmp(argv[i], "--state") == 0 && i + 1 < argc) {
+                options.fichierEtat = argv[++i];
+            } else if (strcmp(argv[i], "--mem-limit") == 0 && i + 1 < argc) {
+                options.limiteMemoire = lireTaille(argv[++i]);
+                if (options.limiteMemoire < LIMITE_MEMOIRE_MIN) {
+                    fprintf(stderr, "Erreur: limite memoire invalide '%s' (minimum 64K)\n", argv[i]);
+                    return 1;
+                }
+            } else {
+                fprintf(stderr, "Erreur: option inconnue '%s'\n", argv[i]);
+                return 1;
+            }
+        }
+        if (options.limiteMemoire > 0 &&
+            (options.fichierEtat != NULL || options.fichierPetites != NULL ||
+             options.fichierGrandes != NULL || options.nbThreads > 1)) {
+            fprintf(stderr, "Erreur: --mem-limit ne se combine pas avec -j, --state, --petites ou --grandes\n");
+            return 1;
+        }
+        if (options.fichierEtat != NULL && estCheminStandard(argv[3])) {
+            fprintf(stderr, "Erreur: --state necessite un fichier de donnees, pas l'entree standard\n");
+            return 1;
+        }
+        /* Plusieurs modes: argv[4] est un repertoire, un fichier vol_<mode>.dat
+         * par mode; les modeles des extremes recoivent le mode a la place de %s */
+        if (strchr(argv[2], ',') != NULL) {
+            if (estCheminStandard(argv[4])) {
+                fprintf(stderr, "Erreur: plusieurs modes necessitent un repertoire de sortie, pas \"-\"\n");
+                return 1;
+            }
+            if ((options.fichierPetites != NULL && strstr(options.fichierPetites, "%s") == NULL) ||
+                (options.fichierGrandes != NULL && strstr(options.fichierGrandes, "%s") == NULL)) {
+                fprintf(stderr, "Erreur: avec plusieurs modes, --petites et --grandes doivent contenir %%s\n");
+                return 1;
+            }
+            for (i = 0; i < nbModes; i++) {
+                fichiersSortie[i] = (char*)malloc(strlen(argv[4]) + sizeof("/vol_real.dat"));
+                if (fichiersSortie[i] == NULL) {
+                    fprintf(stderr, "Erreur: allocation memoire echouee pour un nom de fichier\n");
+                    exit(EXIT_FAILURE);
+                }
+                sprintf(fichiersSortie[i], "%s/vol_%s.dat", argv[4], NOMS_MODES[modes[i]]);
+            }
+        } else {
+            fichiersSortie[0] = argv[4];
+        }
+        minChamps = 2;
+        code = traiterHistogramme(argv[3], fichiersSortie, modes, nbModes, &options);
+        if (strchr(argv[2], ',') != NULL) {
+            for (i = 0; i < nbModes; i++)
+                free(fichiersSortie[i]);
+        }
     }
     else if (strcmp(argv[1], "leaks") == 0) {
-        return traiterFuites(argv[3], argv[4], argv[2]);
+        if (strcmp(argv[2], "--all") == 0) {
+            code = traiterFuitesLot(argv[3], argv[4], NULL);
+        } else if (strcmp(argv[2], "--ids") == 0) {
+            if (argc < 6) {
+                fprintf(stderr, "Erreur: --ids necessite <fichier_ids> <fichier_entree> <fichier_sortie>\n");
+                return 1;
+            }
+            if (estCheminStandard(argv[3]) && estCheminStandard(argv[4])) {
+                fprintf(stderr, "Erreur: identifiants et donnees ne peuvent pas venir tous deux de l'entree standard\n");
+                return 1;
+            }
+            code = traiterFuitesLot(argv[4], argv[5], argv[3]);
+        } else if (strcmp(argv[2], "--detail") == 0) {
+            if (argc < 6) {
+                fprintf(stderr, "Erreur: --detail necessite <id_usine> <fichier_entree> <fichier_sortie>\n");
+                return 1;
+            }
+            code = traiterFuites(argv[4], argv[5], argv[3], 1, 0);
+        } else {
+            /* -j N: parcours de l'arbre de l'usine sur N threads */
+            nbThreads = 0;
+            if (argc == 7 && strcmp(argv[5], "-j") == 0) {
+                nbThreads = atoi(argv[6]);
+                if (nbThreads < 1) {
+                    fprintf(stderr, "Erreur: nombre de threads invalide '%s'\n", argv[6]);
+                    return 1;
+                }
+            } else if (argc > 5) {
+                fprintf(stderr, "Erreur: option inconnue '%s'\n", argv[5]);
+                return 1;
+            }
+            code = traiterFuites(argv[3], argv[4], argv[2], 0, nbThreads);
+        }
     }
     else {
         fprintf(stderr, "Erreur: commande inconnue '%s'\n", argv[1]);
         return 1;
     }
+
+    terminer(argv[1], minChamps);
+    return code;
 }
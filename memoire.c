@@ -0,0 +1,89 @@
+/*
+ * memoire.c - Pools de noeuds et arene d'identifiants
+ * Projet C-Wildwater
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "memoire.h"
+
+#define TAILLE_BLOC_ARENE (1 << 20)
+#define CAPACITE_POOL_INITIALE 1024
+
+/* ========== Arene ========== */
+
+/* Initialise une arene vide */
+void initialiserArene(Arene *arene) {
+    arene->bloc = NULL;
+}
+
+/*
+ * Copie une chaine (non terminee) dans l'arene et ajoute le '\0'
+ * Un nouveau bloc est ouvert quand le bloc courant est plein.
+ */
+char* copierDansArene(Arene *arene, const char *debut, size_t longueur) {
+    BlocArene *bloc = arene->bloc;
+    char *copie;
+
+    if (bloc == NULL || bloc->utilise + longueur + 1 > bloc->taille) {
+        size_t taille = TAILLE_BLOC_ARENE;
+        if (longueur + 1 > taille)
+            taille = longueur + 1;
+        bloc = (BlocArene*)malloc(sizeof(BlocArene) + taille);
+        if (bloc == NULL) {
+            fprintf(stderr, "Erreur: allocation memoire echouee\n");
+            exit(EXIT_FAILURE);
+        }
+        bloc->suivant = arene->bloc;
+        bloc->utilise = 0;
+        bloc->taille = taille;
+        arene->bloc = bloc;
+    }
+
+    copie = bloc->donnees + bloc->utilise;
+    memcpy(copie, debut, longueur);
+    copie[longueur] = '\0';
+    bloc->utilise += longueur + 1;
+    return copie;
+}
+
+/* Libere tous les blocs de l'arene */
+void libererArene(Arene *arene) {
+    BlocArene *bloc = arene->bloc;
+    BlocArene *suivant;
+
+    while (bloc != NULL) {
+        suivant = bloc->suivant;
+        free(bloc);
+        bloc = suivant;
+    }
+    arene->bloc = NULL;
+}
+
+/* ========== Pools ========== */
+
+/* Reserve un element dans un pool; l'element 0 est reserve (INDICE_NUL) */
+uint32_t reserverElement(void **tableau, uint32_t *nb, uint32_t *capacite, size_t tailleElement) {
+    if (*nb == 0)
+        *nb = 1;
+
+    if (*nb >= *capacite) {
+        uint32_t nouvelleCapacite = (*capacite == 0) ? CAPACITE_POOL_INITIALE : *capacite * 2;
+        void *agrandi;
+
+        if (nouvelleCapacite <= *capacite) {
+            fprintf(stderr, "Erreur: nombre maximal de noeuds atteint\n");
+            exit(EXIT_FAILURE);
+        }
+        agrandi = realloc(*tableau, (size_t)nouvelleCapacite * tailleElement);
+        if (agrandi == NULL) {
+            fprintf(stderr, "Erreur: allocation memoire echouee\n");
+            exit(EXIT_FAILURE);
+        }
+        *tableau = agrandi;
+        *capacite = nouvelleCapacite;
+    }
+
+    return (*nb)++;
+}
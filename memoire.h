@@ -0,0 +1,49 @@
+/*
+ * memoire.h - En-tete pour l'allocation des noeuds et des identifiants
+ * Projet C-Wildwater
+ *
+ * Les noeuds des arbres ne sont plus alloues un par un: ils sont ranges
+ * dans des tableaux contigus (pools) et designes par un indice 32 bits.
+ * L'indice 0 est reserve et joue le role du pointeur NULL.
+ *
+ * Les identifiants sont copies dans une arene: une suite de gros blocs
+ * ou les chaines sont placees les unes a la suite des autres. Les
+ * adresses des chaines restent stables et la liberation se fait bloc
+ * par bloc, sans parcourir les arbres.
+ */
+
+#ifndef MEMOIRE_H
+#define MEMOIRE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Indice d'un noeud dans un pool (0 = aucun noeud) */
+#define INDICE_NUL 0
+
+/* Bloc d'une arene */
+typedef struct BlocArene {
+    struct BlocArene *suivant; /* Bloc precedemment rempli */
+    size_t utilise;            /* Octets deja attribues */
+    size_t taille;             /* Capacite du bloc */
+    char donnees[];
+} BlocArene;
+
+/* Arene de chaines de caracteres */
+typedef struct Arene {
+    BlocArene *bloc;           /* Bloc en cours de remplissage */
+} Arene;
+
+/* Arene */
+void initialiserArene(Arene *arene);
+char* copierDansArene(Arene *arene, const char *debut, size_t longueur);
+void libererArene(Arene *arene);
+
+/*
+ * Reserve un element de plus dans un pool
+ * tableau: adresse du tableau, nb: elements utilises, capacite: elements alloues
+ * Retourne l'indice du nouvel element (le tableau peut etre deplace).
+ */
+uint32_t reserverElement(void **tableau, uint32_t *nb, uint32_t *capacite, size_t tailleElement);
+
+#endif
@@ -0,0 +1,646 @@
+/*
+ * parallele.c - Ingestion multi-thread de l'histogramme
+ * Projet C-Wildwater
+ *
+ * Deux phases, chacune repartie sur nbThreads threads:
+ *
+ * 1. Analyse: le thread i decoupe la tranche i du fichier et range les
+ *    lignes utiles dans un tableau d'enregistrements (sans copie des
+ *    identifiants, qui pointent dans la projection).
+ *
+ * Entre les deux phases, le thread principal enregistre les cles dans
+ * la table des identifiants (qui n'est pas partagee entre threads) et,
+ * dans le meme passage, range chaque enregistrement dans la partition
+ * numero d'identifiant modulo nbThreads. Cette section est sequentielle:
+ * c'est elle qui limite le gain quand nbThreads augmente.
+ *
+ * 2. Agregation: le thread i insere dans son propre AVL (ou sa propre
+ *    table des usines) les seuls enregistrements de la partition i,
+ *    dans l'ordre du fichier. Le travail total reste O(n), quel que
+ *    soit le nombre de threads.
+ *
+ * Chaque usine est donc cumulee par un seul thread et dans l'ordre du
+ * fichier: les sommes flottantes sont exactement celles du traitement
+ * sequentiel. Les AVL obtenus ont des cles disjointes: leurs usines sont
+ * reunies et l'AVL final est reconstruit en bloc avec reconstruireAVL
+ * (fusionnerTableUsines pour les tables).
+ *
+ * Calcul des fuites (calculerFuitesParallele): chaque thread parcourt en
+ * profondeur les sous-arbres qu'il detient, sur sa propre pile. Quand sa
+ * pile depasse SEUIL_PARTAGE etapes et que sa file partagee est vide, il
+ * y publie la moitie la plus proche de la racine: les plus gros
+ * sous-arbres. Un thread sans travail prend la moitie de sa file, ou
+ * vole celle d'un autre thread. La perte du troncon qui mene a chaque
+ * noeud est rangee dans un tableau par noeud; le total est reduit par
+ * blocs fixes de TAILLE_BLOC_REDUCTION noeuds, additionnes dans l'ordre
+ * des blocs. Le decoupage ne depend pas du nombre de threads: le total
+ * est le meme, au bit pres, quel que soit ce nombre.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "identifiants.h"
+#include "statistiques.h"
+#include "parallele.h"
+
+#define CAPACITE_INITIALE 4096
+
+/* Calcul parallele des fuites */
+#define SEUIL_PARTAGE 256              /* Etapes privees au-dela desquelles on en publie */
+#define TAILLE_BLOC_REDUCTION 4096     /* Noeuds par somme partielle */
+
+/* Ligne utile de l'histogramme, en attente d'agregation */
+typedef struct Enregistrement {
+    const char *cle;           /* Identifiant de l'usine (dans la projection) */
+    uint32_t longueur;         /* Longueur de l'identifiant */
+    double capacite_max;
+    double volume_capte;
+    double volume_traite;
+} Enregistrement;
+
+/* Tranche du fichier et enregistrements extraits par la phase 1 */
+typedef struct Tranche {
+    Lecteur lecteur;           /* Vue sur la tranche (non possedee) */
+    AnalyseurLigne analyser;
+    Enregistrement *enregistrements;
+    size_t nb;
+    size_t capacite;
+} Tranche;
+
+/* Enregistrements dont le numero d'identifiant vaut i modulo nbThreads */
+typedef struct Partition {
+    Usine *usines;             /* Dans l'ordre du fichier */
+    size_t nb;
+    size_t capacite;
+} Partition;
+
+/* Travail d'un thread pour la phase 2 */
+typedef struct Agregation {
+    const Partition *partition; /* Partition des cles traitee par ce thread */
+    int hachage;               /* 1: table des usines, 0: AVL */
+    PoolAVL pool;              /* Pool propre au thread: aucun verrou */
+    uint32_t racine;
+    TableUsines table;         /* Table propre au thread */
+} Agregation;
+
+/* Ajoute un enregistrement a la tranche, en agrandissant le tableau si besoin */
+static void ajouterEnregistrement(Tranche *tranche, Champ cle, Usine *usine) {
+    Enregistrement *e;
+
+    if (tranche->nb == tranche->capacite) {
+        size_t capacite = (tranche->capacite == 0) ? CAPACITE_INITIALE : tranche->capacite * 2;
+        Enregistrement *agrandi = (Enregistrement*)realloc(tranche->enregistrements,
+                                                           capacite * sizeof(Enregistrement));
+        if (agrandi == NULL) {
+            fprintf(stderr, "Erreur: allocation memoire echouee\n");
+            exit(EXIT_FAILURE);
+        }
+        tranche->enregistrements = agrandi;
+        tranche->capacite = capacite;
+    }
+
+    e = &tranche->enregistrements[tranche->nb++];
+    e->cle = cle.debut;
+    e->longueur = (uint32_t)cle.longueur;
+    e->capacite_max = usine->capacite_max;
+    e->volume_capte = usine->volume_capte;
+    e->volume_traite = usine->volume_traite;
+}
+
+/* Ajoute une usine a la partition, en agrandissant le tableau si besoin */
+static void ajouterAPartition(Partition *partition, const Usine *usine) {
+    if (partition->nb == partition->capacite) {
+        size_t capacite = (partition->capacite == 0) ? CAPACITE_INITIALE : partition->capacite * 2;
+        Usine *agrandi = (Usine*)realloc(partition->usines, capacite * sizeof(Usine));
+        if (agrandi == NULL) {
+            fprintf(stderr, "Erreur: allocation memoire echouee\n");
+            exit(EXIT_FAILURE);
+        }
+        partition->usines = agrandi;
+        partition->capacite = capacite;
+    }
+    partition->usines[partition->nb++] = *usine;
+}
+
+/* Phase 1: analyse des lignes d'une tranche */
+static void* analyserTranche(void *argument) {
+    Tranche *tranche = (Tranche*)argument;
+    Champ col[NB_COLONNES];
+    Champ cle;
+    Usine usine;
+    int nbChamps;
+
+    while ((nbChamps = lireLigne(&tranche->lecteur, col)) >= 0) {
+        if (tranche->analyser(col, nbChamps, &cle, &usine))
+            ajouterEnregistrement(tranche, cle, &usine);
+    }
+    return NULL;
+}
+
+/* Phase 2: agregation des enregistrements de la partition du thread */
+static void* agregerPartition(void *argument) {
+    Agregation *agregation = (Agregation*)argument;
+    const Partition *partition = agregation->partition;
+    ChargementAVL chargement;
+    size_t j;
+
+    commencerChargementAVL(&agregation->pool, &chargement);
+    for (j = 0; j < partition->nb; j++) {
+        if (agregation->hachage) {
+            ajouterUsine(&agregation->table, partition->usines[j]);
+        } else {
+            chargerUsineAVL(&agregation->pool, &chargement, partition->usines[j]);
+        }
+    }
+    agregation->racine = terminerChargementAVL(&agregation->pool, &chargement);
+    return NULL;
+}
+
+/*
+ * Lance fonction(arguments[i]) sur n threads et attend leur fin
+ * Un thread qui ne peut pas etre cree est une erreur fatale (comme pour
+ * la decompression): les travailleurs du calcul des fuites attendent
+ * que tous les n threads soient inactifs, et un travail fait sur place
+ * les bloquerait.
+ */
+static void executerEnParallele(void *(*fonction)(void *), void *arguments,
+                                size_t tailleArgument, int n) {
+    pthread_t *threads = (pthread_t*)malloc((size_t)n * sizeof(pthread_t));
+    int i;
+
+    if (threads == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < n; i++) {
+        void *argument = (char*)arguments + (size_t)i * tailleArgument;
+        if (pthread_create(&threads[i], NULL, fonction, argument) != 0) {
+            fprintf(stderr, "Erreur: creation des threads de calcul impossible\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (i = 0; i < n; i++)
+        pthread_join(threads[i], NULL);
+
+    free(threads);
+}
+
+/*
+ * Phase 1, attribution des numeros d'identifiant et repartition
+ * Retourne les nbThreads partitions (a liberer par libererPartitions)
+ */
+static Partition* analyserEnParallele(Lecteur *lecteur, int nbThreads, AnalyseurLigne analyser) {
+    Tranche *tranches;
+    Partition *partitions;
+    size_t debut = 0, fin;
+    const char *saut;
+    Enregistrement *e;
+    Champ cle;
+    Usine usine;
+    size_t j;
+    int i;
+
+    tranches = (Tranche*)calloc((size_t)nbThreads, sizeof(Tranche));
+    partitions = (Partition*)calloc((size_t)nbThreads, sizeof(Partition));
+    if (tranches == NULL || partitions == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* Decoupage en tranches qui commencent toutes en debut de ligne */
+    for (i = 0; i < nbThreads; i++) {
+        if (i == nbThreads - 1) {
+            fin = lecteur->taille;
+        } else {
+            /* Avancer la borne jusqu'apres la fin de ligne suivante */
+            fin = lecteur->taille / (size_t)nbThreads * (size_t)(i + 1);
+            if (fin < debut)
+                fin = debut;
+            saut = NULL;
+            if (fin < lecteur->taille)
+                saut = (const char*)memchr(lecteur->donnees + fin, '\n', lecteur->taille - fin);
+            fin = (saut == NULL) ? lecteur->taille : (size_t)(saut - lecteur->donnees) + 1;
+        }
+
+        tranches[i].lecteur.donnees = lecteur->donnees + debut;
+        tranches[i].lecteur.taille = fin - debut;
+        tranches[i].lecteur.position = 0;
+        tranches[i].lecteur.mappe = 0;
+        tranches[i].analyser = analyser;
+        debut = fin;
+    }
+
+    /* Phase 1: analyse des tranches */
+    changerPhase(PHASE_ANALYSE);
+    executerEnParallele(analyserTranche, tranches, sizeof(Tranche), nbThreads);
+    for (i = 0; i < nbThreads; i++)
+        for (j = 0; j <= NB_COLONNES; j++)
+            lecteur->nbLignes[j] += tranches[i].lecteur.nbLignes[j];
+    changerPhase(PHASE_CONSTRUCTION);
+
+    /*
+     * Attribution des numeros d'identifiant dans l'ordre du fichier, et
+     * repartition par numero: chaque thread de la phase 2 ne voit que
+     * ses enregistrements
+     */
+    for (i = 0; i < nbThreads; i++) {
+        for (j = 0; j < tranches[i].nb; j++) {
+            e = &tranches[i].enregistrements[j];
+            cle.debut = e->cle;
+            cle.longueur = e->longueur;
+            usine.identifiant = internerChamp(cle);
+            usine.capacite_max = e->capacite_max;
+            usine.volume_capte = e->volume_capte;
+            usine.volume_traite = e->volume_traite;
+            ajouterAPartition(&partitions[usine.identifiant % (uint32_t)nbThreads], &usine);
+        }
+        free(tranches[i].enregistrements);
+    }
+    free(tranches);
+
+    return partitions;
+}
+
+/* Libere les partitions */
+static void libererPartitions(Partition *partitions, int nbThreads) {
+    int i;
+
+    for (i = 0; i < nbThreads; i++)
+        free(partitions[i].usines);
+    free(partitions);
+}
+
+/* Phase 2: prepare et lance l'agregation par partition de cles */
+static Agregation* agregerEnParallele(const Partition *partitions, int nbThreads, int hachage) {
+    Agregation *agregations;
+    int i;
+
+    agregations = (Agregation*)calloc((size_t)nbThreads, sizeof(Agregation));
+    if (agregations == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < nbThreads; i++) {
+        agregations[i].partition = &partitions[i];
+        agregations[i].hachage = hachage;
+        initialiserPoolAVL(&agregations[i].pool);
+        agregations[i].racine = INDICE_NUL;
+        initialiserTableUsines(&agregations[i].table);
+    }
+    executerEnParallele(agregerPartition, agregations, sizeof(Agregation), nbThreads);
+
+    return agregations;
+}
+
+/*
+ * Construit l'AVL des usines en repartissant le travail sur nbThreads threads
+ * Le lecteur doit etre ouvert; il n'est pas ferme par cette fonction.
+ * pool: pool (vide) qui recoit l'AVL final; retourne l'indice de sa racine
+ */
+uint32_t construireAVLParallele(Lecteur *lecteur, int nbThreads, AnalyseurLigne analyser,
+                                PoolAVL *pool) {
+    Partition *partitions = analyserEnParallele(lecteur, nbThreads, analyser);
+    Agregation *agregations = agregerEnParallele(partitions, nbThreads, 0);
+    uint32_t racine;
+    Usine *usines;
+    size_t total = 0;
+    uint32_t nb = 0;
+    int i;
+
+    /* Reunion des usines des threads (cles disjointes), puis construction en bloc */
+    for (i = 0; i < nbThreads; i++)
+        total += (size_t)compterNoeuds(&agregations[i].pool, agregations[i].racine);
+    usines = (Usine*)malloc((total > 0 ? total : 1) * sizeof(Usine));
+    if (usines == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < nbThreads; i++) {
+        listerUsinesAVL(&agregations[i].pool, agregations[i].racine, usines, &nb);
+        pool->nbRotations += agregations[i].pool.nbRotations;
+        libererAVL(&agregations[i].pool);
+    }
+    racine = reconstruireAVL(pool, usines, nb);
+    free(usines);
+
+    libererPartitions(partitions, nbThreads);
+    free(agregations);
+
+    return racine;
+}
+
+/*
+ * Construit la table des usines en repartissant le travail sur nbThreads threads
+ * table: table (vide) qui recoit toutes les usines
+ */
+void construireTableParallele(Lecteur *lecteur, int nbThreads, AnalyseurLigne analyser,
+                              TableUsines *table) {
+    Partition *partitions = analyserEnParallele(lecteur, nbThreads, analyser);
+    Agregation *agregations = agregerEnParallele(partitions, nbThreads, 1);
+    int i;
+
+    /* Fusion des tables des threads (cles disjointes) */
+    for (i = 0; i < nbThreads; i++) {
+        fusionnerTableUsines(table, &agregations[i].table);
+        libererTableUsines(&agregations[i].table);
+    }
+
+    libererPartitions(partitions, nbThreads);
+    free(agregations);
+}
+
+/* ========== Calcul parallele des fuites ========== */
+
+/* File partagee d'un thread: etapes publiees, que tout thread peut prendre */
+typedef struct FileEtapes {
+    pthread_mutex_t verrou;
+    EtapeFuite *etapes;
+    size_t nb;                 /* Lu sans verrou (__atomic) pour eviter des publications inutiles */
+    size_t capacite;
+} FileEtapes;
+
+/* Etat commun aux threads d'un calcul */
+typedef struct ParcoursFuites {
+    Reseau *reseau;
+    uint32_t passage;          /* Marque des noeuds atteints par ce calcul */
+    double *pertes;            /* Perte du troncon qui mene a chaque noeud */
+    double *partiels;          /* Somme partielle de chaque bloc de noeuds */
+    uint32_t nbBlocs;
+    FileEtapes *files;         /* Une file par thread */
+    int nbThreads;
+    size_t enAttente;          /* Etapes dans les files (__atomic) */
+    pthread_mutex_t verrou;    /* Protege nbInactifs et termine */
+    pthread_cond_t travail;    /* Des etapes ont ete publiees, ou le calcul est termine */
+    int nbInactifs;
+    int termine;
+} ParcoursFuites;
+
+/* Travail d'un thread */
+typedef struct Explorateur {
+    ParcoursFuites *parcours;
+    int numero;
+    EtapeFuite *pile;          /* Pile privee */
+    size_t nb;
+    size_t capacite;
+    uint32_t nbRevisites;
+    uint32_t profondeurMax;
+} Explorateur;
+
+/* Agrandit un tableau d'etapes pour en contenir au moins minimum */
+static EtapeFuite* agrandirEtapes(EtapeFuite *etapes, size_t *capacite, size_t minimum) {
+    size_t nouvelle = (*capacite == 0) ? CAPACITE_INITIALE : *capacite;
+    EtapeFuite *agrandi;
+
+    if (minimum <= *capacite)
+        return etapes;
+    while (nouvelle < minimum)
+        nouvelle *= 2;
+    agrandi = (EtapeFuite*)realloc(etapes, nouvelle * sizeof(EtapeFuite));
+    if (agrandi == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+    *capacite = nouvelle;
+    return agrandi;
+}
+
+/* Empile une etape sur la pile privee */
+static void empilerEtape(Explorateur *e, uint32_t noeud, uint32_t profondeur, double volume) {
+    if (e->nb == e->capacite)
+        e->pile = agrandirEtapes(e->pile, &e->capacite, e->nb + 1);
+    e->pile[e->nb].noeud = noeud;
+    e->pile[e->nb].profondeur = profondeur;
+    e->pile[e->nb].volume = volume;
+    e->nb++;
+}
+
+/* Reveille les threads inactifs: des etapes ont ete publiees */
+static void signalerTravail(ParcoursFuites *p) {
+    pthread_mutex_lock(&p->verrou);
+    if (p->nbInactifs > 0)
+        pthread_cond_broadcast(&p->travail);
+    pthread_mutex_unlock(&p->verrou);
+}
+
+/* Publie la moitie basse de la pile privee (les plus gros sous-arbres) */
+static void publierEtapes(Explorateur *e) {
+    ParcoursFuites *p = e->parcours;
+    FileEtapes *file = &p->files[e->numero];
+    size_t moitie = e->nb / 2;
+
+    pthread_mutex_lock(&file->verrou);
+    file->etapes = agrandirEtapes(file->etapes, &file->capacite, file->nb + moitie);
+    memcpy(file->etapes + file->nb, e->pile, moitie * sizeof(EtapeFuite));
+    __atomic_store_n(&file->nb, file->nb + moitie, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&p->enAttente, moitie, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&file->verrou);
+
+    memmove(e->pile, e->pile + moitie, (e->nb - moitie) * sizeof(EtapeFuite));
+    e->nb -= moitie;
+    signalerTravail(p);
+}
+
+/* Prend la moitie d'une file non vide (la sienne d'abord); retourne 0 si toutes sont vides */
+static int prendreEtapes(Explorateur *e) {
+    ParcoursFuites *p = e->parcours;
+    FileEtapes *file;
+    size_t pris;
+    int v;
+
+    for (v = 0; v < p->nbThreads; v++) {
+        file = &p->files[(e->numero + v) % p->nbThreads];
+        if (__atomic_load_n(&file->nb, __ATOMIC_RELAXED) == 0)
+            continue;
+        pthread_mutex_lock(&file->verrou);
+        pris = (file->nb + 1) / 2;
+        if (pris > 0) {
+            e->pile = agrandirEtapes(e->pile, &e->capacite, e->nb + pris);
+            memcpy(e->pile + e->nb, file->etapes + file->nb - pris, pris * sizeof(EtapeFuite));
+            e->nb += pris;
+            __atomic_store_n(&file->nb, file->nb - pris, __ATOMIC_RELAXED);
+            __atomic_sub_fetch(&p->enAttente, pris, __ATOMIC_SEQ_CST);
+        }
+        pthread_mutex_unlock(&file->verrou);
+        if (pris > 0)
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Attend que des etapes soient publiees
+ * Retourne 0 quand le calcul est termine: tous les threads sont inactifs
+ * et toutes les files sont vides.
+ */
+static int attendreTravail(ParcoursFuites *p) {
+    int suite = 1;
+
+    pthread_mutex_lock(&p->verrou);
+    p->nbInactifs++;
+    for (;;) {
+        if (p->termine) {
+            suite = 0;
+            break;
+        }
+        if (__atomic_load_n(&p->enAttente, __ATOMIC_SEQ_CST) > 0) {
+            p->nbInactifs--;
+            break;
+        }
+        if (p->nbInactifs == p->nbThreads) {
+            p->termine = 1;
+            pthread_cond_broadcast(&p->travail);
+            suite = 0;
+            break;
+        }
+        pthread_cond_wait(&p->travail, &p->verrou);
+    }
+    pthread_mutex_unlock(&p->verrou);
+    return suite;
+}
+
+/*
+ * Parcours d'un thread
+ * Un noeud n'a qu'un parent (voir ajouterTroncon dans main.c): chaque
+ * noeud est atteint par un seul thread, qui ecrit seul sa perte et sa
+ * marque. Seul le noeud de depart, marque avant le lancement, peut etre
+ * atteint une seconde fois, par le troncon unique qui y revient.
+ */
+static void* explorerFuites(void *argument) {
+    Explorateur *e = (Explorateur*)argument;
+    ParcoursFuites *p = e->parcours;
+    const uint32_t *debutEnfants = p->reseau->debutEnfants;
+    const uint32_t *enfants = p->reseau->enfants;
+    const double *pourcentages = p->reseau->pourcentages;
+    uint32_t *passages = p->reseau->passages;
+    FileEtapes *file = &p->files[e->numero];
+    uint32_t enfant, k, debut, fin;
+    double part, perte;
+    EtapeFuite etape;
+
+    do {
+        while (e->nb > 0) {
+            etape = e->pile[--e->nb];
+            if (etape.profondeur > e->profondeurMax)
+                e->profondeurMax = etape.profondeur;
+
+            debut = debutEnfants[etape.noeud];
+            fin = debutEnfants[etape.noeud + 1];
+            if (debut == fin)
+                continue;
+
+            /* Repartition equitable du volume entre les enfants */
+            part = etape.volume / (double)(fin - debut);
+
+            for (k = debut; k < fin; k++) {
+                enfant = enfants[k];
+                perte = part * pourcentages[k] / 100.0;
+                p->pertes[enfant] += perte;
+
+                if (passages[enfant] == p->passage) {
+                    e->nbRevisites++;
+                    continue;
+                }
+                passages[enfant] = p->passage;
+                empilerEtape(e, enfant, etape.profondeur + 1, part - perte);
+            }
+
+            if (e->nb > SEUIL_PARTAGE && __atomic_load_n(&file->nb, __ATOMIC_RELAXED) == 0)
+                publierEtapes(e);
+        }
+    } while (prendreEtapes(e) || attendreTravail(p));
+
+    return NULL;
+}
+
+/* Sommes partielles des blocs numero, numero + nbThreads, ... */
+static void* reduireBlocs(void *argument) {
+    Explorateur *e = (Explorateur*)argument;
+    ParcoursFuites *p = e->parcours;
+    const uint32_t *passages = p->reseau->passages;
+    uint32_t nbNoeuds = p->reseau->nbNoeuds;
+    uint32_t b, i, debut, fin;
+    double somme;
+
+    for (b = (uint32_t)e->numero; b < p->nbBlocs; b += (uint32_t)p->nbThreads) {
+        debut = b * TAILLE_BLOC_REDUCTION;
+        fin = (nbNoeuds - debut < TAILLE_BLOC_REDUCTION) ? nbNoeuds : debut + TAILLE_BLOC_REDUCTION;
+        somme = 0.0;
+        for (i = debut; i < fin; i++) {
+            if (passages[i] == p->passage)
+                somme += p->pertes[i];
+        }
+        p->partiels[b] = somme;
+    }
+    return NULL;
+}
+
+/*
+ * Calcule les fuites en aval d'un noeud sur nbThreads threads
+ * Meme resultat que calculerFuites aux arrondis pres, mais identique
+ * quel que soit nbThreads. La reduction parcourt tous les noeuds du
+ * reseau: a reserver a un reseau construit pour une seule usine.
+ */
+double calculerFuitesParallele(Reseau *reseau, uint32_t noeud, double volume, int nbThreads) {
+    ParcoursFuites p;
+    Explorateur *explorateurs;
+    double total = 0.0;
+    uint32_t b;
+    int i;
+
+    reseau->nbRevisites = 0;
+    if (noeud == INDICE_NUL)
+        return 0.0;
+
+    memset(&p, 0, sizeof(ParcoursFuites));
+    p.reseau = reseau;
+    p.passage = ++reseau->passage;
+    p.nbThreads = nbThreads;
+    p.nbBlocs = (reseau->nbNoeuds + TAILLE_BLOC_REDUCTION - 1) / TAILLE_BLOC_REDUCTION;
+    p.pertes = (double*)calloc((size_t)reseau->nbNoeuds + 1, sizeof(double));
+    p.partiels = (double*)calloc((size_t)p.nbBlocs + 1, sizeof(double));
+    p.files = (FileEtapes*)calloc((size_t)nbThreads, sizeof(FileEtapes));
+    explorateurs = (Explorateur*)calloc((size_t)nbThreads, sizeof(Explorateur));
+    if (p.pertes == NULL || p.partiels == NULL || p.files == NULL || explorateurs == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_init(&p.verrou, NULL);
+    pthread_cond_init(&p.travail, NULL);
+    for (i = 0; i < nbThreads; i++) {
+        pthread_mutex_init(&p.files[i].verrou, NULL);
+        explorateurs[i].parcours = &p;
+        explorateurs[i].numero = i;
+    }
+
+    /* Le premier thread part du noeud de depart */
+    reseau->passages[noeud] = p.passage;
+    empilerEtape(&explorateurs[0], noeud, 0, volume);
+    executerEnParallele(explorerFuites, explorateurs, sizeof(Explorateur), nbThreads);
+
+    /* Reduction dans l'ordre des blocs */
+    executerEnParallele(reduireBlocs, explorateurs, sizeof(Explorateur), nbThreads);
+    for (b = 0; b < p.nbBlocs; b++)
+        total += p.partiels[b];
+
+    for (i = 0; i < nbThreads; i++) {
+        reseau->nbRevisites += explorateurs[i].nbRevisites;
+        if (explorateurs[i].profondeurMax > reseau->profondeurMax)
+            reseau->profondeurMax = explorateurs[i].profondeurMax;
+        free(explorateurs[i].pile);
+        free(p.files[i].etapes);
+        pthread_mutex_destroy(&p.files[i].verrou);
+    }
+    pthread_mutex_destroy(&p.verrou);
+    pthread_cond_destroy(&p.travail);
+    free(explorateurs);
+    free(p.files);
+    free(p.partiels);
+    free(p.pertes);
+    return total;
+}
@@ -0,0 +1,37 @@
+/*
+ * parallele.h - En-tete pour l'ingestion multi-thread de l'histogramme
+ * Projet C-Wildwater
+ *
+ * Le fichier projete est decoupe en tranches alignees sur les fins de
+ * ligne. Chaque thread analyse sa tranche, puis agrege dans son propre
+ * AVL (ou sa propre table des usines) les usines qui lui sont
+ * attribuees. Les AVL ou les tables sont enfin fusionnes.
+ *
+ * Le resultat est identique octet pour octet au traitement sequentiel.
+ *
+ * Le calcul des fuites d'une usine peut aussi etre reparti: les threads
+ * se partagent les sous-arbres du reseau par vol de travail.
+ */
+
+#ifndef PARALLELE_H
+#define PARALLELE_H
+
+#include "lecture.h"
+#include "avl.h"
+#include "table_usines.h"
+#include "arbre_distrib.h"
+
+/*
+ * Analyse d'une ligne: remplit la cle et les valeurs de l'usine,
+ * retourne 1 si la ligne doit etre agregee, 0 sinon.
+ */
+typedef int (*AnalyseurLigne)(Champ colonnes[NB_COLONNES], int nbChamps,
+                              Champ *cle, Usine *usine);
+
+uint32_t construireAVLParallele(Lecteur *lecteur, int nbThreads, AnalyseurLigne analyser,
+                                PoolAVL *pool);
+void construireTableParallele(Lecteur *lecteur, int nbThreads, AnalyseurLigne analyser,
+                              TableUsines *table);
+double calculerFuitesParallele(Reseau *reseau, uint32_t noeud, double volume, int nbThreads);
+
+#endif
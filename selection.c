@@ -0,0 +1,175 @@
+/*
+ * selection.c - Selection des plus petites et plus grandes usines
+ * Projet C-Wildwater
+ *
+ * Pour garder les k plus petites usines, le tas a a sa racine la plus
+ * grande des usines retenues: une nouvelle usine n'entre que si elle
+ * est plus petite que la racine, qu'elle remplace. Symetriquement pour
+ * les k plus grandes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "identifiants.h"
+#include "selection.h"
+
+/* Valeur d'une usine telle que la trie le graphique */
+double valeurUsine(const Usine *usine, int mode) {
+    double valMax = usine->capacite_max / 1000.0;
+    double valSrc = usine->volume_capte / 1000.0;
+    double valReal = usine->volume_traite / 1000.0;
+
+    if (mode == 1)
+        return valMax;
+    if (mode == 2)
+        return valSrc;
+    if (mode == 3)
+        return valReal;
+    /* Mode all: somme des colonnes reel, perdu et disponible */
+    return valReal + (valSrc - valReal) + (valMax - valSrc);
+}
+
+/* Ordre croissant des elements: valeur, puis identifiant */
+static int comparerElements(const ElementSelection *a, const ElementSelection *b) {
+    if (a->valeur < b->valeur)
+        return -1;
+    if (a->valeur > b->valeur)
+        return 1;
+    return comparerIdentifiants(a->usine.identifiant, b->usine.identifiant);
+}
+
+/* Ordre croissant des usines selon un mode, comme comparerElements */
+static int comparerValeurs(const Usine *a, const Usine *b, int mode) {
+    double va = valeurUsine(a, mode);
+    double vb = valeurUsine(b, mode);
+
+    if (va < vb)
+        return -1;
+    if (va > vb)
+        return 1;
+    return comparerIdentifiants(a->identifiant, b->identifiant);
+}
+
+static int comparerMax(const void *a, const void *b) {
+    return comparerValeurs((const Usine*)a, (const Usine*)b, 1);
+}
+
+static int comparerSrc(const void *a, const void *b) {
+    return comparerValeurs((const Usine*)a, (const Usine*)b, 2);
+}
+
+static int comparerReal(const void *a, const void *b) {
+    return comparerValeurs((const Usine*)a, (const Usine*)b, 3);
+}
+
+static int comparerAll(const void *a, const void *b) {
+    return comparerValeurs((const Usine*)a, (const Usine*)b, 4);
+}
+
+/* Indice: mode (1=max, 2=src, 3=real, 4=all) */
+int (* const COMPARATEURS_VALEUR[5])(const void *, const void *) = {
+    NULL, comparerMax, comparerSrc, comparerReal, comparerAll
+};
+
+/* Vrai si a doit etre plus pres de la racine que b (a est moins bon) */
+static int moinsBon(const Selection *selection, const ElementSelection *a,
+                    const ElementSelection *b) {
+    int c = comparerElements(a, b);
+    return (selection->sens == SELECTION_PETITES) ? c > 0 : c < 0;
+}
+
+/* Echange deux elements du tas */
+static void echanger(ElementSelection *a, ElementSelection *b) {
+    ElementSelection tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+/* Fait remonter l'element i vers la racine */
+static void remonter(Selection *selection, int i) {
+    int parent;
+
+    while (i > 0) {
+        parent = (i - 1) / 2;
+        if (!moinsBon(selection, &selection->tas[i], &selection->tas[parent]))
+            break;
+        echanger(&selection->tas[i], &selection->tas[parent]);
+        i = parent;
+    }
+}
+
+/* Fait descendre l'element i vers les feuilles */
+static void descendre(Selection *selection, int i) {
+    int fils, cible;
+
+    for (;;) {
+        cible = i;
+        fils = 2 * i + 1;
+        if (fils < selection->nb && moinsBon(selection, &selection->tas[fils], &selection->tas[cible]))
+            cible = fils;
+        fils++;
+        if (fils < selection->nb && moinsBon(selection, &selection->tas[fils], &selection->tas[cible]))
+            cible = fils;
+        if (cible == i)
+            return;
+        echanger(&selection->tas[i], &selection->tas[cible]);
+        i = cible;
+    }
+}
+
+/* Initialise une selection vide de k usines */
+void initialiserSelection(Selection *selection, int k, int sens, int mode) {
+    selection->tas = (ElementSelection*)malloc((size_t)k * sizeof(ElementSelection));
+    if (selection->tas == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+    selection->nb = 0;
+    selection->k = k;
+    selection->sens = sens;
+    selection->mode = mode;
+}
+
+/* Propose une usine: elle est retenue si elle fait partie des k meilleures */
+void proposerUsine(Selection *selection, const Usine *usine) {
+    ElementSelection element;
+
+    element.usine = *usine;
+    element.valeur = valeurUsine(usine, selection->mode);
+
+    if (selection->nb < selection->k) {
+        selection->tas[selection->nb] = element;
+        remonter(selection, selection->nb++);
+    } else if (selection->k > 0 && moinsBon(selection, &selection->tas[0], &element)) {
+        selection->tas[0] = element;
+        descendre(selection, 0);
+    }
+}
+
+/*
+ * Ecrit les usines retenues, de la meilleure a la moins bonne
+ * (croissant pour les petites, decroissant pour les grandes).
+ * Le tas est vide apres l'appel.
+ */
+void ecrireSelection(Selection *selection, Sortie *sortie) {
+    int nb = selection->nb;
+    int i;
+
+    /* Tri par extractions successives de la racine (la moins bonne) */
+    for (i = nb - 1; i > 0; i--) {
+        echanger(&selection->tas[0], &selection->tas[i]);
+        selection->nb = i;
+        descendre(selection, 0);
+    }
+    selection->nb = 0;
+
+    for (i = 0; i < nb; i++)
+        ecrireUsine(sortie, &selection->tas[i].usine, selection->mode);
+}
+
+/* Libere le tas */
+void libererSelection(Selection *selection) {
+    free(selection->tas);
+    selection->tas = NULL;
+    selection->nb = 0;
+}
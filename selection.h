@@ -0,0 +1,56 @@
+/*
+ * selection.h - En-tete pour la selection des plus petites et plus
+ * grandes usines de l'histogramme
+ * Projet C-Wildwater
+ *
+ * Les graphiques n'affichent que les NB_PETITES plus petites et les
+ * NB_GRANDES plus grandes usines. Elles sont retenues pendant le
+ * parcours des usines dans un tas borne: O(n log k), sans tri complet
+ * ni fichier intermediaire.
+ *
+ * Valeur comparee selon le mode:
+ *   max, src, real: la valeur ecrite dans l'histogramme
+ *   all: la somme des trois colonnes ecrites
+ * A valeur egale, les usines sont departagees par leur identifiant.
+ *
+ * Le meme ordre, expose par COMPARATEURS_VALEUR, range les arbres par
+ * valeur du serveur (construireArbreRang), interroges par rang.
+ */
+
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#include "avl.h"
+
+#define NB_PETITES 50
+#define NB_GRANDES 10
+
+/* Sens de la selection */
+#define SELECTION_PETITES 0
+#define SELECTION_GRANDES 1
+
+/* Element du tas: une usine et sa valeur */
+typedef struct ElementSelection {
+    Usine usine;
+    double valeur;
+} ElementSelection;
+
+/* Tas borne des k meilleures usines (la moins bonne a la racine) */
+typedef struct Selection {
+    ElementSelection *tas;
+    int nb;
+    int k;
+    int sens;                  /* SELECTION_PETITES ou SELECTION_GRANDES */
+    int mode;                  /* 1=max, 2=src, 3=real, 4=all */
+} Selection;
+
+/* Comparateurs pour qsort sur des Usine, ordre croissant de valeur par mode */
+extern int (* const COMPARATEURS_VALEUR[5])(const void *, const void *);
+
+double valeurUsine(const Usine *usine, int mode);
+void initialiserSelection(Selection *selection, int k, int sens, int mode);
+void proposerUsine(Selection *selection, const Usine *usine);
+void ecrireSelection(Selection *selection, Sortie *sortie);
+void libererSelection(Selection *selection);
+
+#endif
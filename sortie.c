@@ -0,0 +1,219 @@
+/*
+ * sortie.c - Ecriture tamponnee des resultats
+ * Projet C-Wildwater
+ *
+ * Formatage a 6 decimales: la valeur binaire x = m * 2^e (m entier de
+ * 53 bits au plus) est multipliee exactement par 10^6 sur 128 bits,
+ * puis arrondie a l'entier le plus proche (egalite vers le pair), comme
+ * le fait printf. Les valeurs hors de portee de ce calcul (infinis, NaN,
+ * plus de 1.8e13) passent par snprintf.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "lecture.h"
+#include "sortie.h"
+
+/* Taille suffisante pour un double ecrit par snprintf("%.6f") */
+#define TAILLE_REPLI 512
+
+/* ========== Ouverture et fermeture ========== */
+
+/* Alloue le tampon d'une sortie */
+static void initialiserSortie(Sortie *sortie, int fd, int proprietaire) {
+    sortie->fd = fd;
+    sortie->proprietaire = proprietaire;
+    sortie->erreur = 0;
+    sortie->utilise = 0;
+    sortie->tampon = (char*)malloc(TAILLE_TAMPON_SORTIE);
+    if (sortie->tampon == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ * Ouvre un fichier de resultats
+ * ajout: 1 pour ecrire a la fin du fichier, 0 pour le remplacer
+ * Le chemin "-" designe la sortie standard.
+ * Retourne 0 en cas de succes, 1 en cas d'erreur
+ */
+int ouvrirSortie(Sortie *sortie, const char *chemin, int ajout) {
+    int fd;
+
+    if (estCheminStandard(chemin)) {
+        sortieDepuisDescripteur(sortie, STDOUT_FILENO);
+        return 0;
+    }
+
+    fd = open(chemin, O_WRONLY | O_CREAT | (ajout ? O_APPEND : O_TRUNC), 0666);
+    if (fd < 0) {
+        sortie->fd = -1;
+        sortie->tampon = NULL;
+        return 1;
+    }
+    initialiserSortie(sortie, fd, 1);
+    return 0;
+}
+
+/* Utilise un descripteur deja ouvert (sortie standard), qui ne sera pas ferme */
+void sortieDepuisDescripteur(Sortie *sortie, int fd) {
+    initialiserSortie(sortie, fd, 0);
+}
+
+/* Ecrit le contenu du tampon; retourne 0 si tout a ete ecrit */
+int viderSortie(Sortie *sortie) {
+    size_t ecrits = 0;
+    ssize_t n;
+
+    while (ecrits < sortie->utilise && !sortie->erreur) {
+        n = write(sortie->fd, sortie->tampon + ecrits, sortie->utilise - ecrits);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            sortie->erreur = 1;
+        } else {
+            ecrits += (size_t)n;
+        }
+    }
+    sortie->utilise = 0;
+    return sortie->erreur;
+}
+
+/* Vide le tampon, ferme le fichier; retourne 0 si toutes les ecritures ont reussi */
+int fermerSortie(Sortie *sortie) {
+    int erreur;
+
+    if (sortie->tampon == NULL)
+        return 1;
+    erreur = viderSortie(sortie);
+    if (sortie->proprietaire && close(sortie->fd) != 0)
+        erreur = 1;
+    free(sortie->tampon);
+    sortie->tampon = NULL;
+    sortie->fd = -1;
+    return erreur;
+}
+
+/* ========== Ecriture ========== */
+
+/* Ajoute des octets au tampon, en le vidant quand il est plein */
+void ecrireTexte(Sortie *sortie, const char *texte, size_t longueur) {
+    size_t n;
+
+    while (longueur > 0) {
+        if (sortie->utilise == TAILLE_TAMPON_SORTIE)
+            viderSortie(sortie);
+        n = TAILLE_TAMPON_SORTIE - sortie->utilise;
+        if (n > longueur)
+            n = longueur;
+        memcpy(sortie->tampon + sortie->utilise, texte, n);
+        sortie->utilise += n;
+        texte += n;
+        longueur -= n;
+    }
+}
+
+/* Ajoute une chaine terminee par '\0' */
+void ecrireChaine(Sortie *sortie, const char *chaine) {
+    ecrireTexte(sortie, chaine, strlen(chaine));
+}
+
+/* Ajoute un caractere */
+void ecrireCaractere(Sortie *sortie, char c) {
+    if (sortie->utilise == TAILLE_TAMPON_SORTIE)
+        viderSortie(sortie);
+    sortie->tampon[sortie->utilise++] = c;
+}
+
+/*
+ * Arrondit |valeur| * 10^6 a l'entier le plus proche, egalite vers le pair
+ * Retourne 0 en cas de succes, 1 si la valeur est hors de portee.
+ */
+static int arrondirMillioniemes(uint64_t bits, uint64_t *resultat) {
+#ifdef __SIZEOF_INT128__
+    int exposant = (int)((bits >> 52) & 0x7FF);
+    uint64_t mantisse = bits & ((UINT64_C(1) << 52) - 1);
+    unsigned __int128 produit, reste, moitie;
+    int decalage;
+
+    if (exposant == 0x7FF)
+        return 1;                       /* Infini ou NaN */
+    if (exposant == 0)
+        exposant = 1;                   /* Nombre denormalise */
+    else
+        mantisse |= UINT64_C(1) << 52;
+    decalage = 1075 - exposant;         /* valeur = mantisse / 2^decalage */
+
+    produit = (unsigned __int128)mantisse * 1000000u;
+    if (decalage <= 0) {
+        /* Valeur entiere: produit * 2^-decalage doit tenir sur 64 bits */
+        if (-decalage > 20 || (produit << -decalage) >> 64 != 0)
+            return 1;
+        *resultat = (uint64_t)(produit << -decalage);
+        return 0;
+    }
+    if (decalage >= 127) {
+        /* produit < 2^73: le quotient est nul et le reste inferieur a la moitie */
+        *resultat = 0;
+        return 0;
+    }
+
+    reste = produit & ((((unsigned __int128)1) << decalage) - 1);
+    moitie = ((unsigned __int128)1) << (decalage - 1);
+    produit >>= decalage;
+    if (reste > moitie || (reste == moitie && (produit & 1)))
+        produit++;
+    if (produit >> 64 != 0)
+        return 1;
+    *resultat = (uint64_t)produit;
+    return 0;
+#else
+    (void)bits;
+    (void)resultat;
+    return 1;
+#endif
+}
+
+/* Ajoute un nombre avec 6 decimales, comme printf("%.6f") */
+void ecrireDecimal6(Sortie *sortie, double valeur) {
+    char texte[TAILLE_REPLI];
+    uint64_t bits, millioniemes, entier;
+    uint32_t fraction;
+    int i, n = 0;
+
+    memcpy(&bits, &valeur, sizeof(bits));
+    if (arrondirMillioniemes(bits, &millioniemes) != 0) {
+        n = snprintf(texte, sizeof(texte), "%.6f", valeur);
+        ecrireTexte(sortie, texte, (size_t)n);
+        return;
+    }
+
+    /* Le signe est ecrit meme si la valeur arrondie est nulle ("-0.000000") */
+    if (bits >> 63)
+        ecrireCaractere(sortie, '-');
+
+    entier = millioniemes / 1000000u;
+    fraction = (uint32_t)(millioniemes % 1000000u);
+
+    /* Chiffres de la partie entiere, ecrits de droite a gauche */
+    do {
+        texte[sizeof(texte) - 1 - n++] = (char)('0' + entier % 10);
+        entier /= 10;
+    } while (entier > 0);
+    ecrireTexte(sortie, texte + sizeof(texte) - n, (size_t)n);
+
+    texte[0] = '.';
+    for (i = 6; i >= 1; i--) {
+        texte[i] = (char)('0' + fraction % 10);
+        fraction /= 10;
+    }
+    ecrireTexte(sortie, texte, 7);
+}
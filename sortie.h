@@ -0,0 +1,43 @@
+/*
+ * sortie.h - En-tete pour l'ecriture tamponnee des resultats
+ * Projet C-Wildwater
+ *
+ * Les fichiers de resultats contiennent une ligne par usine. Au lieu
+ * d'un fprintf par ligne, le texte est accumule dans un grand tampon
+ * et ecrit avec un seul appel write a chaque vidage.
+ *
+ * Les nombres sont formates par ecrireDecimal6, qui produit exactement
+ * le meme texte que printf("%.6f") (arrondi au plus proche de la valeur
+ * binaire, egalite vers le chiffre pair) sans passer par stdio.
+ */
+
+#ifndef SORTIE_H
+#define SORTIE_H
+
+#include <stddef.h>
+
+/* Taille du tampon d'une sortie */
+#define TAILLE_TAMPON_SORTIE (1 << 18)
+
+/* Fichier de resultats tamponne */
+typedef struct Sortie {
+    int fd;                    /* Descripteur (-1 si non ouvert) */
+    int proprietaire;          /* 1 si le descripteur doit etre ferme */
+    int erreur;                /* 1 si une ecriture a echoue */
+    size_t utilise;            /* Octets en attente dans le tampon */
+    char *tampon;
+} Sortie;
+
+/* Ouverture et fermeture */
+int ouvrirSortie(Sortie *sortie, const char *chemin, int ajout);
+void sortieDepuisDescripteur(Sortie *sortie, int fd);
+int viderSortie(Sortie *sortie);
+int fermerSortie(Sortie *sortie);
+
+/* Ecriture */
+void ecrireTexte(Sortie *sortie, const char *texte, size_t longueur);
+void ecrireChaine(Sortie *sortie, const char *chaine);
+void ecrireCaractere(Sortie *sortie, char c);
+void ecrireDecimal6(Sortie *sortie, double valeur);
+
+#endif
@@ -0,0 +1,115 @@
+/*
+ * statistiques.c - Instrumentation des traitements (--stats)
+ * Projet C-Wildwater
+ *
+ * L'horloge est CLOCK_MONOTONIC. Dans les boucles ou analyse et
+ * construction alternent ligne a ligne, chaque ligne retenue coute deux
+ * lectures d'horloge: les durees sont un peu gonflees avec --stats.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "statistiques.h"
+
+/* Noms des phases dans le JSON */
+static const char *nomsPhases[NB_PHASES] = {
+    "ouverture", "analyse", "construction", "calcul", "ecriture", "liberation"
+};
+
+/* Mesures du processus */
+typedef struct Statistiques {
+    int actif;
+    int phase;                 /* Phase en cours */
+    struct timespec debut;     /* Debut de la phase en cours */
+    double secondes[NB_PHASES];
+    size_t nbLignes[NB_COLONNES + 1];
+    uint64_t nbNoeuds;
+    uint64_t nbRotations;
+    uint32_t profondeur;
+} Statistiques;
+
+static Statistiques statistiques;
+
+/* Active les mesures; le temps ecoule jusqu'ici compte dans l'ouverture */
+void activerStatistiques(void) {
+    memset(&statistiques, 0, sizeof(statistiques));
+    statistiques.actif = 1;
+    statistiques.phase = PHASE_OUVERTURE;
+    clock_gettime(CLOCK_MONOTONIC, &statistiques.debut);
+}
+
+/* Retourne 1 si --stats est actif */
+int statistiquesActives(void) {
+    return statistiques.actif;
+}
+
+/* Termine la phase en cours et commence la phase donnee */
+void changerPhase(int phase) {
+    struct timespec maintenant;
+
+    if (!statistiques.actif)
+        return;
+    clock_gettime(CLOCK_MONOTONIC, &maintenant);
+    statistiques.secondes[statistiques.phase] +=
+        (double)(maintenant.tv_sec - statistiques.debut.tv_sec) +
+        (double)(maintenant.tv_nsec - statistiques.debut.tv_nsec) / 1e9;
+    statistiques.debut = maintenant;
+    statistiques.phase = phase;
+}
+
+/* Ajoute les lignes lues par un lecteur (a appeler avant de le fermer) */
+void compterLignes(const Lecteur *lecteur) {
+    int i;
+
+    for (i = 0; i <= NB_COLONNES; i++)
+        statistiques.nbLignes[i] += lecteur->nbLignes[i];
+}
+
+/* Ajoute des noeuds et des rotations; garde la plus grande profondeur */
+void noterStructure(uint64_t nbNoeuds, uint64_t nbRotations, uint32_t profondeur) {
+    statistiques.nbNoeuds += nbNoeuds;
+    statistiques.nbRotations += nbRotations;
+    if (profondeur > statistiques.profondeur)
+        statistiques.profondeur = profondeur;
+}
+
+/*
+ * Ecrit les mesures en JSON sur la sortie d'erreur
+ * minChamps: les lignes de moins de minChamps colonnes sont comptees
+ * comme rejetees (meme test que les boucles de lecture de la commande)
+ */
+void ecrireStatistiques(const char *commande, int minChamps) {
+    struct rusage usage;
+    size_t lues = 0, rejetees = 0;
+    double total = 0.0;
+    int i;
+
+    if (!statistiques.actif)
+        return;
+    changerPhase(statistiques.phase);
+
+    for (i = 0; i <= NB_COLONNES; i++) {
+        lues += statistiques.nbLignes[i];
+        if (i < minChamps)
+            rejetees += statistiques.nbLignes[i];
+    }
+
+    /* ru_maxrss est en kilo-octets sous Linux */
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        usage.ru_maxrss = 0;
+
+    fprintf(stderr, "{\"commande\":\"%s\",\"phases_s\":{", commande);
+    for (i = 0; i < NB_PHASES; i++) {
+        fprintf(stderr, "%s\"%s\":%.6f", (i == 0) ? "" : ",", nomsPhases[i], statistiques.secondes[i]);
+        total += statistiques.secondes[i];
+    }
+    fprintf(stderr, "},\"total_s\":%.6f,\"lignes_lues\":%zu,\"lignes_rejetees\":%zu,"
+            "\"noeuds\":%llu,\"rotations\":%llu,\"profondeur_max\":%u,\"rss_max_ko\":%ld}\n",
+            total, lues, rejetees, (unsigned long long)statistiques.nbNoeuds,
+            (unsigned long long)statistiques.nbRotations, statistiques.profondeur,
+            (long)usage.ru_maxrss);
+}
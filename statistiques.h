@@ -0,0 +1,37 @@
+/*
+ * statistiques.h - En-tete pour l'instrumentation des traitements (--stats)
+ * Projet C-Wildwater
+ *
+ * Le temps d'execution est decoupe en phases: chaque appel a
+ * changerPhase attribue le temps ecoule depuis l'appel precedent a la
+ * phase en cours, puis passe a la nouvelle phase. Sans --stats, les
+ * fonctions de ce module ne font rien.
+ *
+ * En fin de traitement, ecrireStatistiques ecrit sur la sortie d'erreur
+ * un objet JSON sur une ligne: duree de chaque phase, lignes lues et
+ * rejetees, noeuds, rotations, profondeur maximale et memoire maximale.
+ */
+
+#ifndef STATISTIQUES_H
+#define STATISTIQUES_H
+
+#include <stdint.h>
+#include "lecture.h"
+
+/* Phases d'un traitement */
+#define PHASE_OUVERTURE    0   /* Ouverture du fichier ou du cache */
+#define PHASE_ANALYSE      1   /* Decoupage et conversion des lignes */
+#define PHASE_CONSTRUCTION 2   /* Insertion dans les arbres ou les tables */
+#define PHASE_CALCUL       3   /* Calcul des fuites */
+#define PHASE_ECRITURE     4   /* Ecriture des resultats */
+#define PHASE_LIBERATION   5   /* Liberation de la memoire */
+#define NB_PHASES          6
+
+void activerStatistiques(void);
+int statistiquesActives(void);
+void changerPhase(int phase);
+void compterLignes(const Lecteur *lecteur);
+void noterStructure(uint64_t nbNoeuds, uint64_t nbRotations, uint32_t profondeur);
+void ecrireStatistiques(const char *commande, int minChamps);
+
+#endif
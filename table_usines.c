@@ -0,0 +1,164 @@
+/*
+ * table_usines.c - Agregation des usines par table de hachage
+ * Projet C-Wildwater
+ *
+ * Sondage lineaire, taux de remplissage maximal 1/2. Les numeros
+ * d'identifiant etant consecutifs, ils sont disperses par hachage
+ * multiplicatif avant d'etre ramenes au nombre de cases.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "identifiants.h"
+#include "table_usines.h"
+
+#define NB_CASES_INITIAL 1024
+
+/* Case de depart d'un identifiant */
+static uint32_t caseInitiale(uint32_t identifiant, uint32_t nbCases) {
+    return (identifiant * 2654435761u) & (nbCases - 1);
+}
+
+/* Alloue un tableau de cases libres */
+static Usine* creerCases(uint32_t nbCases) {
+    Usine *cases = (Usine*)calloc(nbCases, sizeof(Usine));
+    if (cases == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+    return cases;
+}
+
+/* Double le nombre de cases et replace les usines */
+static void agrandirTable(TableUsines *table) {
+    uint32_t nbCases = table->nbCases * 2;
+    Usine *cases = creerCases(nbCases);
+    uint32_t i, c;
+
+    for (i = 0; i < table->nbCases; i++) {
+        if (table->cases[i].identifiant == IDENTIFIANT_NUL)
+            continue;
+        c = caseInitiale(table->cases[i].identifiant, nbCases);
+        while (cases[c].identifiant != IDENTIFIANT_NUL)
+            c = (c + 1) & (nbCases - 1);
+        cases[c] = table->cases[i];
+    }
+
+    free(table->cases);
+    table->cases = cases;
+    table->nbCases = nbCases;
+}
+
+/* Initialise une table vide */
+void initialiserTableUsines(TableUsines *table) {
+    table->cases = NULL;
+    table->nbCases = 0;
+    table->nb = 0;
+}
+
+/*
+ * Ajoute une usine, ou cumule ses valeurs si elle est deja presente
+ * (capacite_max remplacee si non nulle, volumes additionnes)
+ */
+void ajouterUsine(TableUsines *table, Usine usine) {
+    Usine *u;
+    uint32_t c;
+
+    if (table->cases == NULL) {
+        table->cases = creerCases(NB_CASES_INITIAL);
+        table->nbCases = NB_CASES_INITIAL;
+    }
+
+    c = caseInitiale(usine.identifiant, table->nbCases);
+    while (table->cases[c].identifiant != IDENTIFIANT_NUL &&
+           table->cases[c].identifiant != usine.identifiant)
+        c = (c + 1) & (table->nbCases - 1);
+
+    u = &table->cases[c];
+    if (u->identifiant == IDENTIFIANT_NUL) {
+        *u = usine;
+        table->nb++;
+        if (table->nb * 2 > table->nbCases)
+            agrandirTable(table);
+        return;
+    }
+
+    if (usine.capacite_max > 0) {
+        u->capacite_max = usine.capacite_max;
+    }
+    u->volume_capte += usine.volume_capte;
+    u->volume_traite += usine.volume_traite;
+}
+
+/*
+ * Ajoute toutes les usines de la table source a la table destination
+ * La table source n'est pas modifiee; elle reste a liberer par l'appelant.
+ */
+void fusionnerTableUsines(TableUsines *destination, TableUsines *source) {
+    uint32_t i;
+
+    for (i = 0; i < source->nbCases; i++) {
+        if (source->cases[i].identifiant != IDENTIFIANT_NUL)
+            ajouterUsine(destination, source->cases[i]);
+    }
+}
+
+/* Visite toutes les usines de la table (ordre des cases) */
+void parcoursTableUsines(TableUsines *table, void (*visiter)(const Usine *, void *), void *contexte) {
+    uint32_t i;
+
+    for (i = 0; i < table->nbCases; i++) {
+        if (table->cases[i].identifiant != IDENTIFIANT_NUL)
+            visiter(&table->cases[i], contexte);
+    }
+}
+
+/* Comparateur pour qsort: ordre alphabetique des identifiants */
+static int comparerUsinesParTexte(const void *a, const void *b) {
+    const Usine *ua = *(Usine* const*)a;
+    const Usine *ub = *(Usine* const*)b;
+    return comparerIdentifiants(ua->identifiant, ub->identifiant);
+}
+
+/*
+ * Ecrit les usines en ordre alphabetique inverse (comme parcoursInverseAVL)
+ * Mode: 1=max, 2=src, 3=real, 4=all
+ */
+void ecrireTableUsines(TableUsines *table, Sortie *sortie, int mode) {
+    ecrireTableUsinesModes(table, sortie, &mode, 1);
+}
+
+/* Meme ecriture dans nbSorties sorties, sortie i avec le mode modes[i] */
+void ecrireTableUsinesModes(TableUsines *table, Sortie *sorties, const int *modes, int nbSorties) {
+    Usine **tableau;
+    uint32_t i, nb = 0;
+    int j;
+
+    if (table->nb == 0)
+        return;
+
+    tableau = (Usine**)malloc((size_t)table->nb * sizeof(Usine*));
+    if (tableau == NULL) {
+        fprintf(stderr, "Erreur: allocation memoire echouee\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < table->nbCases; i++) {
+        if (table->cases[i].identifiant != IDENTIFIANT_NUL)
+            tableau[nb++] = &table->cases[i];
+    }
+    qsort(tableau, nb, sizeof(Usine*), comparerUsinesParTexte);
+
+    for (i = nb; i > 0; i--) {
+        for (j = 0; j < nbSorties; j++)
+            ecrireUsine(&sorties[j], tableau[i - 1], modes[j]);
+    }
+
+    free(tableau);
+}
+
+/* Libere la table */
+void libererTableUsines(TableUsines *table) {
+    free(table->cases);
+    initialiserTableUsines(table);
+}
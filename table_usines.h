@@ -0,0 +1,32 @@
+/*
+ * table_usines.h - En-tete pour l'agregation des usines par table de hachage
+ * Projet C-Wildwater
+ *
+ * Alternative a l'AVL pour l'histogramme: les usines sont cumulees dans
+ * une table a adressage ouvert indexee par numero d'identifiant, sans
+ * maintenir d'ordre. Les usines ne sont triees qu'une fois, a l'ecriture.
+ *
+ * Les regles de cumul sont celles de insererAVL.
+ */
+
+#ifndef TABLE_USINES_H
+#define TABLE_USINES_H
+
+#include "avl.h"
+
+/* Table des usines */
+typedef struct TableUsines {
+    Usine *cases;              /* identifiant IDENTIFIANT_NUL = case libre */
+    uint32_t nbCases;          /* Puissance de 2 */
+    uint32_t nb;               /* Nombre d'usines */
+} TableUsines;
+
+void initialiserTableUsines(TableUsines *table);
+void ajouterUsine(TableUsines *table, Usine usine);
+void fusionnerTableUsines(TableUsines *destination, TableUsines *source);
+void parcoursTableUsines(TableUsines *table, void (*visiter)(const Usine *, void *), void *contexte);
+void ecrireTableUsines(TableUsines *table, Sortie *sortie, int mode);
+void ecrireTableUsinesModes(TableUsines *table, Sortie *sorties, const int *modes, int nbSorties);
+void libererTableUsines(TableUsines *table);
+
+#endif
@@ -0,0 +1,59 @@
+#!/bin/bash
+
+# =============================================================================
+# fuites_desordre.sh - Fuites d'une usine quand les lignes sont dans le desordre
+# Projet C-Wildwater
+#
+# Le troncon Storage -> Junction precede celui qui rattache le stockage a
+# l'usine. leaks <id>, leaks --all et leaks --ids doivent tous donner les
+# fuites de l'arbre complet :
+#   100 k.m3 entrent, -20 % vers le stockage (20), -10 % vers la jonction
+#   (8), -50 % vers le raccordement (36) : 64 k.m3 = 0.064000 M.m3
+#
+# Usage : tests/fuites_desordre.sh   (appele par "make test")
+# =============================================================================
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+WILDWATER="$SCRIPT_DIR/../wildwater"
+TMP="$(mktemp -d)"
+trap 'rm -rf "$TMP"' EXIT
+
+ATTENDU="Plant #A;0.064000"
+
+cat > "$TMP/desordre.dat" <<'DONNEES'
+Plant #A;Storage #2;Junction #3;-;10
+Plant #A;Junction #3;Service #4;-;50
+-;Plant #A;-;1000;-
+-;Source #1;Plant #A;100;0
+-;Plant #A;Storage #2;-;20
+DONNEES
+
+echec=0
+
+# verifier <libelle> <fichier resultat>
+verifier() {
+    if [ "$(cat "$2")" != "$ATTENDU" ]; then
+        echo "ECHEC $1 : $(cat "$2") (attendu $ATTENDU)" >&2
+        echec=1
+    fi
+}
+
+"$WILDWATER" leaks "Plant #A" "$TMP/desordre.dat" "$TMP/seule.out" > /dev/null
+verifier "leaks <id>" "$TMP/seule.out"
+
+"$WILDWATER" leaks --all "$TMP/desordre.dat" "$TMP/tout.out" > /dev/null
+verifier "leaks --all" "$TMP/tout.out"
+
+echo "Plant #A" > "$TMP/ids.txt"
+"$WILDWATER" leaks --ids "$TMP/ids.txt" "$TMP/desordre.dat" "$TMP/ids.out" > /dev/null
+verifier "leaks --ids" "$TMP/ids.out"
+
+# Memes calculs sur le cache binaire
+"$WILDWATER" index "$TMP/desordre.dat" > /dev/null
+"$WILDWATER" leaks "Plant #A" "$TMP/desordre.dat" "$TMP/cache.out" > /dev/null
+verifier "leaks <id> (cache)" "$TMP/cache.out"
+
+if [ "$echec" -eq 0 ]; then
+    echo "fuites_desordre : OK"
+fi
+exit "$echec"
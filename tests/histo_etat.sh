@@ -0,0 +1,87 @@
+#!/bin/bash
+
+# =============================================================================
+# histo_etat.sh - histo --state : reprise incrementale et relectures completes
+# Projet C-Wildwater
+#
+# Trois cas, chacun compare (cmp) a un traitement complet sans etat, le
+# nombre de lignes lues etant controle par --stats :
+#   ajout      des lignes sont ajoutees a la fin : seules elles sont lues,
+#              sans avertissement
+#   reecrit    la premiere ligne est modifiee : l'etat est ecarte
+#              ("fichier de donnees reecrit"), relecture complete
+#   tronque    le fichier est raccourci : l'etat est ecarte
+#              ("fichier de donnees tronque"), relecture complete
+#
+# Usage : tests/histo_etat.sh   (appele par "make test")
+# =============================================================================
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+WILDWATER="$SCRIPT_DIR/../wildwater"
+GENERATEUR="$SCRIPT_DIR/../generateur"
+TMP="$(mktemp -d)"
+trap 'rm -rf "$TMP"' EXIT
+
+DONNEES="$TMP/donnees.dat"
+ETAT="$TMP/etat.bin"
+echec=0
+
+# verifier <libelle> <lignes lues attendues> <motif attendu sur la sortie
+#          d'erreur, vide si aucun message>
+# Lance histo --state sur DONNEES et compare au traitement complet
+verifier() {
+    local lues
+
+    "$WILDWATER" histo all "$DONNEES" "$TMP/complet.out" > /dev/null 2>&1
+    "$WILDWATER" histo all "$DONNEES" "$TMP/etat.out" --state "$ETAT" --stats \
+        > /dev/null 2> "$TMP/sortie_erreur"
+    grep -v '^{' "$TMP/sortie_erreur" > "$TMP/erreurs"
+    lues=$(grep -o '"lignes_lues":[0-9]*' "$TMP/sortie_erreur" | cut -d: -f2)
+
+    if ! cmp -s "$TMP/complet.out" "$TMP/etat.out"; then
+        echo "ECHEC $1 : histogramme different du traitement complet" >&2
+        echec=1
+    fi
+    if [ "$lues" != "$2" ]; then
+        echo "ECHEC $1 : $lues lignes lues, $2 attendues" >&2
+        echec=1
+    fi
+    if [ -z "$3" ] && [ -s "$TMP/erreurs" ]; then
+        echo "ECHEC $1 : message inattendu : $(cat "$TMP/erreurs")" >&2
+        echec=1
+    fi
+    if [ -n "$3" ] && ! grep -q "$3" "$TMP/erreurs"; then
+        echo "ECHEC $1 : message \"$3\" attendu, obtenu : $(cat "$TMP/erreurs")" >&2
+        echec=1
+    fi
+}
+
+"$GENERATEUR" 30000 -s 3 -o "$TMP/genere.dat" 2> /dev/null
+NB_LIGNES=$(wc -l < "$TMP/genere.dat")
+MOITIE=$((NB_LIGNES / 2))
+
+# Premier passage : pas d'etat, pas de message
+head -n "$MOITIE" "$TMP/genere.dat" > "$DONNEES"
+verifier "premier passage" "$MOITIE" ""
+
+# Ajout des lignes suivantes
+tail -n +"$((MOITIE + 1))" "$TMP/genere.dat" >> "$DONNEES"
+verifier "ajout" "$((NB_LIGNES - MOITIE))" ""
+
+# Premiere ligne reecrite (meme longueur, autre capacite)
+sed -i '1s/;\([0-9]\)\([0-9]*\);-$/;9\2;-/' "$DONNEES"
+if cmp -s "$DONNEES" "$TMP/genere.dat"; then
+    echo "ECHEC reecrit : la premiere ligne n'a pas ete modifiee" >&2
+    echec=1
+fi
+verifier "reecrit" "$NB_LIGNES" "reecrit"
+
+# Fichier raccourci sous la position enregistree
+head -n "$MOITIE" "$TMP/genere.dat" > "$TMP/court.dat"
+mv "$TMP/court.dat" "$DONNEES"
+verifier "tronque" "$MOITIE" "tronque"
+
+if [ "$echec" -eq 0 ]; then
+    echo "histo_etat : OK"
+fi
+exit "$echec"
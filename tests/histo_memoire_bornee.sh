@@ -0,0 +1,56 @@
+#!/bin/bash
+
+# =============================================================================
+# histo_memoire_bornee.sh - histo --mem-limit contre l'agregation en memoire
+# Projet C-Wildwater
+#
+# Un fichier genere (graine fixe) d'environ 80 000 usines est agrege avec
+# la plus petite limite acceptee (64K) : plusieurs centaines de passages,
+# donc le fichier de debordement, plus de NB_SERIES_MAX (64) series et
+# leurs fusions intermediaires. Les histogrammes doivent etre identiques,
+# octet pour octet, a ceux du traitement en memoire.
+#
+# Le meme controle est refait sur les lignes entrelacees (lignes impaires
+# puis paires) : les lignes d'une usine sont alors separees, et une usine
+# peut etre a cheval sur la table et le debordement.
+#
+# Usage : tests/histo_memoire_bornee.sh   (appele par "make test")
+# =============================================================================
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+WILDWATER="$SCRIPT_DIR/../wildwater"
+GENERATEUR="$SCRIPT_DIR/../generateur"
+TMP="$(mktemp -d)"
+trap 'rm -rf "$TMP"' EXIT
+
+LIMITE=64K
+MODES=max,src,real,all
+echec=0
+
+# comparer <libelle> <fichier de donnees>
+comparer() {
+    local mode
+
+    mkdir -p "$TMP/memoire" "$TMP/bornee"
+    "$WILDWATER" histo "$MODES" "$2" "$TMP/memoire" > /dev/null || echec=1
+    "$WILDWATER" histo "$MODES" "$2" "$TMP/bornee" --mem-limit "$LIMITE" > /dev/null || echec=1
+    for mode in ${MODES//,/ }; do
+        if ! cmp -s "$TMP/memoire/vol_$mode.dat" "$TMP/bornee/vol_$mode.dat"; then
+            echo "ECHEC $1 : vol_$mode.dat differe avec --mem-limit $LIMITE" >&2
+            echec=1
+        fi
+    done
+    rm -rf "$TMP/memoire" "$TMP/bornee"
+}
+
+"$GENERATEUR" 200000 -s 7 --sources 1 --stockages 1 --profondeur 1 --sortance 1 \
+    -o "$TMP/groupe.dat" 2> /dev/null
+comparer "lignes groupees" "$TMP/groupe.dat"
+
+{ awk 'NR % 2 == 1' "$TMP/groupe.dat"; awk 'NR % 2 == 0' "$TMP/groupe.dat"; } > "$TMP/entrelace.dat"
+comparer "lignes entrelacees" "$TMP/entrelace.dat"
+
+if [ "$echec" -eq 0 ]; then
+    echo "histo_memoire_bornee : OK"
+fi
+exit "$echec"
@@ -0,0 +1,231 @@
+/*
+ * test_nombres.c - Controle de l'ecriture et de la lecture des nombres
+ * Projet C-Wildwater
+ *
+ * ecrireDecimal6 doit produire exactement le texte de printf("%.6f"), et
+ * champVersDouble exactement le double de atof (au bit pres).
+ * Les valeurs sont tirees par un xorshift64* a graine fixe: memes
+ * valeurs a chaque lancement.
+ *
+ * Usage: tests/test_nombres   (appele par "make test")
+ * Retourne 0 si toutes les comparaisons sont identiques.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "lecture.h"
+#include "sortie.h"
+
+/* Nombre de valeurs tirees par famille */
+#define NB_TIRAGES 500000
+
+/* Longueur maximale d'un nombre tire (le repli de champVersDouble en garde 63) */
+#define LONGUEUR_NOMBRE 48
+
+/* Nombre maximal d'ecarts affiches */
+#define MAX_ECARTS_AFFICHES 10
+
+static uint64_t etat = 88172645463325252ULL;
+static uint64_t nbComparaisons = 0;
+static uint64_t nbEcarts = 0;
+
+/* ========== Tirages ========== */
+
+/* Tirage xorshift64* */
+static uint64_t tirer(void) {
+    etat ^= etat >> 12;
+    etat ^= etat << 25;
+    etat ^= etat >> 27;
+    return etat * 2685821657736338717ULL;
+}
+
+/* Double de bits quelconques */
+static double tirerBits(void) {
+    uint64_t bits = tirer();
+    double valeur;
+
+    memcpy(&valeur, &bits, sizeof(valeur));
+    return valeur;
+}
+
+/* ========== ecrireDecimal6 ========== */
+
+/* Compare ecrireDecimal6 a snprintf("%.6f") pour une valeur et son oppose */
+static void comparerDecimal6(Sortie *sortie, double valeur) {
+    char attendu[512];
+    int signe;
+    int n;
+
+    for (signe = 0; signe < 2; signe++, valeur = -valeur) {
+        n = snprintf(attendu, sizeof(attendu), "%.6f", valeur);
+        sortie->utilise = 0;
+        ecrireDecimal6(sortie, valeur);
+        nbComparaisons++;
+        if (sortie->utilise == (size_t)n && memcmp(sortie->tampon, attendu, (size_t)n) == 0)
+            continue;
+        if (nbEcarts++ < MAX_ECARTS_AFFICHES)
+            fprintf(stderr, "ecrireDecimal6(%a): \"%.*s\", attendu \"%s\"\n", valeur,
+                    (int)sortie->utilise, sortie->tampon, attendu);
+    }
+}
+
+static void verifierDecimal6(void) {
+    Sortie sortie;
+    double valeur;
+    int i;
+
+    /* Tampon seul: la sortie n'est jamais videe */
+    sortieDepuisDescripteur(&sortie, -1);
+
+    /* Cas particuliers */
+    comparerDecimal6(&sortie, 0.0);
+    comparerDecimal6(&sortie, 0.0000005);
+    comparerDecimal6(&sortie, 0.0000004999999);
+    comparerDecimal6(&sortie, 1e-300);
+    comparerDecimal6(&sortie, 4.9e-324);
+    comparerDecimal6(&sortie, 9007199254740993.0);
+    comparerDecimal6(&sortie, 1.8e13);
+    comparerDecimal6(&sortie, 1e300);
+    comparerDecimal6(&sortie, INFINITY);
+    comparerDecimal6(&sortie, NAN);
+
+    for (i = 0; i < NB_TIRAGES; i++) {
+        /* Bits quelconques: tous les exposants, y compris les replis */
+        comparerDecimal6(&sortie, tirerBits());
+
+        /* Valeurs des fichiers: k.m3 avec quelques decimales, divisees par 1000 */
+        valeur = (double)(tirer() % 100000000000ULL) / 1000.0 / 1000.0;
+        comparerDecimal6(&sortie, valeur);
+
+        /* Egalites exactes: m / 2^p a 7 decimales ou plus (0.0078125...) */
+        valeur = ldexp((double)(tirer() % 100000000ULL), -(int)(7 + tirer() % 24));
+        comparerDecimal6(&sortie, valeur);
+
+        /* Au plus pres d'une demi-unite de la 6e decimale, et ses voisins */
+        valeur = ((double)(tirer() % 10000000000ULL) + 0.5) / 1e6;
+        comparerDecimal6(&sortie, valeur);
+        comparerDecimal6(&sortie, nextafter(valeur, 0.0));
+        comparerDecimal6(&sortie, nextafter(valeur, INFINITY));
+    }
+
+    sortie.utilise = 0;
+    fermerSortie(&sortie);
+}
+
+/* ========== champVersDouble ========== */
+
+/* Compare champVersDouble(texte) a atof(texte), bit a bit */
+static void comparerConversion(const char *texte) {
+    double obtenu = champVersDouble(champDepuisChaine(texte));
+    double attendu = atof(texte);
+
+    nbComparaisons++;
+    if (memcmp(&obtenu, &attendu, sizeof(double)) == 0)
+        return;
+    if (nbEcarts++ < MAX_ECARTS_AFFICHES)
+        fprintf(stderr, "champVersDouble(\"%s\"): %a, attendu %a\n", texte, obtenu, attendu);
+}
+
+/* Ajoute n chiffres decimaux tires au texte */
+static int ajouterChiffres(char *texte, int n, int nb) {
+    int i;
+
+    for (i = 0; i < nb; i++)
+        texte[n++] = (char)('0' + tirer() % 10);
+    return n;
+}
+
+/* Nombre ecrit comme dans les fichiers: [+-]chiffres[.chiffres], parfois suivi d'autre chose */
+static void tirerTexteNombre(char *texte) {
+    static const char *suites[] = { "e5", "E-3", " ", "x", ";", ".5" };
+    uint64_t tirage = tirer();
+    int n = 0;
+
+    if (tirage % 8 == 0)
+        texte[n++] = '-';
+    else if (tirage % 8 == 1)
+        texte[n++] = '+';
+    n = ajouterChiffres(texte, n, (int)(tirer() % 13));
+    if (tirer() % 4 != 0) {
+        texte[n++] = '.';
+        n = ajouterChiffres(texte, n, (int)(tirer() % 13));
+    }
+    /* Parfois plus de chiffres significatifs qu'une mantisse exacte */
+    if (tirer() % 16 == 0)
+        n = ajouterChiffres(texte, n, (int)(tirer() % 15));
+    texte[n] = '\0';
+    if (tirer() % 32 == 0)
+        strcat(texte, suites[tirer() % (sizeof(suites) / sizeof(suites[0]))]);
+}
+
+static void verifierConversion(void) {
+    char texte[LONGUEUR_NOMBRE + 8];
+    uint64_t huitiemes;
+    double valeur;
+    int i;
+
+    /* Cas particuliers */
+    comparerConversion("");
+    comparerConversion("-");
+    comparerConversion(".");
+    comparerConversion("-0");
+    comparerConversion("-0.0");
+    comparerConversion("0.1");
+    comparerConversion("9007199254740992");
+    comparerConversion("9007199254740993");
+    comparerConversion("9007199254740993.0");
+    comparerConversion("0.0000000000000000000001");
+    comparerConversion("1234567890123456789");
+    comparerConversion("12345678901234567890");
+    comparerConversion("1e308");
+    comparerConversion("inf");
+    comparerConversion("nan");
+
+    for (i = 0; i < NB_TIRAGES; i++) {
+        /* Textes de la forme des fichiers */
+        tirerTexteNombre(texte);
+        comparerConversion(texte);
+
+        /* Valeurs des fichiers: k.m3 a 3 decimales, pourcentages */
+        snprintf(texte, sizeof(texte), "%.3f", (double)(tirer() % 10000000000ULL) / 1000.0);
+        comparerConversion(texte);
+        snprintf(texte, sizeof(texte), "%.3f", (double)(tirer() % 100000ULL) / 1000.0);
+        comparerConversion(texte);
+
+        /* Doubles quelconques ecrits au plus court sans perte */
+        valeur = tirerBits();
+        if (isfinite(valeur)) {
+            snprintf(texte, sizeof(texte), "%.17g", valeur);
+            comparerConversion(texte);
+        }
+
+        /* Milieux exacts entre deux doubles voisins (2^50 a 2^54), en huitiemes
+         * pour que le texte soit exact: 2^50 + 0.125, 2^52 + 0.5, 2^53 + 1... */
+        valeur = ldexp(1.0, 50 + (int)(tirer() % 4)) + (double)(tirer() % (UINT64_C(1) << 50));
+        huitiemes = (uint64_t)valeur * 8 + (uint64_t)((nextafter(valeur, INFINITY) - valeur) * 4);
+        snprintf(texte, sizeof(texte), "%llu.%03u", (unsigned long long)(huitiemes / 8),
+                 (unsigned)(huitiemes % 8) * 125);
+        comparerConversion(texte);
+        snprintf(texte, sizeof(texte), "-%llu.%03u", (unsigned long long)(huitiemes / 8),
+                 (unsigned)(huitiemes % 8) * 125);
+        comparerConversion(texte);
+    }
+}
+
+/* ========== Programme principal ========== */
+
+int main(void) {
+    verifierDecimal6();
+    verifierConversion();
+
+    if (nbEcarts > 0) {
+        fprintf(stderr, "test_nombres: %llu ecart(s) sur %llu comparaisons\n",
+                (unsigned long long)nbEcarts, (unsigned long long)nbComparaisons);
+        return 1;
+    }
+    printf("test_nombres : OK (%llu comparaisons)\n", (unsigned long long)nbComparaisons);
+    return 0;
+}